@@ -1,7 +1,206 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include "tgapaint.h"
 
+// Draw the scene used to check the draw lists with the pencil 'pen' 
+// and the font 'font', directly on 'tga' if 'list' is NULL, else 
+// recorded in 'list'
+void DrawScene(TGA *tga, TGADrawList *list, TGAPencil *pen, 
+  TGAFont *font) {
+  VecFloat *from = VecFloatCreate(2);
+  VecFloat *to = VecFloatCreate(2);
+  TGAPixel *pix = TGAGetBlackPixel();
+  Shapoid *shapoid = SpheroidCreate(2);
+  BCurve *curve = BCurveCreate(3, 2);
+  // Lines with a pixel pencil, with and without antialias, crossing
+  // the whole image
+  TGAPencilSetShapePixel(pen);
+  TGAPencilSetModeColorSolid(pen);
+  for (int i = 0; i < 16; ++i) {
+    pix->_rgba[0] = 16 * i; pix->_rgba[1] = 255 - 16 * i; 
+    pix->_rgba[2] = 128; pix->_rgba[3] = 128 + 8 * i;
+    TGAPencilSetColor(pen, pix);
+    TGAPencilSetAntialias(pen, (i % 2 == 0));
+    VecSet(from, 0, -10.5 + 3.7 * i); VecSet(from, 1, -5.0);
+    VecSet(to, 0, 310.0 - 11.3 * i); VecSet(to, 1, 205.5);
+    if (list == NULL) TGADrawLine(tga, from, to, pen);
+    else TGADrawListDrawLine(list, from, to, pen);
+    VecSet(from, 0, -5.0); VecSet(from, 1, 7.5 + 12.1 * i);
+    VecSet(to, 0, 305.0); VecSet(to, 1, 195.5 - 9.3 * i);
+    if (list == NULL) TGADrawLine(tga, from, to, pen);
+    else TGADrawListDrawLine(list, from, to, pen);
+  }
+  // Rectangles and ellipses with a round pencil
+  TGAPencilSetShapeRound(pen);
+  TGAPencilSetThickness(pen, 3.0);
+  pix->_rgba[0] = 0; pix->_rgba[1] = 100; pix->_rgba[2] = 200; 
+  pix->_rgba[3] = 200;
+  TGAPencilSetColor(pen, pix);
+  VecSet(from, 0, 20.5); VecSet(from, 1, 30.5);
+  VecSet(to, 0, 140.5); VecSet(to, 1, 170.5);
+  if (list == NULL) TGADrawRect(tga, from, to, pen);
+  else TGADrawListDrawRect(list, from, to, pen);
+  VecSet(from, 0, 220.5); VecSet(from, 1, 100.5);
+  VecSet(to, 0, 60.5); VecSet(to, 1, 80.5);
+  if (list == NULL) TGADrawEllipse(tga, from, to, pen);
+  else TGADrawListDrawEllipse(list, from, to, pen);
+  pix->_rgba[0] = 250; pix->_rgba[1] = 200; pix->_rgba[2] = 0; 
+  pix->_rgba[3] = 150;
+  TGAPencilSetColor(pen, pix);
+  VecSet(from, 0, 100.5); VecSet(from, 1, 90.5);
+  VecSet(to, 0, 180.5); VecSet(to, 1, 150.5);
+  if (list == NULL) TGAFillRect(tga, from, to, pen);
+  else TGADrawListFillRect(list, from, to, pen);
+  VecSet(from, 0, 70.5); VecSet(from, 1, 60.5);
+  VecSet(to, 0, 40.5); VecSet(to, 1, 25.5);
+  if (list == NULL) TGAFillEllipse(tga, from, to, pen);
+  else TGADrawListFillEllipse(list, from, to, pen);
+  // A curve with an antialiased round pencil
+  TGAPencilSetAntialias(pen, true);
+  TGAPencilSetThickness(pen, 5.0);
+  pix->_rgba[0] = 200; pix->_rgba[1] = 0; pix->_rgba[2] = 100; 
+  pix->_rgba[3] = 255;
+  TGAPencilSetColor(pen, pix);
+  VecSet(from, 0, 10.5); VecSet(from, 1, 190.5);
+  BCurveSet(curve, 0, from);
+  VecSet(from, 0, 120.5); VecSet(from, 1, -50.5);
+  BCurveSet(curve, 1, from);
+  VecSet(from, 0, 200.5); VecSet(from, 1, 250.5);
+  BCurveSet(curve, 2, from);
+  VecSet(from, 0, 290.5); VecSet(from, 1, 10.5);
+  BCurveSet(curve, 3, from);
+  if (list == NULL) TGADrawCurve(tga, curve, pen);
+  else TGADrawListDrawBCurve(list, curve, pen);
+  // A filled shapoid with blended colors
+  TGAPencilSetShapePixel(pen);
+  TGAPencilSetAntialias(pen, false);
+  pix->_rgba[0] = 255; pix->_rgba[1] = 0; pix->_rgba[2] = 0; 
+  TGAPencilSelectColor(pen, 0);
+  TGAPencilSetColor(pen, pix);
+  pix->_rgba[0] = 0; pix->_rgba[1] = 0; pix->_rgba[2] = 255; 
+  TGAPencilSelectColor(pen, 1);
+  TGAPencilSetColor(pen, pix);
+  TGAPencilSetModeColorBlend(pen, 0, 1);
+  VecSet(from, 0, 50.0); VecSet(from, 1, 0.0);
+  ShapoidSetAxis(shapoid, 0, from);
+  VecSet(from, 0, 10.0); VecSet(from, 1, 30.0);
+  ShapoidSetAxis(shapoid, 1, from);
+  VecSet(from, 0, 230.0); VecSet(from, 1, 40.0);
+  ShapoidSetPos(shapoid, from);
+  if (list == NULL) TGAFillShapoid(tga, shapoid, pen);
+  else TGADrawListFillShapoid(list, shapoid, pen);
+  // A string
+  TGAPencilSetModeColorSolid(pen);
+  TGAPencilSelectColor(pen, 0);
+  pix->_rgba[0] = pix->_rgba[1] = pix->_rgba[2] = 0;
+  TGAPencilSetColor(pen, pix);
+  TGAPencilSetThickness(pen, 1.0);
+  VecSet(from, 0, 150.0); VecSet(from, 1, 190.0);
+  if (list == NULL) 
+    TGAPrintString(tga, pen, font, (unsigned char *)"TGAPaint", from);
+  else 
+    TGADrawListPrintString(list, pen, font, 
+      (unsigned char *)"TGAPaint", from);
+  // Free memory
+  BCurveFree(&curve);
+  ShapoidFree(&shapoid);
+  TGAPixelFree(&pix);
+  VecFree(&from);
+  VecFree(&to);
+}
+
+// Return true if the current layers of the TGAs 'a' and 'b' have the
+// same dimensions and pixels
+bool IsSamePixels(TGA *a, TGA *b) {
+  VecShort *dimA = a->_curLayer->_dim;
+  VecShort *dimB = b->_curLayer->_dim;
+  if (VecGet(dimA, 0) != VecGet(dimB, 0) || 
+    VecGet(dimA, 1) != VecGet(dimB, 1))
+    return false;
+  long nbPix = (long)VecGet(dimA, 0) * (long)VecGet(dimA, 1);
+  return (memcmp(a->_curLayer->_pixels, b->_curLayer->_pixels, 
+    nbPix * sizeof(TGAPixel)) == 0);
+}
+
+// Return the largest difference of the values of the current layers
+// of the TGAs 'a' and 'b' (of same dimensions) over the pixels at 
+// more than 'margin' from the borders
+int GetMaxDiff(TGA *a, TGA *b, int margin) {
+  int w = VecGet(a->_curLayer->_dim, 0);
+  int h = VecGet(a->_curLayer->_dim, 1);
+  int maxDiff = 0;
+  for (int y = margin; y < h - margin; ++y) {
+    for (int x = margin; x < w - margin; ++x) {
+      TGAPixel *pixA = a->_curLayer->_pixels + (long)y * w + x;
+      TGAPixel *pixB = b->_curLayer->_pixels + (long)y * w + x;
+      for (int iRgba = 4; iRgba--;) {
+        int diff = abs(pixA->_rgba[iRgba] - pixB->_rgba[iRgba]);
+        if (diff > maxDiff)
+          maxDiff = diff;
+      }
+    }
+  }
+  return maxDiff;
+}
+
+// Create a copy of the TGA 'tga' (same dimensions and pixels of the
+// current layer) and apply on it the filter 'iFilter' with 'nbThread'
+// threads, using the TGAKernel 'kernels' for the convolutions
+// Return NULL if we couldn't allocate memory
+TGA* CreateFiltered(TGA *tga, int iFilter, TGAKernel **kernels, 
+  int nbThread) {
+  TGA *ret = TGACreate(tga->_curLayer->_dim, NULL);
+  if (ret == NULL)
+    return NULL;
+  long nbPix = (long)VecGet(tga->_curLayer->_dim, 0) * 
+    (long)VecGet(tga->_curLayer->_dim, 1);
+  memcpy(ret->_curLayer->_pixels, tga->_curLayer->_pixels, 
+    nbPix * sizeof(TGAPixel));
+  TGALayer *layer = ret->_curLayer;
+  VecShort *bound = VecShortCreate(4);
+  if (bound == NULL) {
+    TGAFree(&ret);
+    return NULL;
+  }
+  VecSet(bound, 0, 40); VecSet(bound, 1, 30);
+  VecSet(bound, 2, 220); VecSet(bound, 3, 150);
+  switch (iFilter) {
+    case 0:
+      TGALayerFilterGaussBlur(layer, NULL, 3.0, 10.0, nbThread);
+      break;
+    case 1:
+      TGALayerFilterGaussBlurBox(layer, NULL, 12.0, nbThread);
+      break;
+    case 2:
+      TGALayerFilterGaussBlurRecursive(layer, NULL, 12.0, nbThread);
+      break;
+    case 3:
+      TGALayerFilterGaussBlurRecursive(layer, bound, 6.0, nbThread);
+      break;
+    case 4:
+      TGALayerFilterConvolve(layer, NULL, kernels[0], 
+        tgaConvEdgeClamp, nbThread);
+      break;
+    case 5:
+      TGALayerFilterConvolve(layer, NULL, kernels[1], 
+        tgaConvEdgeMirror, nbThread);
+      break;
+    case 6:
+      TGALayerFilterConvolve(layer, bound, kernels[2], 
+        tgaConvEdgeTransparent, nbThread);
+      break;
+    case 7:
+      TGALayerFilterConvolve(layer, NULL, kernels[3], 
+        tgaConvEdgeWrap, nbThread);
+      break;
+    default:
+      break;
+  }
+  VecFree(&bound);
+  return ret;
+}
+
 int main(void) {
   int ret;
   TGA *theTGA;
@@ -228,7 +427,123 @@ int main(void) {
   }
   // Print its header on standard output stream
   TGAPrintHeader(theTGA, stdout);
+  // Save the TGA with run-length encoding and load it again
+  TGASaveRLE(theTGA, "./outRLE.tga");
+  ret = TGALoad(&theTGA, "./outRLE.tga");
+  if (ret != 0) {
+    fprintf(stderr, "Error while opening the file : %d\n", ret);
+    return 9;
+  }
+  // Draw a scene directly and with a draw list, and check they give
+  // the same pixels
+  printf("Draw a scene with a draw list\n");
+  VecSet(dim, 0, 300); VecSet(dim, 1, 200);
+  pix->_rgba[0] = pix->_rgba[1] = pix->_rgba[2] = pix->_rgba[3] = 255;
+  TGA *sceneTGA = TGACreate(dim, pix);
+  TGA *listTGA = TGACreate(dim, pix);
+  TGADrawList *list = TGADrawListCreate();
+  if (sceneTGA == NULL || listTGA == NULL || list == NULL) {
+    fprintf(stderr, "Can't create the scene\n");
+    return 10;
+  }
+  DrawScene(sceneTGA, NULL, pen, font);
+  DrawScene(NULL, list, pen, font);
+  TGAExecDrawList(listTGA, list);
+  if (IsSamePixels(sceneTGA, listTGA) == false) {
+    fprintf(stderr, "The draw list differs from direct drawing\n");
+    return 11;
+  }
+  // Execute the same draw list by tiles with various numbers of
+  // threads, and check it gives the same pixels too
+  printf("Draw a scene with a draw list by tiles\n");
+  int nbThreads[4] = {1, 3, 5, 16};
+  for (int iThread = 0; iThread < 4; ++iThread) {
+    TGA *tiledTGA = TGACreate(dim, pix);
+    if (tiledTGA == NULL) {
+      fprintf(stderr, "Can't create the scene\n");
+      return 10;
+    }
+    TGAExecDrawListTiled(tiledTGA, list, nbThreads[iThread]);
+    bool isSame = IsSamePixels(sceneTGA, tiledTGA);
+    TGAFree(&tiledTGA);
+    if (isSame == false) {
+      fprintf(stderr, "The tiled draw list differs from direct "
+        "drawing (%d threads)\n", nbThreads[iThread]);
+      return 12;
+    }
+  }
+  TGASave(sceneTGA, "./outScene.tga");
+  // Apply each filter on the scene and save the result, checking it
+  // doesn't depend on the number of threads
+  printf("Apply filters on the scene\n");
+  TGAKernel *kernels[4] = {TGAKernelCreateSharpen(1.0), 
+    TGAKernelCreateEmboss(), TGAKernelCreateEdge(), 
+    TGAKernelCreateGauss(2.0, 7.0)};
+  if (kernels[0] == NULL || kernels[1] == NULL || 
+    kernels[2] == NULL || kernels[3] == NULL) {
+    fprintf(stderr, "Can't create the kernels\n");
+    return 13;
+  }
+  TGAKernelSetFixed(kernels[3], true);
+  char *filterPath[8] = {"./outGaussBlur.tga", "./outGaussBlurBox.tga",
+    "./outGaussBlurRecursive.tga", "./outGaussBlurBound.tga", 
+    "./outSharpen.tga", "./outEmboss.tga", "./outEdge.tga", 
+    "./outGaussKernel.tga"};
+  for (int iFilter = 0; iFilter < 8; ++iFilter) {
+    TGA *filteredTGA = CreateFiltered(sceneTGA, iFilter, kernels, 1);
+    if (filteredTGA == NULL) {
+      fprintf(stderr, "Can't filter the scene\n");
+      return 13;
+    }
+    for (int iThread = 1; iThread < 4; ++iThread) {
+      TGA *checkTGA = 
+        CreateFiltered(sceneTGA, iFilter, kernels, nbThreads[iThread]);
+      if (checkTGA == NULL) {
+        fprintf(stderr, "Can't filter the scene\n");
+        return 13;
+      }
+      bool isSame = IsSamePixels(filteredTGA, checkTGA);
+      TGAFree(&checkTGA);
+      if (isSame == false) {
+        fprintf(stderr, "The filter %s depends on the number of "
+          "threads (%d threads)\n", filterPath[iFilter], 
+          nbThreads[iThread]);
+        return 14;
+      }
+    }
+    TGASave(filteredTGA, filterPath[iFilter]);
+    TGAFree(&filteredTGA);
+  }
+  // Check the bound on the error of the blur by boxes on a noisy 
+  // image
+  printf("Check the error of the blur by boxes\n");
+  TGA *noiseTGA = TGACreate(dim, NULL);
+  TGA *boxTGA = TGACreate(dim, NULL);
+  if (noiseTGA == NULL || boxTGA == NULL) {
+    fprintf(stderr, "Can't create the noisy image\n");
+    return 13;
+  }
+  srand(1);
+  for (int iPix = VecGet(dim, 0) * VecGet(dim, 1); iPix--;)
+    for (int iRgba = 4; iRgba--;) {
+      unsigned char val = rand() % 256;
+      noiseTGA->_curLayer->_pixels[iPix]._rgba[iRgba] = val;
+      boxTGA->_curLayer->_pixels[iPix]._rgba[iRgba] = val;
+    }
+  TGAFilterGaussBlur(noiseTGA, 12.0, 37.0);
+  TGAFilterGaussBlurBox(boxTGA, 12.0);
+  if (GetMaxDiff(noiseTGA, boxTGA, 36) > 1) {
+    fprintf(stderr, "The blur by boxes is too far from the gaussian\n");
+    return 15;
+  }
+  TGAFree(&noiseTGA);
+  TGAFree(&boxTGA);
+  for (int iKernel = 4; iKernel--;)
+    TGAKernelFree(kernels + iKernel);
   // Free the memory
+  TGADrawListFree(&list);
+  TGAFree(&sceneTGA);
+  TGAFree(&listTGA);
   ShapoidFree(&shapoid);
   VecFree(&pos);
   VecFree(&dim);
@@ -0,0 +1,156 @@
+// *************** TGACONVOL.C ***************
+
+// Convolution of rows of packed RGBA pixels by the coefficients of a
+// kernel, in float and fixed point, with SSE2 versions selected at
+// runtime on x86 and scalar versions elsewhere
+
+// ================= Define ==================
+
+// Signature of the float and fixed point row convolution kernels
+typedef void (*TGARowConvolveKernel)(float *acc, unsigned char *src,
+  float *coeff, int nbCoeff, long nb);
+typedef void (*TGARowConvolveFixedKernel)(int *acc, unsigned char *src,
+  short *coeff, int nbCoeff, long nb);
+
+// ================ Global variables ====================
+
+// Kernels used by the TGARowConvolve* functions, selected once by
+// TGARowConvolveSelect
+static TGARowConvolveKernel TGARowKernelConvolve = NULL;
+static TGARowConvolveFixedKernel TGARowKernelConvolveFixed = NULL;
+static pthread_once_t TGARowConvolveOnce = PTHREAD_ONCE_INIT;
+
+// ================ Functions declaration ====================
+
+// Select the fastest convolution kernels available on the current CPU
+// Must be called before the TGARowConvolve* functions, it is safe to
+// call it from several threads
+static void TGARowConvolveSelect(void);
+
+// Add to the 'nb' pixels (4 floats each) of 'acc' the convolution of
+// the pixels of 'src' by the 'nbCoeff' coefficients 'coeff':
+// acc[i] += sum_k coeff[k] * src[i + k]
+static void TGARowConvolve(float *acc, unsigned char *src, 
+  float *coeff, int nbCoeff, long nb);
+
+// Add to the 'nb' pixels (4 ints each) of 'acc' the convolution of
+// the pixels of 'src' by the 'nbCoeff' fixed point coefficients
+// 'coeff': acc[i] += sum_k coeff[k] * src[i + k]
+static void TGARowConvolveFixed(int *acc, unsigned char *src, 
+  short *coeff, int nbCoeff, long nb);
+
+// ================ Functions implementation ==================
+
+// Scalar version of TGARowConvolve
+static void TGARowConvolveScalar(float *acc, unsigned char *src,
+  float *coeff, int nbCoeff, long nb) {
+  for (long i = 0; i < nb; ++i, acc += 4, src += 4)
+    for (int k = 0; k < nbCoeff; ++k)
+      for (int c = 0; c < 4; ++c)
+        acc[c] += coeff[k] * (float)(src[4 * k + c]);
+}
+
+// Scalar version of TGARowConvolveFixed
+static void TGARowConvolveFixedScalar(int *acc, unsigned char *src,
+  short *coeff, int nbCoeff, long nb) {
+  for (long i = 0; i < nb; ++i, acc += 4, src += 4)
+    for (int k = 0; k < nbCoeff; ++k)
+      for (int c = 0; c < 4; ++c)
+        acc[c] += coeff[k] * (int)(src[4 * k + c]);
+}
+
+#ifdef TGA_SIMD_X86
+
+// SSE2 version of TGARowConvolve, the four channels of a pixel in one
+// vector
+__attribute__((target("sse2")))
+static void TGARowConvolveSSE2(float *acc, unsigned char *src,
+  float *coeff, int nbCoeff, long nb) {
+  const __m128i zero = _mm_setzero_si128();
+  for (long i = 0; i < nb; ++i, acc += 4, src += 4) {
+    __m128 sum = _mm_loadu_ps(acc);
+    for (int k = 0; k < nbCoeff; ++k) {
+      int v;
+      memcpy(&v, src + 4 * k, 4);
+      __m128i p = _mm_unpacklo_epi16(
+        _mm_unpacklo_epi8(_mm_cvtsi32_si128(v), zero), zero);
+      sum = _mm_add_ps(sum,
+        _mm_mul_ps(_mm_set1_ps(coeff[k]), _mm_cvtepi32_ps(p)));
+    }
+    _mm_storeu_ps(acc, sum);
+  }
+}
+
+// SSE2 version of TGARowConvolveFixed, the four channels of a pixel
+// in one vector and two coefficients per multiplication
+__attribute__((target("sse2")))
+static void TGARowConvolveFixedSSE2(int *acc, unsigned char *src,
+  short *coeff, int nbCoeff, long nb) {
+  const __m128i zero = _mm_setzero_si128();
+  for (long i = 0; i < nb; ++i, acc += 4, src += 4) {
+    __m128i sum = _mm_loadu_si128((__m128i*)acc);
+    int k = 0;
+    for (; k + 2 <= nbCoeff; k += 2) {
+      // Interleave the channels of the two pixels and multiply them
+      // by the interleaved pair of coefficients
+      __m128i p = _mm_unpacklo_epi8(
+        _mm_loadl_epi64((__m128i*)(src + 4 * k)), zero);
+      p = _mm_unpacklo_epi16(p, _mm_srli_si128(p, 8));
+      __m128i c = _mm_set1_epi32((int)((unsigned short)coeff[k] |
+        ((unsigned int)(unsigned short)coeff[k + 1] << 16)));
+      sum = _mm_add_epi32(sum, _mm_madd_epi16(p, c));
+    }
+    if (k < nbCoeff) {
+      int v;
+      memcpy(&v, src + 4 * k, 4);
+      __m128i p = _mm_unpacklo_epi16(
+        _mm_unpacklo_epi8(_mm_cvtsi32_si128(v), zero), zero);
+      sum = _mm_add_epi32(sum,
+        _mm_madd_epi16(p, _mm_set1_epi32((unsigned short)coeff[k])));
+    }
+    _mm_storeu_si128((__m128i*)acc, sum);
+  }
+}
+
+#endif
+
+// Set the kernels to the fastest ones available on the current CPU,
+// called once by TGARowConvolveSelect
+static void TGARowConvolveSelectOnce(void) {
+  // Select the scalar kernels by default
+  TGARowKernelConvolve = TGARowConvolveScalar;
+  TGARowKernelConvolveFixed = TGARowConvolveFixedScalar;
+#ifdef TGA_SIMD_X86
+  // Select the vector kernels supported by the CPU
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("sse2")) {
+    TGARowKernelConvolve = TGARowConvolveSSE2;
+    TGARowKernelConvolveFixed = TGARowConvolveFixedSSE2;
+  }
+#endif
+}
+
+// Select the fastest convolution kernels available on the current CPU
+// Must be called before the TGARowConvolve* functions, it is safe to
+// call it from several threads
+static void TGARowConvolveSelect(void) {
+  // Select the kernels the first time, the other callers wait for the
+  // selection and see its result
+  pthread_once(&TGARowConvolveOnce, TGARowConvolveSelectOnce);
+}
+
+// Add to the 'nb' pixels (4 floats each) of 'acc' the convolution of
+// the pixels of 'src' by the 'nbCoeff' coefficients 'coeff':
+// acc[i] += sum_k coeff[k] * src[i + k]
+static void TGARowConvolve(float *acc, unsigned char *src, 
+  float *coeff, int nbCoeff, long nb) {
+  TGARowKernelConvolve(acc, src, coeff, nbCoeff, nb);
+}
+
+// Add to the 'nb' pixels (4 ints each) of 'acc' the convolution of
+// the pixels of 'src' by the 'nbCoeff' fixed point coefficients
+// 'coeff': acc[i] += sum_k coeff[k] * src[i + k]
+static void TGARowConvolveFixed(int *acc, unsigned char *src, 
+  short *coeff, int nbCoeff, long nb) {
+  TGARowKernelConvolveFixed(acc, src, coeff, nbCoeff, nb);
+}
@@ -2,20 +2,287 @@
 
 // ================= Include =================
 
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "tgapaint.h"
 #include "tgafont.c"
+#include "tgaswizzle.c"
+#include "tgaconvol.c"
 
 // ================= Define ==================
 
 #define TGA_PI 3.14159
 #define TGA_EPSILON 0.001
+// Maximum distance in pixel between a curve and the polyline used to 
+// draw it
+#define TGA_FLATNESS 0.25
+// Maximum number of segments of the polyline used to draw a curve
+#define TGA_MAXNBSEGMENT 4096
+// Size in byte of the header of a TGA file
+#define TGA_HEADERSIZE 18
+// Size in byte of the footer of a TGA 2.0 file
+#define TGA_FOOTERSIZE 26
+// Signature at the end of the footer of a TGA 2.0 file
+#define TGA_FOOTERSIGNATURE "TRUEVISION-XFILE."
+// Size in byte of the buffer used to read and write TGA files
+#define TGA_IOBUFSIZE 262144
+// Maximum number of areas of the working layer drawn before being
+// blended when executing a TGADrawList
+#define TGA_DRAWLISTNBAREA 64
+// Maximum ratio between the surface of the union of two areas and the
+// sum of their surfaces to merge them when executing a TGADrawList
+#define TGA_DRAWLISTMERGE 1.25
+// Minimum and maximum number of rows per band of the filters (the 
+// bands are higher if the halo of the filter requires it)
+#define TGA_FILTERBANDMIN 64
+#define TGA_FILTERBANDMAX 512
+// Number of bands per thread of the filters, for the threads to
+// share the work evenly
+#define TGA_FILTERNBBANDPERTHREAD 4
+// Width in pixels of the strips of columns filtered together by the
+// recursive gaussian blur
+#define TGA_FILTERSTRIPWIDTH 16
+
+// ================= Type ==================
+
+// Tiles of a layer to be drawn in parallel with the commands of a 
+// TGADrawList
+typedef struct TGATileJob {
+  // Layer to draw and its working layer
+  TGALayer *_layer;
+  TGALayer *_tmpLayer;
+  // Commands of the list, in their order of recording
+  TGADrawCmd **_cmds;
+  // Number of pencils of the list
+  int _nbPen;
+  // Number of tiles per row, and in total
+  int _nbTileX;
+  int _nbTile;
+  // Indices of the commands of each tile, in their order of recording;
+  // the commands of the i-th tile are from _binCmds[_binStart[i]] to
+  // _binCmds[_binStart[i + 1] - 1]
+  int *_binStart;
+  int *_binCmds;
+  // Index of the next tile to draw
+  _Atomic int _iNextTile;
+} TGATileJob;
+
+// Parameters of the filter convolving a TGAFilterJob
+typedef struct TGAConvParam {
+  // Kernel of the convolution
+  TGAKernel *_kernel;
+  // Policy for the pixels outside the layer
+  tgaConvEdge _edge;
+  // Coefficients of the kernel in fixed point, in the same order as 
+  // _kernel->_coeff, NULL to convolve in float
+  short *_coeffFixed;
+} TGAConvParam;
+
+// Job applying a filter on a box of a layer, split into bands of rows
+// filtered in parallel
+typedef struct TGAFilterJob {
+  // Layer to filter
+  TGALayer *_layer;
+  // Box (x0,y0,x1,y1, included) of the pixels to filter
+  int _box[4];
+  // Distance in pixels, along rows and columns, of the pixels used to
+  // filter a pixel
+  int _halo;
+  // Range of columns (included) of the rows given to the filter, the
+  // columns of the box extended by the halo inside the layer
+  int _cols[2];
+  // Number of threads
+  int _nbThread;
+  // Number of rows per band, and number of bands
+  int _bandHeight;
+  int _nbBand;
+  // Copies, taken before filtering, of the 2 * _halo rows of the box
+  // around each limit between two bands
+  TGAPixel *_haloRows;
+  // Number of rows at the top and bottom of the layer copied before
+  // filtering, for the filters using them in place of the rows 
+  // outside the layer, and their copies
+  int _nbEdgeRow;
+  TGAPixel *_edgeRows;
+  // Function filtering the rows of the 'iBand'-th band of the job 
+  // with the memory 'scratch' of _scratchSize bytes
+  void (*_filter)(struct TGAFilterJob *job, int iBand, void *scratch);
+  // Parameters of the filter
+  void *_param;
+  // Size in bytes of the memory used by the filter per worker
+  size_t _scratchSize;
+  // Index of the next band to filter
+  _Atomic int _iNextBand;
+} TGAFilterJob;
+
+// Worker filtering bands of a TGAFilterJob
+typedef struct TGAFilterWorker {
+  // Job of the worker
+  TGAFilterJob *_job;
+  // Memory used by the filter
+  void *_scratch;
+  // Flag to memorize if the worker has been started in a thread
+  bool _started;
+} TGAFilterWorker;
+
+// Parameters of the filters of TGAFilterJob applying the recursive 
+// gaussian blur
+typedef struct TGARecursiveParam {
+  // Coefficients of the recursive filter
+  float _coef[4];
+  // Box of the blurred pixels (x0,y0,x1,y1, included)
+  int _box[4];
+  // Area of the filtered pixels, the box extended by the halo inside
+  // the layer (x0,y0,x1,y1, included)
+  int _area[4];
+  // Rows of the area above and below the box, in the columns of the
+  // box, blurred along the rows
+  unsigned char *_haloRows;
+} TGARecursiveParam;
+
+// Worker drawing tiles of a TGATileJob
+typedef struct TGATileWorker {
+  // Job of the worker
+  TGATileJob *_job;
+  // Views on the layer to draw and its working layer, sharing their
+  // pixels but with their own dirty and clip boxes
+  TGALayer _layer;
+  TGALayer _tmpLayer;
+  // Copies of the pencils of the list used by the worker, created 
+  // when needed
+  TGAPencil **_pens;
+  // Flag to memorize if the worker has been started in a thread
+  bool _started;
+} TGATileWorker;
 
 // ================ Functions declaration ====================
 
+// The pixels of a layer are converted as rows of RGBA values
+_Static_assert(sizeof(TGAPixel) == 4, "TGAPixel must be packed RGBA");
+
 // Function to decode rgba values when loading a TGA file
 // Do nothing if arguments are invalid
 void MergeBytes(TGAPixel *pixel, unsigned char *p, int bytes);
 
+// Decode the TGA_HEADERSIZE bytes of a TGA file's header in 'buffer'
+// into 'h'
+// Do nothing if arguments are invalid
+void TGAHeaderDecode(TGAHeader *h, unsigned char *buffer);
+
+// Create in 'tga' a TGA with one layer from the TGA_HEADERSIZE bytes 
+// of a TGA file's header in 'buffer'
+// The pixels of the layer are set to rgba(0,0,0,0)
+// Return 0 upon success, else
+// 2 : malloc failed
+// 3 : can only handle image type 2 and 10
+// 4 : can only handle pixel depths of 16, 24, and 32
+// 5 : can only handle colour map types of 0 and 1
+int TGACreateFromHeader(TGA **tga, unsigned char *buffer);
+
+// Map in memory the file pointed to by 'fileName' into 'map' and
+// copy its header in 'head', missing bytes are set to EOF
+// The header is decoded but not checked
+// return 0 upon success, else
+// 1 : couldn't open the file
+// 8 : couldn't map the file in memory
+int TGAMapFile(TGAMap *map, char *fileName, unsigned char *head);
+
+// Initialise the decoder 'dec' for the pixels of a TGA file with 
+// header 'h'
+// Do nothing if arguments are invalid
+void TGADecoderInit(TGADecoder *dec, TGAHeader *h);
+
+// Decode at most 'nbPix' pixels from the 'size' bytes of 'data' into
+// 'pix' with the decoder 'dec'
+// Only complete pixels and packet headers are consumed, the current 
+// packet is memorized in 'dec' for the next call
+// Set 'nbDecoded' to the number of decoded pixels
+// Return the number of bytes consumed in 'data'
+long TGADecoderDecode(TGADecoder *dec, unsigned char *data, long size,
+  TGAPixel *pix, long nbPix, long *nbDecoded);
+
+// Decode 'nb' uncompressed pixels of 'bytes' bytes from 'data' 
+// into 'pix'
+void TGADecodePixels(TGAPixel *pix, unsigned char *data, long nb, 
+  int bytes);
+
+// Decode 'nb' pixels of the reader 'reader' into 'pix', reading the
+// file as needed
+// Return false if the end of file is reached before
+bool TGAReaderDecode(TGAReader *reader, TGAPixel *pix, long nb);
+
+// Save the current layer of the TGA 'tga' to the file pointed to by 
+// 'fileName' with data type 'dataTypeCode' (2 or 10) and 
+// 'bitsPerPixel' bits per pixel (16, 24 or 32)
+// return 0 upon success, else
+// 1 : couldn't open the file
+// 2 : invalid arguments
+// 3 : couldn't write the file or allocate memory
+int TGAWrite(TGA *tga, char *fileName, char dataTypeCode, 
+  char bitsPerPixel);
+
+// Write the header and the pixels of the current layer of the TGA 
+// 'tga' into the write buffer 'buffer' with data type 'dataTypeCode' 
+// (2 or 10) and 'bitsPerPixel' bits per pixel (16, 24 or 32)
+// return 0 upon success, else
+// 3 : malloc failed
+int TGAWriteLayer(TGA *tga, TGAWriteBuffer *buffer, char dataTypeCode,
+  char bitsPerPixel);
+
+// Write into the write buffer 'buffer' the header 'h' modified for
+// data type 'dataTypeCode' and 'bitsPerPixel' bits per pixel
+// The identification field and color map are not saved
+void TGAWriteHeader(TGAWriteBuffer *buffer, TGAHeader *h, 
+  char dataTypeCode, char bitsPerPixel);
+
+// Encode and write into the write buffer 'buffer' the 'nbRow' rows of 
+// 'width' pixels in 'pix' with data type 'dataTypeCode' and 'bytes'
+// bytes per pixel, using 'row' as the buffer for one encoded row
+void TGAWriteRows(TGAWriteBuffer *buffer, TGAPixel *pix, short width, 
+  short nbRow, char dataTypeCode, int bytes, unsigned char *row);
+
+// Get the number of bits per pixel used to save the TGA 'tga' with
+// TGA_BPP_AUTO: 24 if all the pixels of the current layer are opaque,
+// else 32
+char TGAGetAutoBitsPerPixel(TGA *tga);
+
+// Encode the header 'h' into the TGA_HEADERSIZE bytes of 'buffer'
+void TGAHeaderEncode(TGAHeader *h, unsigned char *buffer);
+
+// Encode 'nb' pixels from 'pix' as uncompressed pixels of 'bytes' 
+// bytes into 'data'
+void TGAEncodePixels(TGAPixel *pix, long nb, int bytes, 
+  unsigned char *data);
+
+// Encode 'nb' pixels from 'pix' as run-length encoded pixels of 
+// 'bytes' bytes into 'data', which must be able to contain 
+// nb * (bytes + 1) bytes
+// Packets don't cross the end of the 'nb' pixels
+// Return the number of bytes written in 'data'
+long TGAEncodeRLE(TGAPixel *pix, long nb, int bytes, 
+  unsigned char *data);
+
+// Add the 'size' bytes of 'data' to the write buffer 'buffer',
+// flushing it when it's full
+void TGAWriteBufferPut(TGAWriteBuffer *buffer, unsigned char *data, 
+  long size);
+
+// Write the content of the write buffer 'buffer' to its stream and
+// empty it
+// Do nothing if the buffer has no stream
+void TGAWriteBufferFlush(TGAWriteBuffer *buffer);
+
+// Reallocate the write buffer without stream 'buffer' to be able to
+// add at least 'size' bytes
+// Return false if the buffer is not growable or the reallocation 
+// failed
+bool TGAWriteBufferGrow(TGAWriteBuffer *buffer, long size);
+
 // Draw one stroke at 'pos' with 'pen' of type tgaPenShapoid
 // in current layer
 // Don't do anything in case of invalid arguments
@@ -43,6 +310,349 @@ void TGALayerStrokePixOnePixel(TGALayer *that,
 // do nothing if arguments are invalid
 void TGALayerAddCurve(TGALayer *layer, BCurve *curve, TGAPencil *pen);
 
+// Get the interval ['from','to'] of abscissa of the points of the 
+// Shapoid 's' (of dimension 2) at ordinate 'y'
+// 'inv' is the inverse of the matrix of the axis of 's' (row major)
+// Return false if the Shapoid has no point at ordinate 'y'
+bool TGAShapoidGetSpan(Shapoid *s, float *inv, float y, 
+  float *from, float *to);
+
+// Fill the Shapoid 's' (of dimension 2) with the pencil 'pen' in the 
+// layer 'that', row by row along the spans of the Shapoid
+// If the pencil is a pixel with antialias the pixels are mixed 
+// according to their coverage by the Shapoid, else each position 
+// inside the Shapoid at integer distance from the origin of its
+// bounding box is stroked
+// Do nothing if arguments are invalid
+void TGALayerFillShapoid(TGALayer *that, Shapoid *s, TGAPencil *pen);
+
+// Get in 'inv' the inverse of the matrix of the axis of the Shapoid
+// 's' (of dimension 2), row major
+// Return false if the Shapoid is degenerated
+bool TGAShapoidGetInverse(Shapoid *s, float *inv);
+
+// Mix the pixels inside the Shapoid 's' (of dimension 2) of the 
+// layer 'that' with the color of the pencil 'pen', whatever its shape
+// If the pencil uses antialias the pixels are mixed according to 
+// their coverage by the Shapoid, else the pixels containing a 
+// position inside the Shapoid at integer distance from 'org' (the
+// origin of the bounding box of the Shapoid if 'org' is NULL) are 
+// mixed
+// In tgaPenBlend mode, the blend of the pencil goes from 'blend[0]'
+// to 'blend[1]' along the first axis of the Shapoid if 'blend' is not
+// NULL, else it's 1.0 minus the depth of the position in the Shapoid
+void TGALayerFillShapoidPix(TGALayer *that, Shapoid *s, float *org,
+  TGAPencil *pen, float *blend);
+
+// Get the blend of a pencil in tgaPenBlend mode at the position 'pos'
+// in the Shapoid 's' ('inv' is the inverse of the matrix of its axis)
+// If 'blend' is not NULL, it goes from 'blend[0]' to 'blend[1]' along
+// the first axis of the Shapoid, else it's 1.0 minus the depth of 
+// the position
+float TGAShapoidGetPosBlend(Shapoid *s, float *inv, VecFloat *pos, 
+  float *blend);
+
+// Get in 'kMin' and 'kMax' the points of the Shapoid 's' (of 
+// dimension 2) respectively minimizing and maximizing the dot product
+// with 'n'
+void TGAShapoidGetSupport(Shapoid *s, float *n, float *kMin, 
+  float *kMax);
+
+// Mix the pixel ('x','y') of the layer 'that' with the color of the
+// pencil 'pen' for the blend 'blend', with the ratio 'ratio'
+// Pixels outside the clip box of the layer or in read only mode are
+// ignored
+// The dirty box of the layer is not updated
+void TGALayerMixPix(TGALayer *that, int x, int y, TGAPencil *pen, 
+  float blend, float ratio);
+
+// Add the polyline made of the 'nbPoint' points 'pts' (pairs of x,y)
+// in 'layer' with the pencil 'pen'
+// In tgaPenBlend mode the blend of the pencil is 'blend[i]' at the
+// i-th point and varies linearly along the segments
+// Pixel pencils are drawn with Bresenham's algorithm, or Wu's 
+// algorithm if they use antialias. Shapoid pencils are drawn as the
+// quads swept by the tip along the segments, plus the tip itself
+// at the ends and where the polyline turns
+// do nothing if arguments are invalid
+void TGALayerAddPolyline(TGALayer *layer, float *pts, float *blend,
+  int nbPoint, TGAPencil *pen);
+
+// Add the segment from 'from' to 'to' (x,y pairs) in 'layer' with 
+// the pixel pencil 'pen' using Bresenham's algorithm
+// In tgaPenBlend mode the blend of the pencil goes from 'blend[0]' 
+// to 'blend[1]' along the segment
+// If 'first' is false the first pixel of the segment is not drawn
+// Only the steps of the segment inside the clip box of the layer are
+// walked
+void TGALayerAddSegmentBresenham(TGALayer *layer, float *from, 
+  float *to, float *blend, bool first, TGAPencil *pen);
+
+// Add the segment from 'from' to 'to' (x,y pairs) in 'layer' with 
+// the pixel pencil 'pen' using Wu's algorithm
+// In tgaPenBlend mode the blend of the pencil goes from 'blend[0]' 
+// to 'blend[1]' along the segment
+// The pixels at the ends are covered by the part of the segment 
+// inside them, a segment from a point to itself is drawn as a dot
+// Only the steps of the segment inside the clip box of the layer are
+// walked
+void TGALayerAddSegmentWu(TGALayer *layer, float *from, float *to, 
+  float *blend, TGAPencil *pen);
+
+// Get in 't' the range [t[0],t[1]] of the parameters of the points
+// from + t * (to - from) of the segment from 'from' to 'to' (x,y 
+// pairs) inside the box 'box' (x0,y0,x1,y1) with the Liang-Barsky 
+// algorithm
+// Return false if the segment is outside the box
+bool TGAClipSegment(float *from, float *to, float *box, float *t);
+
+// Extend the dirty box of the layer 'that' to contain the box 
+// ('x0','y0')-('x1','y1') (included), clipped to the clip box of the 
+// layer
+void TGALayerAddDirty(TGALayer *that, int x0, int y0, int x1, int y1);
+
+// Calculate the colors of the blend ramp of the TGAPencil 'pen'
+void TGAPencilUpdateRamp(TGAPencil *pen);
+
+// Get the stamp of the tip of the TGAPencil 'pen' for the sub-pixel 
+// phase ('ix', 'iy'), calculating it if needed
+// Return NULL if we couldn't calculate the stamp
+TGAPencilStamp* TGAPencilGetStamp(TGAPencil *pen, int ix, int iy);
+
+// Free the stamps of the TGAPencil 'pen', they are calculated again
+// when needed
+void TGAPencilFreeStamps(TGAPencil *pen);
+
+// Return true if the TGAPencils 'a' and 'b' draw the same way (their
+// current blend is ignored as the drawing functions set it)
+bool TGAPencilIsSame(TGAPencil *a, TGAPencil *b);
+
+// Erase the pixels of the layer 'that' inside the box 
+// ('x0','y0')-('x1','y1') (included, inside the layer)
+// The dirty box of the layer is not updated
+void TGALayerCleanBox(TGALayer *that, int x0, int y0, int x1, int y1);
+
+// Create the Facoid equivalent to the rectangle between 'from' and
+// 'to'
+// Return NULL if arguments are invalid or we couldn't allocate memory
+Shapoid* TGAShapoidCreateRect(VecFloat *from, VecFloat *to);
+
+// Create the Spheroid equivalent to the ellipse at 'center' of radius
+// 'r' (Rx,Ry)
+// Return NULL if arguments are invalid or we couldn't allocate memory
+Shapoid* TGAShapoidCreateEllipse(VecFloat *center, VecFloat *r);
+
+// Get the SCurve of the char 'c' of the font 'font' with its 
+// (bottom, left) position at 'pos'
+// Return NULL if we couldn't allocate memory
+SCurve* TGAFontGetCharCurve(TGAFont *font, unsigned char c, 
+  VecFloat *pos);
+
+// Add to the TGADrawList 'that' a command of type 'type' with pencil
+// 'pen' and geometry 'pts', 'bcurve', 'scurve' or 'shape' according
+// to its type
+// The geometry belongs to the command, it's freed if the command 
+// can't be added
+void TGADrawListAddCmd(TGADrawList *that, tgaDrawCmdType type, 
+  float *pts, BCurve *bcurve, SCurve *scurve, Shapoid *shape, 
+  TGAPencil *pen);
+
+// Free the memory used by the TGADrawCmd 'that' (not its pencil)
+void TGADrawCmdFree(TGADrawCmd **that);
+
+// Update the box of the pixels the TGADrawCmd 'that' may modify
+void TGADrawCmdUpdateBox(TGADrawCmd *that);
+
+// Draw the command 'cmd' in the layer 'that' with the pencil 'pen'
+void TGALayerAddDrawCmd(TGALayer *that, TGADrawCmd *cmd, 
+  TGAPencil *pen);
+
+// Draw in the layer 'that', through its clean working layer 'tmp', 
+// the commands of the set starting at 'elem' if it's not NULL, else 
+// the 'nbCmd' commands 'cmds[iCmds[i]]'
+// The commands are drawn with the pencils 'pens[cmd->_iPen]' (copied
+// from their own pencil when NULL) if 'pens' is not NULL, else with 
+// their own pencil
+// The pixels are clipped to the clip box of 'tmp' and 'tmp' is clean
+// at the end
+void TGALayerExecDrawCmds(TGALayer *that, TGALayer *tmp, 
+  GSetElem *elem, TGADrawCmd **cmds, int *iCmds, int nbCmd, 
+  TGAPencil **pens);
+
+// Blend the 'nbArea' boxes 'areas' (x0,y0,x1,y1 quadruplets, not 
+// overlapping) of the working layer 'tmp' in the layer 'that' and 
+// erase them in the working layer
+void TGALayerBlendAreas(TGALayer *that, TGALayer *tmp, int *areas, 
+  int nbArea);
+
+// Get in 'tiles' the range of tiles (x0,y0,x1,y1, included) of the 
+// TGATileJob 'that' overlapped by the box of the command 'cmd'
+// Return false if the box is outside the layer
+bool TGATileJobGetTiles(TGATileJob *that, TGADrawCmd *cmd, 
+  int *tiles);
+
+// Initialize the TGATileWorker 'that' for the TGATileJob 'job'
+// Return false if we couldn't allocate memory
+bool TGATileWorkerInit(TGATileWorker *that, TGATileJob *job);
+
+// Free the memory used by the TGATileWorker 'that' (not the worker
+// itself)
+void TGATileWorkerFree(TGATileWorker *that);
+
+// Draw the tiles of the job of the TGATileWorker 'arg' until there is
+// no more tile to draw
+// Return NULL (for pthread_create)
+void* TGATileWorkerRun(void *arg);
+
+// Set the clip box of the view 'view' on the layer 'layer' to the
+// intersection of the tile 'tile' (x0,y0,x1,y1, included) with the 
+// clip box of 'layer'
+void TGATileWorkerClip(TGALayer *view, TGALayer *layer, int *tile);
+
+// Get in 'box' the box (x0,y0,x1,y1, included) 'bound' (the whole 
+// layer if NULL) of the layer 'that' clipped to its clip box
+// Return false if the box is empty
+bool TGALayerGetFilterBox(TGALayer *that, VecShort *bound, int *box);
+
+// Calculate in 'coef' the coefficients (B, b1/b0, b2/b0, b3/b0) of the
+// recursive filter of Young and van Vliet approximating a gaussian of 
+// standard deviation 'sigma' (>= 0.5)
+void TGAGaussGetRecursiveCoef(float sigma, float *coef);
+
+// Apply forward then backward the recursive filter of coefficients 
+// 'coef' on the 'nb' samples of 'data', each sample made of 'nbLane'
+// contiguous values, separated by 'stride' values
+// The samples before the first one and after the last one are 
+// considered equal to them
+void TGAFilterRecursive(float *data, int nb, long stride, int nbLane,
+  float *coef);
+
+// Get the row 'y' of the area of the TGARecursiveParam of the 
+// TGAFilterJob 'job', blurred along the rows if it is outside the box
+// of the blur
+// Return a pointer to its values in the first column of the box
+unsigned char* TGAFilterRecursiveGetRow(TGAFilterJob *job, int y);
+
+// Filter of TGAFilterJob blurring along the rows the 'iBand'-th band
+// of 'job' with the TGARecursiveParam in its parameters, the band 
+// covering the rows of the area, the rows outside the box being 
+// written in the param's _haloRows
+// 'scratch' holds one row of the area in float
+void TGAFilterRecursiveRowBand(TGAFilterJob *job, int iBand, 
+  void *scratch);
+
+// Filter of TGAFilterJob blurring along the columns the 'iStrip'-th 
+// strip of TGA_FILTERSTRIPWIDTH columns of the box of 'job' with the
+// TGARecursiveParam in its parameters, the rows having been blurred
+// 'scratch' holds the strip over the rows of the area in float
+void TGAFilterRecursiveColumnStrip(TGAFilterJob *job, int iStrip, 
+  void *scratch);
+
+// Calculate in 'radius' the radius of the 'nbPass' successive box 
+// blurs whose variance is the nearest to the one of a gaussian of 
+// standard deviation 'sigma'
+void TGAGaussGetBoxRadius(float sigma, int nbPass, int *radius);
+
+// Apply a box blur of 'radius' on the 'nb' samples of 'from' and 
+// memorize the result in 'to', each sample made of 'nbLane' 
+// contiguous values, separated by 'stride' values
+// 'sums' is a buffer of 'nbLane' values for the running sums
+// The samples before the first one and after the last one are 
+// considered equal to them
+void TGAFilterBox(unsigned char *from, unsigned char *to, int nb, 
+  long stride, int nbLane, int radius, unsigned int *sums);
+
+// Initialize the TGAFilterJob 'that' to filter the box 'box' (x0,y0,
+// x1,y1, included, inside the layer) of the layer 'layer' with a
+// filter using the pixels at a distance up to 'halo' from the 
+// filtered ones, with 'nbThread' threads (as many as processors if 
+// 'nbThread' < 1)
+// The filter, its parameters and the size of its memory per worker 
+// must be set before running the job
+void TGAFilterJobInit(TGAFilterJob *that, TGALayer *layer, int *box, 
+  int halo, int nbThread);
+
+// Run the TGAFilterJob 'that' with its threads (no more than bands)
+// Return false if we couldn't allocate memory, in which case the 
+// layer is unchanged
+bool TGAFilterJobRun(TGAFilterJob *that);
+
+// Get in 'y0' and 'y1' the first and last rows of the 'iBand'-th band
+// of the TGAFilterJob 'that'
+void TGAFilterJobGetBand(TGAFilterJob *that, int iBand, int *y0, 
+  int *y1);
+
+// Get the row 'y' of the layer of the TGAFilterJob 'that', as it was
+// before filtering, for the 'iBand'-th band. The row must be at a 
+// distance up to the halo of the band
+// Return a pointer to its pixel in the first column of _cols, or NULL
+// if the row is outside the layer
+// The rows of the band are the ones of the layer, so the filter must
+// get them before modifying them
+TGAPixel* TGAFilterJobGetRow(TGAFilterJob *that, int iBand, int y);
+
+// Get the copy of the row 'y' of the layer of the TGAFilterJob 'that'
+// taken before filtering, 'y' being one of the _nbEdgeRow rows at 
+// the top or bottom of the layer
+// Return a pointer to its pixel in the first column of _cols
+TGAPixel* TGAFilterJobGetEdgeRow(TGAFilterJob *that, int y);
+
+// Filter the bands of the job of the TGAFilterWorker 'arg' until 
+// there is no more band to filter
+// Return NULL (for pthread_create)
+void* TGAFilterWorkerRun(void *arg);
+
+// Filter of TGAFilterJob blurring the 'iBand'-th band of 'job' with 
+// the separable normalized kernel in its parameters (values for 
+// distances 0 to its halo), renormalized where the window is cut by
+// the border of the layer
+// 'scratch' holds a ring of (2 * halo + 1) rows blurred along the 
+// rows followed by the accumulator of one row
+void TGAFilterGaussBand(TGAFilterJob *job, int iBand, void *scratch);
+
+// Filter of TGAFilterJob blurring the 'iBand'-th band of 'job' with 
+// the TGA_GAUSSBOXNBPASS successive box blurs whose radius are in its
+// parameters, the pixels outside the layer being equal to the nearest
+// pixel on its border
+// 'scratch' holds two copies of the band extended by the halo 
+// followed by the running sums of one row
+// The rows and columns of the extension are blurred with a wrong
+// border but the error moves inward by the radius of the box at each 
+// pass, hence it doesn't reach the band
+void TGAFilterBoxBand(TGAFilterJob *job, int iBand, void *scratch);
+
+// Get in 'coeff' the coefficients of the TGAKernel 'that' in fixed
+// point with TGA_KERNELFIXEDSHIFT bits of fraction, the rounding 
+// error of their sum (along each axis if the kernel is separable) 
+// being given to the largest one so that the sum is preserved
+// Return false if the sum of the absolute values of the coefficients 
+// is not lower than TGA_KERNELFIXEDMAX
+bool TGAKernelGetFixed(TGAKernel *that, short *coeff);
+
+// Get the position of 'x' (outside [0,n-1]) in [0,n-1] according to 
+// the policy 'edge'
+// Return -1 if the position is transparent
+int TGAConvGetEdgePos(int x, int n, tgaConvEdge edge);
+
+// Get in 'ext' the pixels of the row 'y' of the layer of the 
+// TGAFilterJob 'job' for the 'iBand'-th band, from the first column
+// of the box minus 'radius' to the last column of the box plus 
+// 'radius', the pixels outside the layer being given by the policy
+// 'edge'
+// 'y' must be at a distance up to the halo of the band, and if it is
+// outside the layer the job must have copies of the rows near the 
+// border of the layer for the policy
+void TGAFilterJobGetConvRow(TGAFilterJob *job, int iBand, int y, 
+  tgaConvEdge edge, int radius, unsigned char *ext);
+
+// Filter of TGAFilterJob convolving the 'iBand'-th band of 'job' with
+// the TGAConvParam in its parameters
+// 'scratch' holds a ring of rows (source rows extended by the radius 
+// of the kernel if it is not separable, else rows convolved along the
+// rows followed by one extended source row) and the accumulator of 
+// one row
+void TGAFilterConvolveBand(TGAFilterJob *job, int iBand, void *scratch);
+
 // ================ Functions implementation ==================
 
 // Create a TGA of width dim[0] and height dim[1] and background
@@ -194,855 +804,3472 @@ void TGAFree(TGA **tga) {
 // 7 : invalid arguments
 int TGALoad(TGA **tga, char *fileName) {
   // Check arguments
-  if (fileName == NULL) return 7;
+  if (tga == NULL || fileName == NULL) return 7;
   // If the TGA in argument is already used
   if (*tga != NULL)
     // Free memory
     TGAFree(tga);
-  // Create a VecShort to memorize the dimensions
-  VecShort *dim = VecShortCreate(2);
-  // If we couldn't allocate memory
-  if (dim == NULL) {
-    // Stop here
-    return 2;
-  }
-  // Allocate memory for the TGA
-  *tga = (TGA*)malloc(sizeof(TGA));
-  // If we couldn't allocate memory
-  if (*tga == NULL) {
-    // Stop here
-    TGAFree(tga);
-    return 2;
-  }
-  // Set pointers to NULL
-  (*tga)->_header = NULL;
-  (*tga)->_layers = NULL;
-  (*tga)->_curLayer = NULL;
-  (*tga)->_tmpLayer = NULL;
-  // Declare variables used during decoding
-  int n = 0, i = 0, j = 0;
-  unsigned int bytes2read = 0, skipover = 0;
-  unsigned char p[5] = {0};
-  size_t ret = 0;
   // Open the file
   FILE *fptr = fopen(fileName,"r");
   // If we couldn't open the file
   if (fptr == NULL) {
     // Stop here
-    TGAFree(tga);
     return 1;
   }
-  // Allocate memory for the header
-  (*tga)->_header = (TGAHeader*)malloc(sizeof(TGAHeader));
-  // If we couldn't allocate memory
-  if ((*tga)->_header == NULL) {
+  // Read the header in one block, missing bytes are set to EOF
+  // as fgetc would have done
+  unsigned char buffer[TGA_HEADERSIZE];
+  memset(buffer, 0xFF, TGA_HEADERSIZE);
+  size_t ret = fread(buffer, 1, TGA_HEADERSIZE, fptr);
+  // To avoid warning
+  ret = ret;
+  // Create the TGA from the header
+  int err = TGACreateFromHeader(tga, buffer);
+  // If we couldn't create the TGA
+  if (err != 0) {
     // Stop here
-    TGAFree(tga);
     fclose(fptr);
-    return 2;
+    return err;
   }
   // Set a pointer to the header
   TGAHeader *h = (*tga)->_header;
-  // Read the header's values
-  h->_idLength = fgetc(fptr);
-  h->_colorMapType = fgetc(fptr);
-  h->_dataTypeCode = fgetc(fptr);
-  ret = fread(&(h->_colorMapOrigin), 2, 1, fptr);
-  ret = fread(&(h->_colorMapLength), 2, 1, fptr);
-  h->_colorMapDepth = fgetc(fptr);
-  ret = fread(&(h->_xOrigin), 2, 1, fptr);
-  ret = fread(&(h->_yOrigin), 2, 1, fptr);
-  ret = fread(&(h->_width), 2, 1, fptr);
-  ret = fread(&(h->_height), 2, 1, fptr);
-  h->_bitsPerPixel = fgetc(fptr);
-  h->_imageDescriptor = fgetc(fptr);
-  // Create the set of layers
-  (*tga)->_layers = GSetCreate();
-  if ((*tga)->_layers == NULL) {
-    // Free the memory for the TGA
-    free((*tga)->_header);
-    free((*tga));
-    return 2;
-  }
-  // Create one layer
-  VecSet(dim, 0, h->_width);
-  VecSet(dim, 1, h->_height);
-  (*tga)->_curLayer = TGALayerCreate(dim, NULL);
+  // Skip the unused information
+  unsigned int skipover = 0;
+  skipover += (unsigned char)(h->_idLength);
+  skipover += h->_colorMapType * h->_colorMapLength;
+  fseek(fptr, skipover, SEEK_CUR);
+  // Allocate memory for the block buffer
+  unsigned char *block = (unsigned char*)malloc(TGA_IOBUFSIZE);
   // If we couldn't allocate memory
-  if ((*tga)->_curLayer == NULL) {
-    // Free the memory for the TGA
-    free((*tga)->_layers);
-    free((*tga)->_header);
-    free((*tga));
-    return 2;
-  }
-  // Add the layer to the set
-  GSetPush((*tga)->_layers, (*tga)->_curLayer);
-  // Set a pointer to the pixel
-  TGAPixel *pix = (*tga)->_curLayer->_pixels;
-  // For each pixel
-  for (i = 0; i < h->_width * h->_height; ++i) {
-    // For each value RGBA
-    for (int irgb = 0; irgb < 4; ++irgb)
-      // Initialize the value to 0
-      pix[i]._rgba[irgb] = 0;
-    pix[i]._readOnly = false;
-  }
-  // If the data type is not supported
-  if (h->_dataTypeCode != 2 && h->_dataTypeCode != 10) {
-    // Stop here
-    TGAFree(tga);
-    fclose(fptr);
-    return 3;
-  }
-  // If the number of byte per pixel is not supported
-  if (h->_bitsPerPixel != 16 && 
-    h->_bitsPerPixel != 24 && 
-    h->_bitsPerPixel != 32) {
-    // Stop here
-    TGAFree(tga);
-    fclose(fptr);
-    return 4;
-  }
-  // If the color map type is not supported
-  if (h->_colorMapType != 0 && 
-    h->_colorMapType != 1) {
+  if (block == NULL) {
     // Stop here
     TGAFree(tga);
     fclose(fptr);
-    return 5;
+    return 2;
   }
-  // Skip the unused information
-  skipover += h->_idLength;
-  skipover += h->_colorMapType * h->_colorMapLength;
-  fseek(fptr,skipover,SEEK_CUR);
-  // Calculate the number of byte per pixel
-  bytes2read = h->_bitsPerPixel / 8;
-  // For each pixel
-  while (n < h->_width * h->_height) {
-    // Read the pixel according to the data type, merge and 
-    // move to the next pixel
-    if (h->_dataTypeCode == 2) {
-      if (fread(p, 1, bytes2read, fptr) != bytes2read) {
-        TGAFree(tga);
-        fclose(fptr);
-        return 6;
-      }
-      MergeBytes(&(pix[n]), p, bytes2read);
-      ++n;
-    } else if (h->_dataTypeCode == 10) {
-      if (fread(p, 1, bytes2read + 1, fptr) != bytes2read + 1) {
-        TGAFree(tga);
-        fclose(fptr);
-        return 6;
-      }
-      j = p[0] & 0x7f;
-      MergeBytes(&(pix[n]), &(p[1]), bytes2read);
-      ++n;
-      if (p[0] & 0x80) {
-        for (i = 0; i < j; ++i) {
-           MergeBytes(&(pix[n]), &(p[1]), bytes2read);
-           ++n;
-        }
-      } else {
-        for (i = 0; i < j; ++i) {
-          if (fread(p, 1, bytes2read, fptr) != bytes2read) {
-            TGAFree(tga);
-            fclose(fptr);
-            return 6;
-          }
-          MergeBytes(&(pix[n]), p, bytes2read);
-          ++n;
-        }
-      }
+  // Initialise the decoder
+  TGADecoder decoder;
+  TGADecoderInit(&decoder, h);
+  // Declare variables used during decoding
+  TGAPixel *pix = (*tga)->_curLayer->_pixels;
+  long nbPix = (long)(h->_width) * (long)(h->_height);
+  long n = 0;
+  long size = 0;
+  // While there are pixels to decode
+  while (n < nbPix) {
+    // Fill the block buffer
+    size_t nbRead = fread(block + size, 1, TGA_IOBUFSIZE - size, fptr);
+    size += nbRead;
+    // Decode as many pixels as possible from the block
+    long nbDecoded = 0;
+    long used = 
+      TGADecoderDecode(&decoder, block, size, pix + n, nbPix - n, 
+      &nbDecoded);
+    // If we couldn't decode anything and there is no more data
+    if (used == 0 && nbDecoded == 0 && nbRead == 0) {
+      // Stop here
+      free(block);
+      TGAFree(tga);
+      fclose(fptr);
+      return 6;
     }
+    // Move the unused bytes at the beginning of the block
+    memmove(block, block + used, size - used);
+    size -= used;
+    n += nbDecoded;
   }
   // Close the file
   fclose(fptr);
-  // To avoid warning
-  ret = ret;
   // Free memory
-  VecFree(&dim);
+  free(block);
   // Return success code
   return 0;
 }
 
-// Save the TGA 'tga' to the file pointed to by 'fileName'
+// Read the header of the TGA file pointed to by 'fileName' into 
+// 'header' and, if 'footer' is not NULL, its TGA 2.0 footer into 
+// 'footer'
+// Only the header and the footer are read, no memory is allocated
+// and the header is not checked
 // return 0 upon success, else
 // 1 : couldn't open the file
-// 2 : invalid arguments
-int TGASave(TGA *tga, char *fileName) {
+// 6 : unexpected end of file
+// 7 : invalid arguments
+int TGAProbe(char *fileName, TGAHeader *header, TGAFooter *footer) {
   // Check arguments
-  if (tga == NULL || fileName == NULL || 
-    tga->_header == NULL || tga->_layers == NULL)
-    return 2;
+  if (fileName == NULL || header == NULL) return 7;
   // Open the file
-  FILE *fptr = fopen(fileName,"w");
-  // If we couln't open the file
-  if (fptr == NULL)
+  int fd = open(fileName, O_RDONLY);
+  // If we couldn't open the file
+  if (fd < 0)
     // Stop here
     return 1;
-  // Write the header
-  // Set a pointer to the header
-  TGAHeader *h = tga->_header;
-  putc(h->_idLength, fptr);
-  putc(h->_colorMapType, fptr);
-  putc(2, fptr); // _dataTypeCode
-  fwrite(&(h->_colorMapOrigin), 2, 1, fptr);
-  fwrite(&(h->_colorMapLength), 2, 1, fptr);
-  putc(h->_colorMapDepth, fptr);
-  fwrite(&(h->_xOrigin), 2, 1, fptr);
-  fwrite(&(h->_yOrigin), 2, 1, fptr);
-  fwrite(&(h->_width), 2, 1, fptr);
-  fwrite(&(h->_height), 2, 1, fptr);
-  putc(32, fptr); // _bitsPerPixel
-  putc(h->_imageDescriptor, fptr);
-  // For each pixel
-  for (int i = 0; 
-    i < tga->_header->_height * tga->_header->_width; ++i) {
-    // Write the pixel values
-    putc(tga->_curLayer->_pixels[i]._rgba[2], fptr);
-    putc(tga->_curLayer->_pixels[i]._rgba[1], fptr);
-    putc(tga->_curLayer->_pixels[i]._rgba[0], fptr);
-    putc(tga->_curLayer->_pixels[i]._rgba[3], fptr);
+  // Read the header
+  unsigned char buffer[TGA_FOOTERSIZE];
+  // If we couldn't read the whole header
+  if (pread(fd, buffer, TGA_HEADERSIZE, 0) != TGA_HEADERSIZE) {
+    // Stop here
+    close(fd);
+    return 6;
+  }
+  // Decode the header
+  TGAHeaderDecode(header, buffer);
+  // If the footer is requested
+  if (footer != NULL) {
+    // Initialise the footer as absent
+    footer->_isNewTGA = false;
+    footer->_extensionOffset = 0;
+    footer->_developerOffset = 0;
+    // Get the size of the file
+    struct stat st;
+    // If the file is large enough to contain a footer after the 
+    // header, and we could read it
+    if (fstat(fd, &st) == 0 && 
+      st.st_size >= TGA_HEADERSIZE + TGA_FOOTERSIZE &&
+      pread(fd, buffer, TGA_FOOTERSIZE, st.st_size - TGA_FOOTERSIZE) ==
+      TGA_FOOTERSIZE) {
+      // If the footer has the signature, including its final '\0'
+      if (memcmp(buffer + 8, TGA_FOOTERSIGNATURE, 
+        sizeof(TGA_FOOTERSIGNATURE)) == 0) {
+        // Decode the footer, stored in little endian in the file
+        footer->_isNewTGA = true;
+        for (int i = 3; i >= 0; --i) {
+          footer->_extensionOffset = 
+            (footer->_extensionOffset << 8) | buffer[i];
+          footer->_developerOffset = 
+            (footer->_developerOffset << 8) | buffer[4 + i];
+        }
+      }
+    }
   }
   // Close the file
-  fclose(fptr);
-  // Return the success code
+  close(fd);
+  // Return success code
   return 0;
 }
 
-// Print the header of 'tga' on 'stream'
-// If arguments are invalid, do nothing
-void TGAPrintHeader(TGA *tga, FILE *stream) {
+// Load a TGA from the file pointed to by 'fileName' by mapping the 
+// file in memory and decoding the pixels directly from the mapping
+// If the file can't be mapped, it is loaded with TGALoad
+// If 'tga' already contains a TGA, it is overwritten
+// return the same codes as TGALoad
+int TGALoadMapped(TGA **tga, char *fileName) {
   // Check arguments
-  if (tga == NULL || stream == NULL) return;
-  // Set a pointer to the header
-  TGAHeader *h = tga->_header;
-  // If the header is not defined
-  if (h == NULL) 
+  if (tga == NULL || fileName == NULL) return 7;
+  // If the TGA in argument is already used
+  if (*tga != NULL)
+    // Free memory
+    TGAFree(tga);
+  // Map the file
+  TGAMap map;
+  unsigned char head[TGA_HEADERSIZE];
+  int err = TGAMapFile(&map, fileName, head);
+  // If the file couldn't be mapped
+  if (err == 8)
+    // Load it through the buffered reader
+    return TGALoad(tga, fileName);
+  // If we couldn't open the file
+  if (err != 0)
     // Stop here
-    return;
-  // Print the header info
-  fprintf(stream, "ID length:         %d\n", h->_idLength);
-  fprintf(stream, "Colourmap type:    %d\n", h->_colorMapType);
-  fprintf(stream, "Image type:        %d\n", h->_dataTypeCode);
-  fprintf(stream, "Colour map offset: %d\n", h->_colorMapOrigin);
-  fprintf(stream, "Colour map length: %d\n", h->_colorMapLength); 
-  fprintf(stream, "Colour map depth:  %d\n", h->_colorMapDepth);
-  fprintf(stream, "X origin:          %d\n", h->_xOrigin);
-  fprintf(stream, "Y origin:          %d\n", h->_yOrigin);
-  fprintf(stream, "Width:             %d\n", h->_width);
-  fprintf(stream, "Height:            %d\n", h->_height);
-  fprintf(stream, "Bits per pixel:    %d\n", h->_bitsPerPixel);
-  fprintf(stream, "Descriptor:        %d\n", h->_imageDescriptor);
+    return err;
+  // Tell the system the mapping will be read sequentially
+  madvise(map._map, map._size, MADV_SEQUENTIAL);
+  // Decode the TGA from the mapping
+  err = TGADecodeBuffer(tga, map._map, (long)(map._size));
+  // Unmap the file
+  munmap(map._map, map._size);
+  // Return the error code
+  return err;
 }
 
-// Return true if 'pos' is inside 'tga'
-// Return false else, or if arguments are invalid
-bool TGAIsPosInside(TGA *tga, VecShort *pos) {
+// Decode a TGA from the 'size' bytes of 'data', which contain a whole
+// TGA file
+// If 'tga' already contains a TGA, it is overwritten
+// return the same codes as TGALoad
+int TGADecodeBuffer(TGA **tga, unsigned char *data, long size) {
   // Check arguments
-  if (tga == NULL || pos == NULL || VecDim(pos) < 2)
-    return false;
-  // If the position is in the tga
-  if (VecGet(pos, 0) >= 0 && VecGet(pos, 0) < tga->_header->_width && 
-    VecGet(pos, 1) >= 0 && VecGet(pos, 1) < tga->_header->_height)
-    return true;
-  // Else, the position is not in the tga
-  else
-    return false;
+  if (tga == NULL || data == NULL || size < 0) return 7;
+  // If the TGA in argument is already used
+  if (*tga != NULL)
+    // Free memory
+    TGAFree(tga);
+  // Copy the header, missing bytes are set to EOF as TGALoad does
+  unsigned char head[TGA_HEADERSIZE];
+  memset(head, 0xFF, TGA_HEADERSIZE);
+  memcpy(head, data, (size < TGA_HEADERSIZE ? size : TGA_HEADERSIZE));
+  // Create the TGA from the header
+  int err = TGACreateFromHeader(tga, head);
+  // If we couldn't create the TGA
+  if (err != 0)
+    // Stop here
+    return err;
+  // Set a pointer to the header
+  TGAHeader *h = (*tga)->_header;
+  // Get the position of the first pixel, skipping the unused 
+  // information
+  long skipover = TGA_HEADERSIZE;
+  skipover += (unsigned char)(h->_idLength);
+  skipover += h->_colorMapType * h->_colorMapLength;
+  // Declare variables used during decoding
+  long nbPix = (long)(h->_width) * (long)(h->_height);
+  long nbDecoded = 0;
+  // If there is data after the header
+  if (skipover < size) {
+    // Decode the pixels from the data
+    TGADecoder decoder;
+    TGADecoderInit(&decoder, h);
+    TGADecoderDecode(&decoder, data + skipover, size - skipover, 
+      (*tga)->_curLayer->_pixels, nbPix, &nbDecoded);
+  }
+  // If we couldn't decode all the pixels
+  if (nbDecoded < nbPix) {
+    // Free memory
+    TGAFree(tga);
+    // Stop here
+    return 6;
+  }
+  // Return success code
+  return 0;
 }
 
-// Get a pointer to the pixel at coord (x,y) = (pos[0],pos[1])
-// in the current layer
+// Map in memory the file pointed to by 'fileName' into 'map' and
+// copy its header in 'head', missing bytes are set to EOF
+// The header is decoded but not checked
+// return 0 upon success, else
+// 1 : couldn't open the file
+// 8 : couldn't map the file in memory
+int TGAMapFile(TGAMap *map, char *fileName, unsigned char *head) {
+  // Open the file
+  int fd = open(fileName, O_RDONLY);
+  // If we couldn't open the file
+  if (fd < 0)
+    // Stop here
+    return 1;
+  // Get the size of the file
+  struct stat st;
+  // If we couldn't get the size of the file or it's empty
+  if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+    // Stop here
+    close(fd);
+    return 8;
+  }
+  // Map the file, privately to allow copy on write
+  map->_size = (size_t)(st.st_size);
+  void *ptr = mmap(NULL, map->_size, PROT_READ | PROT_WRITE, 
+    MAP_PRIVATE, fd, 0);
+  // The mapping stays valid after closing the file
+  close(fd);
+  // If we couldn't map the file
+  if (ptr == MAP_FAILED)
+    // Stop here
+    return 8;
+  map->_map = (unsigned char*)ptr;
+  // Copy the header
+  memset(head, 0xFF, TGA_HEADERSIZE);
+  memcpy(head, map->_map, 
+    (map->_size < TGA_HEADERSIZE ? map->_size : TGA_HEADERSIZE));
+  // Decode the header
+  TGAHeaderDecode(&(map->_header), head);
+  map->_bytes = map->_header._bitsPerPixel / 8;
+  map->_pixels = NULL;
+  // Return success code
+  return 0;
+}
+
+// Open a view on the uncompressed TGA file pointed to by 'fileName'
+// The file is mapped privately in memory: the pixels are read directly
+// from the file and memory pages are copied only when written to
+// If 'map' already contains a view, it is closed
+// return 0 upon success, else
+// 1 : couldn't open the file
+// 2 : malloc failed
+// 3 : can only handle image type 2
+// 4 : can only handle pixel depths of 16, 24, and 32
+// 5 : can only handle colour map types of 0 and 1
+// 6 : unexpected end of file
+// 7 : invalid arguments
+// 8 : couldn't map the file in memory
+int TGAMapOpen(TGAMap **map, char *fileName) {
+  // Check arguments
+  if (map == NULL || fileName == NULL) return 7;
+  // If the view in argument is already used
+  if (*map != NULL)
+    // Close it
+    TGAMapClose(map);
+  // Allocate memory for the view
+  *map = (TGAMap*)malloc(sizeof(TGAMap));
+  // If we couldn't allocate memory
+  if (*map == NULL)
+    // Stop here
+    return 2;
+  // Map the file
+  unsigned char head[TGA_HEADERSIZE];
+  int err = TGAMapFile(*map, fileName, head);
+  // If we couldn't map the file
+  if (err != 0) {
+    // Stop here
+    free(*map);
+    *map = NULL;
+    return err;
+  }
+  // Set a pointer to the header
+  TGAHeader *h = &((*map)->_header);
+  // Check the header
+  if (h->_dataTypeCode != 2)
+    err = 3;
+  else if (h->_bitsPerPixel != 16 && 
+    h->_bitsPerPixel != 24 && 
+    h->_bitsPerPixel != 32)
+    err = 4;
+  else if (h->_colorMapType != 0 && 
+    h->_colorMapType != 1)
+    err = 5;
+  // If the header is valid
+  if (err == 0) {
+    // Get the position of the first pixel, skipping the unused 
+    // information
+    size_t skipover = TGA_HEADERSIZE;
+    skipover += (unsigned char)(h->_idLength);
+    skipover += h->_colorMapType * h->_colorMapLength;
+    // If the file doesn't contain all the pixels
+    if (skipover + (size_t)(h->_width) * (size_t)(h->_height) * 
+      (size_t)((*map)->_bytes) > (*map)->_size)
+      err = 6;
+    else
+      (*map)->_pixels = (*map)->_map + skipover;
+  }
+  // If the file is invalid
+  if (err != 0)
+    // Free memory
+    TGAMapClose(map);
+  // Return the error code
+  return err;
+}
+
+// Close the view 'map' and free the memory it uses
+void TGAMapClose(TGAMap **map) {
+  // Check arguments
+  if (map == NULL || *map == NULL)
+    return;
+  // Unmap the file
+  munmap((*map)->_map, (*map)->_size);
+  // Free memory
+  free(*map);
+  *map = NULL;
+}
+
+// Get a pointer to the row 'y' (in the same order as TGALoad) of 
+// the mapped file 'map', pixels are in the file format (BGRA, BGR 
+// or 1-5-5-5)
 // Return NULL in case of invalid arguments
-TGAPixel* TGAGetPix(TGA *tga, VecShort *pos) {
+unsigned char* TGAMapGetRow(TGAMap *map, short y) {
+  // Check arguments
+  if (map == NULL || y < 0 || y >= map->_header._height)
+    return NULL;
+  // Return the pointer to the row
+  return map->_pixels + 
+    (size_t)y * (size_t)(map->_header._width) * (size_t)(map->_bytes);
+}
+
+// Decode the pixel at coord (x,y) = (pos[0],pos[1]) of the mapped file
+// 'map' into 'pix'
+// Do nothing in case of invalid arguments
+void TGAMapGetPix(TGAMap *map, VecShort *pos, TGAPixel *pix) {
+  // Check arguments
+  if (map == NULL || pos == NULL || pix == NULL ||
+    VecGet(pos, 0) < 0 || VecGet(pos, 0) >= map->_header._width)
+    return;
+  // Get the row of the pixel
+  unsigned char *row = TGAMapGetRow(map, VecGet(pos, 1));
+  // If the row exists
+  if (row != NULL) {
+    // Decode the pixel
+    MergeBytes(pix, row + VecGet(pos, 0) * map->_bytes, map->_bytes);
+  }
+}
+
+// Open a reader on the TGA file pointed to by 'fileName'
+// Only the header is read, the rows are decoded by TGAReaderRead
+// If 'reader' already contains a reader, it is closed
+// return 0 upon success, else
+// 1 : couldn't open the file
+// 2 : malloc failed
+// 3 : can only handle image type 2 and 10
+// 4 : can only handle pixel depths of 16, 24, and 32
+// 5 : can only handle colour map types of 0 and 1
+// 7 : invalid arguments
+int TGAReaderOpen(TGAReader **reader, char *fileName) {
+  // Check arguments
+  if (reader == NULL || fileName == NULL) return 7;
+  // If the reader in argument is already used
+  if (*reader != NULL)
+    // Close it
+    TGAReaderClose(reader);
+  // Allocate memory for the reader and its buffer
+  *reader = (TGAReader*)malloc(sizeof(TGAReader));
+  // If we couldn't allocate memory
+  if (*reader == NULL)
+    // Stop here
+    return 2;
+  (*reader)->_stream = NULL;
+  (*reader)->_block = (unsigned char*)malloc(TGA_IOBUFSIZE);
+  // If we couldn't allocate memory
+  if ((*reader)->_block == NULL) {
+    // Stop here
+    TGAReaderClose(reader);
+    return 2;
+  }
+  // Open the file
+  (*reader)->_stream = fopen(fileName,"r");
+  // If we couldn't open the file
+  if ((*reader)->_stream == NULL) {
+    // Stop here
+    TGAReaderClose(reader);
+    return 1;
+  }
+  // Read the header in one block, missing bytes are set to EOF
+  // as TGALoad does
+  unsigned char head[TGA_HEADERSIZE];
+  memset(head, 0xFF, TGA_HEADERSIZE);
+  size_t ret = fread(head, 1, TGA_HEADERSIZE, (*reader)->_stream);
+  // To avoid warning
+  ret = ret;
+  // Set a pointer to the header
+  TGAHeader *h = &((*reader)->_header);
+  // Decode and check the header
+  TGAHeaderDecode(h, head);
+  int err = 0;
+  if (h->_dataTypeCode != 2 && h->_dataTypeCode != 10)
+    err = 3;
+  else if (h->_bitsPerPixel != 16 && 
+    h->_bitsPerPixel != 24 && 
+    h->_bitsPerPixel != 32)
+    err = 4;
+  else if (h->_colorMapType != 0 && 
+    h->_colorMapType != 1)
+    err = 5;
+  // If the header is invalid
+  if (err != 0) {
+    // Stop here
+    TGAReaderClose(reader);
+    return err;
+  }
+  // Skip the unused information
+  unsigned int skipover = 0;
+  skipover += (unsigned char)(h->_idLength);
+  skipover += h->_colorMapType * h->_colorMapLength;
+  fseek((*reader)->_stream, skipover, SEEK_CUR);
+  // Initialise the decoder and the reading position
+  TGADecoderInit(&((*reader)->_decoder), h);
+  (*reader)->_pos = 0;
+  (*reader)->_size = 0;
+  (*reader)->_nbRowRead = 0;
+  // Return success code
+  return 0;
+}
+
+// Close the reader 'reader' and free the memory it uses
+void TGAReaderClose(TGAReader **reader) {
+  // Check arguments
+  if (reader == NULL || *reader == NULL) return;
+  // Close the file
+  if ((*reader)->_stream != NULL)
+    fclose((*reader)->_stream);
+  // Free memory
+  free((*reader)->_block);
+  free(*reader);
+  *reader = NULL;
+}
+
+// Decode the next band of at most 'nbRow' rows of the reader 'reader'
+// into 'pix', which must be able to contain nbRow * width pixels
+// Bands are read in the order of the file, as given by the origin 
+// bits of the image descriptor, but inside a band rows are stored 
+// from bottom to top and pixels from left to right as in a TGALayer
+// 'y' is set to the coordinate of the bottom row of the band and 
+// 'nbRead' to the number of rows read, 0 once all rows have been read
+// return 0 upon success, else
+// 6 : unexpected end of file
+// 7 : invalid arguments
+int TGAReaderRead(TGAReader *reader, TGAPixel *pix, short nbRow,
+  short *y, short *nbRead) {
+  // Check arguments
+  if (reader == NULL || pix == NULL || nbRow <= 0 || y == NULL ||
+    nbRead == NULL)
+    return 7;
+  // Set a pointer to the header
+  TGAHeader *h = &(reader->_header);
+  // Get the number of rows in the band
+  short nb = h->_height - reader->_nbRowRead;
+  if (nb > nbRow)
+    nb = nbRow;
+  // Get the order of rows and pixels in the file from the image 
+  // descriptor
+  bool topToBottom = ((h->_imageDescriptor & 0x20) != 0);
+  bool rightToLeft = ((h->_imageDescriptor & 0x10) != 0);
+  // For each row of the band
+  for (short iRow = 0; iRow < nb; ++iRow) {
+    // Get the row in the band where to decode, rows from the top
+    // are stored from the end of the band
+    TGAPixel *row = pix + (long)(topToBottom ? nb - 1 - iRow : iRow) *
+      (long)(h->_width);
+    // Decode the row
+    if (TGAReaderDecode(reader, row, h->_width) == false) {
+      // Stop here
+      *nbRead = 0;
+      return 6;
+    }
+    // If the pixels are from right to left in the file
+    if (rightToLeft == true) {
+      // Reverse the row
+      for (short i = 0, j = h->_width - 1; i < j; ++i, --j) {
+        TGAPixel p = row[i];
+        row[i] = row[j];
+        row[j] = p;
+      }
+    }
+  }
+  // Set the coordinate of the bottom row of the band
+  if (topToBottom == true)
+    *y = h->_height - reader->_nbRowRead - nb;
+  else
+    *y = reader->_nbRowRead;
+  // Update the number of rows read
+  reader->_nbRowRead += nb;
+  *nbRead = nb;
+  // Return success code
+  return 0;
+}
+
+// Decode 'nb' pixels of the reader 'reader' into 'pix', reading the
+// file as needed
+// Return false if the end of file is reached before
+bool TGAReaderDecode(TGAReader *reader, TGAPixel *pix, long nb) {
+  // Declare a variable to memorize the number of decoded pixels
+  long n = 0;
+  // While there are pixels to decode
+  while (n < nb) {
+    // Decode as many pixels as possible from the buffer
+    long nbDecoded = 0;
+    reader->_pos += TGADecoderDecode(&(reader->_decoder), 
+      reader->_block + reader->_pos, reader->_size - reader->_pos, 
+      pix + n, nb - n, &nbDecoded);
+    n += nbDecoded;
+    // If more pixels are needed
+    if (n < nb) {
+      // Move the unused bytes at the beginning of the buffer
+      reader->_size -= reader->_pos;
+      memmove(reader->_block, reader->_block + reader->_pos, 
+        reader->_size);
+      reader->_pos = 0;
+      // Fill the buffer
+      size_t nbRead = fread(reader->_block + reader->_size, 1, 
+        TGA_IOBUFSIZE - reader->_size, reader->_stream);
+      // If there is no more data
+      if (nbRead == 0 && nbDecoded == 0)
+        // Stop here
+        return false;
+      reader->_size += nbRead;
+    }
+  }
+  // Return success
+  return true;
+}
+
+// Decode the TGA_HEADERSIZE bytes of a TGA file's header in 'buffer'
+// into 'h'
+// Do nothing if arguments are invalid
+void TGAHeaderDecode(TGAHeader *h, unsigned char *buffer) {
+  // Check arguments
+  if (h == NULL || buffer == NULL)
+    return;
+  // Decode the values, stored in little endian in the file
+  h->_idLength = buffer[0];
+  h->_colorMapType = buffer[1];
+  h->_dataTypeCode = buffer[2];
+  h->_colorMapOrigin = (short)(buffer[3] | (buffer[4] << 8));
+  h->_colorMapLength = (short)(buffer[5] | (buffer[6] << 8));
+  h->_colorMapDepth = buffer[7];
+  h->_xOrigin = (short)(buffer[8] | (buffer[9] << 8));
+  h->_yOrigin = (short)(buffer[10] | (buffer[11] << 8));
+  h->_width = (short)(buffer[12] | (buffer[13] << 8));
+  h->_height = (short)(buffer[14] | (buffer[15] << 8));
+  h->_bitsPerPixel = buffer[16];
+  h->_imageDescriptor = buffer[17];
+}
+
+// Create in 'tga' a TGA with one layer from the TGA_HEADERSIZE bytes 
+// of a TGA file's header in 'buffer'
+// The pixels of the layer are set to rgba(0,0,0,0)
+// Return 0 upon success, else
+// 2 : malloc failed
+// 3 : can only handle image type 2 and 10
+// 4 : can only handle pixel depths of 16, 24, and 32
+// 5 : can only handle colour map types of 0 and 1
+int TGACreateFromHeader(TGA **tga, unsigned char *buffer) {
+  // Allocate memory for the TGA
+  *tga = (TGA*)malloc(sizeof(TGA));
+  // If we couldn't allocate memory
+  if (*tga == NULL) {
+    // Stop here
+    return 2;
+  }
+  // Set pointers to NULL
+  (*tga)->_header = NULL;
+  (*tga)->_layers = NULL;
+  (*tga)->_curLayer = NULL;
+  (*tga)->_curLayerIndex = 0;
+  (*tga)->_tmpLayer = NULL;
+  // Allocate memory for the header
+  (*tga)->_header = (TGAHeader*)malloc(sizeof(TGAHeader));
+  // If we couldn't allocate memory
+  if ((*tga)->_header == NULL) {
+    // Stop here
+    TGAFree(tga);
+    return 2;
+  }
+  // Set a pointer to the header
+  TGAHeader *h = (*tga)->_header;
+  // Read the header's values
+  TGAHeaderDecode(h, buffer);
+  // If the data type is not supported
+  if (h->_dataTypeCode != 2 && h->_dataTypeCode != 10) {
+    // Stop here
+    TGAFree(tga);
+    return 3;
+  }
+  // If the number of byte per pixel is not supported
+  if (h->_bitsPerPixel != 16 && 
+    h->_bitsPerPixel != 24 && 
+    h->_bitsPerPixel != 32) {
+    // Stop here
+    TGAFree(tga);
+    return 4;
+  }
+  // If the color map type is not supported
+  if (h->_colorMapType != 0 && 
+    h->_colorMapType != 1) {
+    // Stop here
+    TGAFree(tga);
+    return 5;
+  }
+  // Create the set of layers
+  (*tga)->_layers = GSetCreate();
+  // Create a VecShort to memorize the dimensions
+  VecShort *dim = VecShortCreate(2);
+  // If we couldn't allocate memory
+  if ((*tga)->_layers == NULL || dim == NULL) {
+    // Stop here
+    VecFree(&dim);
+    TGAFree(tga);
+    return 2;
+  }
+  // Create one layer
+  VecSet(dim, 0, h->_width);
+  VecSet(dim, 1, h->_height);
+  (*tga)->_curLayer = TGALayerCreate(dim, NULL);
+  VecFree(&dim);
+  // If we couldn't allocate memory
+  if ((*tga)->_curLayer == NULL) {
+    // Stop here
+    TGAFree(tga);
+    return 2;
+  }
+  // Add the layer to the set
+  GSetPush((*tga)->_layers, (*tga)->_curLayer);
+  // Return success code
+  return 0;
+}
+
+// Initialise the decoder 'dec' for the pixels of a TGA file with 
+// header 'h'
+// Do nothing if arguments are invalid
+void TGADecoderInit(TGADecoder *dec, TGAHeader *h) {
+  // Check arguments
+  if (dec == NULL || h == NULL)
+    return;
+  // Set the decoder values
+  dec->_bytes = h->_bitsPerPixel / 8;
+  dec->_rle = (h->_dataTypeCode == 10);
+  dec->_nbRemain = 0;
+  dec->_runPacket = false;
+  memset(dec->_runValue, 0, 4);
+}
+
+// Decode at most 'nbPix' pixels from the 'size' bytes of 'data' into
+// 'pix' with the decoder 'dec'
+// Only complete pixels and packet headers are consumed, the current 
+// packet is memorized in 'dec' for the next call
+// Set 'nbDecoded' to the number of decoded pixels
+// Return the number of bytes consumed in 'data'
+long TGADecoderDecode(TGADecoder *dec, unsigned char *data, long size,
+  TGAPixel *pix, long nbPix, long *nbDecoded) {
+  // Declare variables to memorize the number of bytes consumed and 
+  // pixels decoded
+  long used = 0;
+  long n = 0;
+  // Set a variable to memorize the number of byte per pixel
+  int bytes = dec->_bytes;
+  // If the data is not compressed
+  if (dec->_rle == false) {
+    // Decode as many pixels as available
+    n = size / bytes;
+    if (n > nbPix)
+      n = nbPix;
+    TGADecodePixels(pix, data, n, bytes);
+    used = n * bytes;
+  // Else, the data is run-length encoded
+  } else {
+    // While there are pixels to decode
+    while (n < nbPix) {
+      // If we are at the beginning of a packet
+      if (dec->_nbRemain == 0) {
+        // If the packet header is not available
+        if (used >= size)
+          // Wait for more data
+          break;
+        // If it's a run-length packet
+        if (data[used] & 0x80) {
+          // If the repeated pixel is not available
+          if (used + 1 + bytes > size)
+            // Wait for more data
+            break;
+          // Memorize the repeated pixel
+          memcpy(dec->_runValue, data + used + 1, bytes);
+          dec->_runPacket = true;
+          dec->_nbRemain = (data[used] & 0x7f) + 1;
+          used += 1 + bytes;
+        // Else, it's a raw packet
+        } else {
+          dec->_runPacket = false;
+          dec->_nbRemain = (data[used] & 0x7f) + 1;
+          used += 1;
+        }
+      }
+      // Get the number of pixels to decode from the current packet
+      long nb = dec->_nbRemain;
+      if (nb > nbPix - n)
+        nb = nbPix - n;
+      // If it's a run-length packet
+      if (dec->_runPacket == true) {
+        // Decode the repeated pixel once and copy it
+        MergeBytes(pix + n, dec->_runValue, bytes);
+        for (long i = 1; i < nb; ++i)
+          pix[n + i] = pix[n];
+      // Else, it's a raw packet
+      } else {
+        // Decode as many pixels as available
+        if (nb > (size - used) / bytes)
+          nb = (size - used) / bytes;
+        // If there is no available pixel
+        if (nb == 0)
+          // Wait for more data
+          break;
+        TGADecodePixels(pix + n, data + used, nb, bytes);
+        used += nb * bytes;
+      }
+      // Update the number of decoded pixels and remaining pixels
+      // in the packet
+      n += nb;
+      dec->_nbRemain -= nb;
+    }
+  }
+  // Return the number of decoded pixels and consumed bytes
+  *nbDecoded = n;
+  return used;
+}
+
+// Decode 'nb' uncompressed pixels of 'bytes' bytes from 'data' 
+// into 'pix'
+void TGADecodePixels(TGAPixel *pix, unsigned char *data, long nb, 
+  int bytes) {
+  // Convert the pixels directly into the RGBA values of the pixels
+  unsigned char *rgba = (unsigned char*)pix;
+  if (bytes == 4)
+    TGARowBGRAToRGBA(rgba, data, nb);
+  else if (bytes == 3)
+    TGARowBGRToRGBA(rgba, data, nb);
+  else if (bytes == 2)
+    TGARow1555ToRGBA(rgba, data, nb);
+}
+
+// Save the TGA 'tga' to the file pointed to by 'fileName'
+// The image is saved uncompressed (type 2) with 32 bits per pixel
+// return 0 upon success, else
+// 1 : couldn't open the file
+// 2 : invalid arguments
+// 3 : couldn't write the file or allocate memory
+int TGASave(TGA *tga, char *fileName) {
+  // Save as uncompressed data
+  return TGAWrite(tga, fileName, 2, 32);
+}
+
+// Save the TGA 'tga' to the file pointed to by 'fileName'
+// The image is saved run-length encoded (type 10) with 32 bits 
+// per pixel
+// return 0 upon success, else
+// 1 : couldn't open the file
+// 2 : invalid arguments
+// 3 : couldn't write the file or allocate memory
+int TGASaveRLE(TGA *tga, char *fileName) {
+  // Save as run-length encoded data
+  return TGAWrite(tga, fileName, 10, 32);
+}
+
+// Save the TGA 'tga' to the file pointed to by 'fileName'
+// The image is saved uncompressed if 'dataTypeCode' is 2 or
+// run-length encoded if it is 10, with 'bitsPerPixel' bits per pixel
+// (16, 24 or 32)
+// If 'bitsPerPixel' is TGA_BPP_AUTO the image is saved with 24 bits
+// per pixel if all its pixels are opaque, else with 32 bits per pixel
+// With 16 bits per pixel colors are reduced to 5 bits per channel and
+// the pixels are transparent if their opacity is lower than 128
+// return 0 upon success, else
+// 1 : couldn't open the file
+// 2 : invalid arguments
+// 3 : couldn't write the file or allocate memory
+int TGASaveFormat(TGA *tga, char *fileName, char dataTypeCode,
+  char bitsPerPixel) {
+  // Check arguments
+  if (tga == NULL || tga->_curLayer == NULL ||
+    (dataTypeCode != 2 && dataTypeCode != 10) ||
+    (bitsPerPixel != TGA_BPP_AUTO && bitsPerPixel != 16 &&
+    bitsPerPixel != 24 && bitsPerPixel != 32))
+    return 2;
+  // If the depth must be selected automatically
+  if (bitsPerPixel == TGA_BPP_AUTO)
+    bitsPerPixel = TGAGetAutoBitsPerPixel(tga);
+  // Save the TGA
+  return TGAWrite(tga, fileName, dataTypeCode, bitsPerPixel);
+}
+
+// Encode the TGA 'tga' in memory as a TGA file with 'dataTypeCode' 
+// and 'bitsPerPixel' as in TGASaveFormat
+// The encoded file is written in '*data' which can contain 
+// '*capacity' bytes, and 'size' is set to its number of bytes
+// If 'growable' is true, '*data' must be NULL or allocated with 
+// malloc, it is reallocated as needed and '*capacity' is updated
+// The caller is in charge of freeing '*data'
+// return 0 upon success, else
+// 2 : invalid arguments
+// 3 : malloc failed
+// 4 : the buffer is too small, 'size' is set to the needed size
+int TGAEncodeBuffer(TGA *tga, char dataTypeCode, char bitsPerPixel,
+  unsigned char **data, long *capacity, bool growable, long *size) {
+  // Check arguments
+  if (tga == NULL || tga->_header == NULL || tga->_curLayer == NULL ||
+    data == NULL || capacity == NULL || size == NULL ||
+    (*data == NULL && growable == false) || *capacity < 0 ||
+    (dataTypeCode != 2 && dataTypeCode != 10) ||
+    (bitsPerPixel != TGA_BPP_AUTO && bitsPerPixel != 16 &&
+    bitsPerPixel != 24 && bitsPerPixel != 32))
+    return 2;
+  // If the depth must be selected automatically
+  if (bitsPerPixel == TGA_BPP_AUTO)
+    bitsPerPixel = TGAGetAutoBitsPerPixel(tga);
+  // Declare the write buffer on the caller's memory
+  TGAWriteBuffer buffer;
+  buffer._stream = NULL;
+  buffer._data = (*data == NULL ? NULL : *data);
+  buffer._capacity = (*data == NULL ? 0 : *capacity);
+  buffer._size = 0;
+  buffer._growable = growable;
+  buffer._total = 0;
+  buffer._error = false;
+  // Get the size of the uncompressed file, which is the exact size
+  // for type 2 and usually an upper bound for type 10
+  long sizeRaw = TGA_HEADERSIZE + (long)(tga->_header->_width) * 
+    (long)(tga->_header->_height) * (bitsPerPixel / 8);
+  // If the buffer is growable and smaller than this size, grow it 
+  // now to avoid successive reallocations
+  if (growable == true && buffer._capacity < sizeRaw)
+    TGAWriteBufferGrow(&buffer, sizeRaw - buffer._capacity);
+  // Encode the TGA
+  int err = TGAWriteLayer(tga, &buffer, dataTypeCode, bitsPerPixel);
+  // Give back the buffer to the caller, it may have been reallocated
+  *data = buffer._data;
+  *capacity = buffer._capacity;
+  *size = buffer._total;
+  // Return the error code
+  if (err != 0 || (buffer._error == true && growable == true))
+    return 3;
+  else if (buffer._error == true)
+    return 4;
+  else
+    return 0;
+}
+
+// Get the number of bits per pixel used to save the TGA 'tga' with
+// TGA_BPP_AUTO: 24 if all the pixels of the current layer are opaque,
+// else 32
+char TGAGetAutoBitsPerPixel(TGA *tga) {
+  // Use 24 bits per pixel unless a pixel is not opaque
+  char bitsPerPixel = 24;
+  TGAPixel *pix = tga->_curLayer->_pixels;
+  long nbPix = (long)(VecGet(tga->_curLayer->_dim, 0)) *
+    (long)(VecGet(tga->_curLayer->_dim, 1));
+  for (long i = 0; i < nbPix && bitsPerPixel == 24; ++i)
+    if (pix[i]._rgba[3] != 255)
+      bitsPerPixel = 32;
+  // Return the number of bits per pixel
+  return bitsPerPixel;
+}
+
+// Save the current layer of the TGA 'tga' to the file pointed to by
+// 'fileName' with data type 'dataTypeCode' (2 or 10) and
+// 'bitsPerPixel' bits per pixel (16, 24 or 32)
+// return 0 upon success, else
+// 1 : couldn't open the file
+// 2 : invalid arguments
+// 3 : couldn't write the file or allocate memory
+int TGAWrite(TGA *tga, char *fileName, char dataTypeCode, 
+  char bitsPerPixel) {
+  // Check arguments
+  if (tga == NULL || fileName == NULL || 
+    tga->_header == NULL || tga->_layers == NULL)
+    return 2;
+  // Declare the write buffer
+  TGAWriteBuffer buffer;
+  buffer._capacity = TGA_IOBUFSIZE;
+  buffer._size = 0;
+  buffer._growable = false;
+  buffer._total = 0;
+  buffer._error = false;
+  buffer._data = (unsigned char*)malloc(TGA_IOBUFSIZE);
+  // If we couldn't allocate memory
+  if (buffer._data == NULL)
+    // Stop here
+    return 3;
+  // Open the file
+  buffer._stream = fopen(fileName,"w");
+  // If we couln't open the file
+  if (buffer._stream == NULL) {
+    // Stop here
+    free(buffer._data);
+    return 1;
+  }
+  // Write the TGA
+  int err = TGAWriteLayer(tga, &buffer, dataTypeCode, bitsPerPixel);
+  // Write the remaining data
+  TGAWriteBufferFlush(&buffer);
+  // Close the file
+  if (fclose(buffer._stream) != 0)
+    buffer._error = true;
+  // Free memory
+  free(buffer._data);
+  // Return the error code
+  return (err != 0 || buffer._error ? 3 : 0);
+}
+
+// Write the header and the pixels of the current layer of the TGA 
+// 'tga' into the write buffer 'buffer' with data type 'dataTypeCode' 
+// (2 or 10) and 'bitsPerPixel' bits per pixel (16, 24 or 32)
+// return 0 upon success, else
+// 3 : malloc failed
+int TGAWriteLayer(TGA *tga, TGAWriteBuffer *buffer, char dataTypeCode,
+  char bitsPerPixel) {
+  // Declare a buffer for the encoded pixels of one row, big enough
+  // for the worst case of run-length encoding
+  int bytes = bitsPerPixel / 8;
+  unsigned char *row = (unsigned char*)malloc(
+    (size_t)(tga->_header->_width) * (bytes + 1));
+  // If we couldn't allocate memory
+  if (row == NULL)
+    // Stop here
+    return 3;
+  // Write the header
+  TGAWriteHeader(buffer, tga->_header, dataTypeCode, bitsPerPixel);
+  // Write the rows
+  TGAWriteRows(buffer, tga->_curLayer->_pixels, tga->_header->_width,
+    tga->_header->_height, dataTypeCode, bytes, row);
+  // Free memory
+  free(row);
+  // Return success code
+  return 0;
+}
+
+// Write into the write buffer 'buffer' the header 'h' modified for
+// data type 'dataTypeCode' and 'bitsPerPixel' bits per pixel
+// The identification field and color map are not saved
+void TGAWriteHeader(TGAWriteBuffer *buffer, TGAHeader *h, 
+  char dataTypeCode, char bitsPerPixel) {
+  // Copy the header and remove the identification field and color map
+  TGAHeader head;
+  memcpy(&head, h, sizeof(TGAHeader));
+  head._idLength = 0;
+  head._colorMapType = 0;
+  head._colorMapOrigin = 0;
+  head._colorMapLength = 0;
+  head._colorMapDepth = 0;
+  head._dataTypeCode = dataTypeCode;
+  head._bitsPerPixel = bitsPerPixel;
+  // Set the number of attribute bits per pixel in the image 
+  // descriptor if there is no 8 bits alpha channel
+  if (bitsPerPixel == 24)
+    head._imageDescriptor &= 0xF0;
+  else if (bitsPerPixel == 16)
+    head._imageDescriptor = (head._imageDescriptor & 0xF0) | 1;
+  // Encode and write the header
+  unsigned char data[TGA_HEADERSIZE];
+  TGAHeaderEncode(&head, data);
+  TGAWriteBufferPut(buffer, data, TGA_HEADERSIZE);
+}
+
+// Encode and write into the write buffer 'buffer' the 'nbRow' rows of 
+// 'width' pixels in 'pix' with data type 'dataTypeCode' and 'bytes'
+// bytes per pixel, using 'row' as the buffer for one encoded row
+void TGAWriteRows(TGAWriteBuffer *buffer, TGAPixel *pix, short width, 
+  short nbRow, char dataTypeCode, int bytes, unsigned char *row) {
+  // For each row
+  for (short y = 0; y < nbRow; ++y, pix += width) {
+    // Encode the row
+    long size = 0;
+    if (dataTypeCode == 10)
+      size = TGAEncodeRLE(pix, width, bytes, row);
+    else {
+      TGAEncodePixels(pix, width, bytes, row);
+      size = (long)width * bytes;
+    }
+    // Write the encoded row
+    TGAWriteBufferPut(buffer, row, size);
+  }
+}
+
+// Open a writer on the file pointed to by 'fileName' for an image of
+// width dim[0] and height dim[1], saved uncompressed if 'dataTypeCode'
+// is 2 or run-length encoded per row if it is 10, with 'bitsPerPixel'
+// bits per pixel (16, 24 or 32)
+// The header is written immediately, the rows are added with 
+// TGAWriterWrite
+// If 'writer' already contains a writer, it is closed
+// return 0 upon success, else
+// 1 : couldn't open the file
+// 2 : invalid arguments
+// 3 : couldn't write the file or allocate memory
+int TGAWriterOpen(TGAWriter **writer, char *fileName, VecShort *dim,
+  char dataTypeCode, char bitsPerPixel) {
+  // Check arguments
+  if (writer == NULL || fileName == NULL || dim == NULL ||
+    VecGet(dim, 0) <= 0 || VecGet(dim, 1) <= 0 ||
+    (dataTypeCode != 2 && dataTypeCode != 10) ||
+    (bitsPerPixel != 16 && bitsPerPixel != 24 && bitsPerPixel != 32))
+    return 2;
+  // If the writer in argument is already used
+  if (*writer != NULL)
+    // Close it
+    TGAWriterClose(writer);
+  // Allocate memory for the writer
+  *writer = (TGAWriter*)malloc(sizeof(TGAWriter));
+  // If we couldn't allocate memory
+  if (*writer == NULL)
+    // Stop here
+    return 3;
+  // Set a pointer to the write buffer
+  TGAWriteBuffer *buffer = &((*writer)->_buffer);
+  // Allocate memory for the write buffer and the encoded row, big 
+  // enough for the worst case of run-length encoding
+  buffer->_data = (unsigned char*)malloc(TGA_IOBUFSIZE);
+  (*writer)->_row = (unsigned char*)malloc(
+    (size_t)VecGet(dim, 0) * (bitsPerPixel / 8 + 1));
+  // If we couldn't allocate memory
+  if (buffer->_data == NULL || (*writer)->_row == NULL) {
+    // Stop here
+    free(buffer->_data);
+    free((*writer)->_row);
+    free(*writer);
+    *writer = NULL;
+    return 3;
+  }
+  // Open the file
+  buffer->_stream = fopen(fileName,"w");
+  // If we couln't open the file
+  if (buffer->_stream == NULL) {
+    // Stop here
+    free(buffer->_data);
+    free((*writer)->_row);
+    free(*writer);
+    *writer = NULL;
+    return 1;
+  }
+  // Initialise the write buffer
+  buffer->_capacity = TGA_IOBUFSIZE;
+  buffer->_size = 0;
+  buffer->_growable = false;
+  buffer->_total = 0;
+  buffer->_error = false;
+  // Initialize the header values
+  TGAHeader *h = &((*writer)->_header);
+  h->_idLength = 0;
+  h->_colorMapType = 0;
+  h->_dataTypeCode = dataTypeCode;
+  h->_colorMapOrigin = 0;
+  h->_colorMapLength = 0;
+  h->_colorMapDepth = 0;
+  h->_xOrigin = 0;
+  h->_yOrigin = 0;
+  h->_width = VecGet(dim, 0);
+  h->_height = VecGet(dim, 1);
+  h->_bitsPerPixel = bitsPerPixel;
+  h->_imageDescriptor = 0;
+  // Write the header
+  TGAWriteHeader(buffer, h, dataTypeCode, bitsPerPixel);
+  (*writer)->_nbRowWritten = 0;
+  // Return success code
+  return 0;
+}
+
+// Encode and write the band of 'nbRow' rows in 'pix' with the writer
+// 'writer'
+// Rows are stored from bottom to top in 'pix' as in a TGALayer, and
+// bands must be given from the bottom of the image to its top
+// return 0 upon success, else
+// 2 : invalid arguments, or more rows than the height of the image
+// 3 : couldn't write the file
+int TGAWriterWrite(TGAWriter *writer, TGAPixel *pix, short nbRow) {
+  // Check arguments
+  if (writer == NULL || pix == NULL || nbRow < 0 ||
+    nbRow > writer->_header._height - writer->_nbRowWritten)
+    return 2;
+  // Write the rows
+  TGAWriteRows(&(writer->_buffer), pix, writer->_header._width, nbRow,
+    writer->_header._dataTypeCode, writer->_header._bitsPerPixel / 8,
+    writer->_row);
+  writer->_nbRowWritten += nbRow;
+  // Return the error code
+  return (writer->_buffer._error ? 3 : 0);
+}
+
+// Write the remaining data of the writer 'writer', close the file and
+// free the memory it uses
+// return 0 upon success, else
+// 3 : couldn't write the file
+// 4 : not all the rows of the image have been written
+int TGAWriterClose(TGAWriter **writer) {
+  // Check arguments
+  if (writer == NULL || *writer == NULL) return 0;
+  // Set a pointer to the write buffer
+  TGAWriteBuffer *buffer = &((*writer)->_buffer);
+  // Write the remaining data
+  TGAWriteBufferFlush(buffer);
+  // Close the file
+  if (fclose(buffer->_stream) != 0)
+    buffer->_error = true;
+  // Get the error code
+  int err = 0;
+  if (buffer->_error == true)
+    err = 3;
+  else if ((*writer)->_nbRowWritten < (*writer)->_header._height)
+    err = 4;
+  // Free memory
+  free(buffer->_data);
+  free((*writer)->_row);
+  free(*writer);
+  *writer = NULL;
+  // Return the error code
+  return err;
+}
+
+// Encode the header 'h' into the TGA_HEADERSIZE bytes of 'buffer'
+void TGAHeaderEncode(TGAHeader *h, unsigned char *buffer) {
+  // Encode the values, stored in little endian in the file
+  buffer[0] = h->_idLength;
+  buffer[1] = h->_colorMapType;
+  buffer[2] = h->_dataTypeCode;
+  buffer[3] = h->_colorMapOrigin & 0xFF;
+  buffer[4] = (h->_colorMapOrigin >> 8) & 0xFF;
+  buffer[5] = h->_colorMapLength & 0xFF;
+  buffer[6] = (h->_colorMapLength >> 8) & 0xFF;
+  buffer[7] = h->_colorMapDepth;
+  buffer[8] = h->_xOrigin & 0xFF;
+  buffer[9] = (h->_xOrigin >> 8) & 0xFF;
+  buffer[10] = h->_yOrigin & 0xFF;
+  buffer[11] = (h->_yOrigin >> 8) & 0xFF;
+  buffer[12] = h->_width & 0xFF;
+  buffer[13] = (h->_width >> 8) & 0xFF;
+  buffer[14] = h->_height & 0xFF;
+  buffer[15] = (h->_height >> 8) & 0xFF;
+  buffer[16] = h->_bitsPerPixel;
+  buffer[17] = h->_imageDescriptor;
+}
+
+// Encode 'nb' pixels from 'pix' as uncompressed pixels of 'bytes' 
+// bytes into 'data'
+void TGAEncodePixels(TGAPixel *pix, long nb, int bytes, 
+  unsigned char *data) {
+  // Convert the RGBA values of the pixels directly into the file 
+  // format
+  unsigned char *rgba = (unsigned char*)pix;
+  if (bytes == 4)
+    TGARowBGRAToRGBA(data, rgba, nb);
+  else if (bytes == 3)
+    TGARowRGBAToBGR(data, rgba, nb);
+  else if (bytes == 2)
+    TGARowRGBATo1555(data, rgba, nb);
+}
+
+// Encode 'nb' pixels from 'pix' as run-length encoded pixels of 
+// 'bytes' bytes into 'data', which must be able to contain 
+// nb * (bytes + 1) bytes
+// Packets don't cross the end of the 'nb' pixels
+// Return the number of bytes written in 'data'
+long TGAEncodeRLE(TGAPixel *pix, long nb, int bytes, 
+  unsigned char *data) {
+  // Encode the raw pixels at the end of 'data', as the encoded 
+  // pixels are written before them they are never overwritten
+  // before being read
+  unsigned char *raw = data + nb;
+  TGAEncodePixels(pix, nb, bytes, raw);
+  // Declare a variable to memorize the number of written bytes
+  long size = 0;
+  // Declare a variable to memorize the index of the current pixel
+  long i = 0;
+  // While there are pixels to encode
+  while (i < nb) {
+    // Get the length of the run starting at the current pixel
+    long run = 1;
+    while (i + run < nb && run < 128 &&
+      memcmp(raw + i * bytes, raw + (i + run) * bytes, bytes) == 0)
+      ++run;
+    // If there is a run of at least 2 pixels
+    if (run >= 2) {
+      // Write a run-length packet
+      data[size] = 0x80 | (run - 1);
+      memmove(data + size + 1, raw + i * bytes, bytes);
+      size += 1 + bytes;
+      i += run;
+    // Else, the pixels are different
+    } else {
+      // Get the length of the raw packet, up to the next run
+      long len = 1;
+      while (i + len < nb && len < 128 && 
+        (i + len + 1 >= nb || memcmp(raw + (i + len) * bytes, 
+        raw + (i + len + 1) * bytes, bytes) != 0))
+        ++len;
+      // Write a raw packet
+      data[size] = len - 1;
+      memmove(data + size + 1, raw + i * bytes, len * bytes);
+      size += 1 + len * bytes;
+      i += len;
+    }
+  }
+  // Return the number of written bytes
+  return size;
+}
+
+// Add the 'size' bytes of 'data' to the write buffer 'buffer',
+// flushing it when it's full
+void TGAWriteBufferPut(TGAWriteBuffer *buffer, unsigned char *data, 
+  long size) {
+  // While there is data to add
+  while (size > 0) {
+    // If the buffer is full
+    if (buffer->_size == buffer->_capacity) {
+      // If the buffer has a stream
+      if (buffer->_stream != NULL) {
+        // Flush the buffer
+        TGAWriteBufferFlush(buffer);
+      // Else, if we couldn't grow the buffer
+      } else if (TGAWriteBufferGrow(buffer, size) == false) {
+        // Drop the data but keep counting it
+        buffer->_total += size;
+        buffer->_error = true;
+        return;
+      }
+    }
+    // Copy as much data as possible in the buffer
+    long nb = buffer->_capacity - buffer->_size;
+    if (nb > size)
+      nb = size;
+    memcpy(buffer->_data + buffer->_size, data, nb);
+    buffer->_size += nb;
+    buffer->_total += nb;
+    data += nb;
+    size -= nb;
+  }
+}
+
+// Write the content of the write buffer 'buffer' to its stream and
+// empty it
+// Do nothing if the buffer has no stream
+void TGAWriteBufferFlush(TGAWriteBuffer *buffer) {
+  // If the buffer has no stream, its content is the result
+  if (buffer->_stream == NULL)
+    return;
+  // If the buffer is not empty and no error occured
+  if (buffer->_size > 0 && buffer->_error == false) {
+    // Write the buffer
+    if (fwrite(buffer->_data, 1, buffer->_size, buffer->_stream) != 
+      (size_t)(buffer->_size))
+      buffer->_error = true;
+  }
+  // Empty the buffer
+  buffer->_size = 0;
+}
+
+// Reallocate the write buffer without stream 'buffer' to be able to
+// add at least 'size' bytes
+// Return false if the buffer is not growable or the reallocation 
+// failed
+bool TGAWriteBufferGrow(TGAWriteBuffer *buffer, long size) {
+  // If the buffer is not growable
+  if (buffer->_growable == false)
+    // Stop here
+    return false;
+  // Get the new capacity, at least doubled to limit the number of
+  // reallocations
+  long capacity = 2 * buffer->_capacity;
+  if (capacity < buffer->_size + size)
+    capacity = buffer->_size + size;
+  if (capacity < TGA_HEADERSIZE)
+    capacity = TGA_HEADERSIZE;
+  // Reallocate the buffer
+  unsigned char *data = 
+    (unsigned char*)realloc(buffer->_data, (size_t)capacity);
+  // If we couldn't reallocate the buffer
+  if (data == NULL)
+    // Stop here, the buffer is unchanged
+    return false;
+  // Update the buffer
+  buffer->_data = data;
+  buffer->_capacity = capacity;
+  // Return success
+  return true;
+}
+
+// Print the header of 'tga' on 'stream'
+// If arguments are invalid, do nothing
+void TGAPrintHeader(TGA *tga, FILE *stream) {
+  // Check arguments
+  if (tga == NULL || stream == NULL) return;
+  // Set a pointer to the header
+  TGAHeader *h = tga->_header;
+  // If the header is not defined
+  if (h == NULL) 
+    // Stop here
+    return;
+  // Print the header info
+  fprintf(stream, "ID length:         %d\n", h->_idLength);
+  fprintf(stream, "Colourmap type:    %d\n", h->_colorMapType);
+  fprintf(stream, "Image type:        %d\n", h->_dataTypeCode);
+  fprintf(stream, "Colour map offset: %d\n", h->_colorMapOrigin);
+  fprintf(stream, "Colour map length: %d\n", h->_colorMapLength); 
+  fprintf(stream, "Colour map depth:  %d\n", h->_colorMapDepth);
+  fprintf(stream, "X origin:          %d\n", h->_xOrigin);
+  fprintf(stream, "Y origin:          %d\n", h->_yOrigin);
+  fprintf(stream, "Width:             %d\n", h->_width);
+  fprintf(stream, "Height:            %d\n", h->_height);
+  fprintf(stream, "Bits per pixel:    %d\n", h->_bitsPerPixel);
+  fprintf(stream, "Descriptor:        %d\n", h->_imageDescriptor);
+}
+
+// Return true if 'pos' is inside 'tga'
+// Return false else, or if arguments are invalid
+bool TGAIsPosInside(TGA *tga, VecShort *pos) {
+  // Check arguments
+  if (tga == NULL || pos == NULL || VecDim(pos) < 2)
+    return false;
+  // If the position is in the tga
+  if (VecGet(pos, 0) >= 0 && VecGet(pos, 0) < tga->_header->_width && 
+    VecGet(pos, 1) >= 0 && VecGet(pos, 1) < tga->_header->_height)
+    return true;
+  // Else, the position is not in the tga
+  else
+    return false;
+}
+
+// Get a pointer to the pixel at coord (x,y) = (pos[0],pos[1])
+// in the current layer
+// Return NULL in case of invalid arguments
+TGAPixel* TGAGetPix(TGA *tga, VecShort *pos) {
+  // Check arguments
+  if (tga == NULL || pos == NULL ||
+    tga->_layers == NULL || tga->_header == NULL) 
+    return NULL;
+  // Return a pointer toward the requested pixel in the current layer
+  return TGALayerGetPix(tga->_curLayer, pos);
+}
+
+// Set the color of one pixel at coord (x,y) = (pos[0],pos[1]) to 'pix'
+// Do nothing in case of invalid arguments
+void TGASetPix(TGA *tga, VecShort *pos, TGAPixel *pix) {
+  // Check arguments
+  if (tga == NULL) 
+    return;
+  // Set the pixel in the current layer
+  TGALayerSetPix(tga->_curLayer, pos, pix);
+}
+
+// Draw one stroke at 'pos' with 'pen' of type tgaPenShapoid
+// in current layer
+// Don't do anything in case of invalid arguments
+void TGAStrokePixShapoid(TGA *tga, VecFloat *pos, TGAPencil *pen) {
+  // Check arguments
+  if (tga == NULL) 
+    return;
+  // Stroke in the current layer
+  TGALayerStrokePixShapoid(tga->_curLayer, pos, pen);
+}
+
+// Draw one stroke at 'pos' with 'pen' of type tgaPenPixel
+// in current layer
+// Don't do anything in case of invalid arguments
+void TGAStrokePixOnePixel(TGA *tga, VecFloat *pos, TGAPencil *pen) {
+  // Check arguments
+  if (tga == NULL) 
+    return;
+  // Stroke in the current layer
+  TGALayerStrokePixOnePixel(tga->_curLayer, pos, pen);
+}
+
+// Draw one stroke at 'pos' with 'pen' of type tgaPenPixel
+// in layer 'that'
+// Don't do anything in case of invalid arguments
+void TGALayerStrokePixOnePixel(TGALayer *that, 
+  VecFloat *pos, TGAPencil *pen) {
+  // Check arguments
+  if (that == NULL || pos == NULL || pen == NULL) return;
+  // Declare a variable for the integer position of the 
+  // current pixel
+  VecShort *q = VecShortCreate(2);
+  if (q == NULL)
+    return;
+  VecSet(q, 0, (short)floor(VecGet(pos, 0)));
+  VecSet(q, 1, (short)floor(VecGet(pos, 1)));
+  // Get the curent pixel of the tga
+  TGAPixel *pixTga = TGALayerGetPix(that, q);
+  // If the pixel is in the clip box and not in read only mode
+  if (pixTga != NULL && 
+    VecGet(q, 0) >= VecGet(that->_clip, 0) && 
+    VecGet(q, 1) >= VecGet(that->_clip, 1) && 
+    VecGet(q, 0) <= VecGet(that->_clip, 2) && 
+    VecGet(q, 1) <= VecGet(that->_clip, 3) && 
+    TGALayerIsReadOnly(that, q) == false) {
+    // Get the curent pixel of the pencil
+    TGAPixel pixPen;
+    TGAPencilGetPixelTo(pen, &pixPen);
+    // Mix the color of the current pixel with the pencil's one
+    TGAPixelMixTo(pixTga, pixTga, &pixPen, 1.0);
+    // Add the pixel to the modified area of the layer
+    TGALayerAddDirty(that, VecGet(q, 0), VecGet(q, 1), VecGet(q, 0), 
+      VecGet(q, 1));
+  }
+  // Free memory
+  VecFree(&q);
+}
+
+// Draw one stroke at 'pos' with 'pen' of type tgaPenShapoid
+// in layer 'that'
+// Don't do anything in case of invalid arguments
+void TGALayerStrokePixShapoid(TGALayer *that, 
+  VecFloat *pos, TGAPencil *pen) {
+  // Check arguments
+  if (that == NULL || pos == NULL || pen == NULL) return;
+  // Get the pixel containing the position and the sub-pixel phase of
+  // the position
+  float x = floor(VecGet(pos, 0));
+  float y = floor(VecGet(pos, 1));
+  int ix = (int)((VecGet(pos, 0) - x) * (float)TGA_PENCILNBPHASE);
+  int iy = (int)((VecGet(pos, 1) - y) * (float)TGA_PENCILNBPHASE);
+  if (ix > TGA_PENCILNBPHASE - 1) ix = TGA_PENCILNBPHASE - 1;
+  if (iy > TGA_PENCILNBPHASE - 1) iy = TGA_PENCILNBPHASE - 1;
+  // Get the stamp of the pen tip for this phase
+  TGAPencilStamp *stamp = TGAPencilGetStamp(pen, ix, iy);
+  // Declare a variable for the integer position of the 
+  // current pixel
+  VecShort *q = VecShortCreate(2);
+  // If we couldn't allocate memory or get the necessary information
+  if (stamp == NULL || q == NULL) {
+    // Free memory and stop here
+    VecFree(&q);
+    return;
+  }
+  // Get the curent color of the pencil
+  TGAPixel pix;
+  TGAPencilGetPixelTo(pen, &pix);
+  // Add the stamp to the modified area of the layer
+  TGALayerAddDirty(that, (int)x + stamp->_x, (int)y + stamp->_y, 
+    (int)x + stamp->_x + stamp->_width - 1, 
+    (int)y + stamp->_y + stamp->_height - 1);
+  // Get the pixels of the stamp inside the clip box
+  int iFrom = VecGet(that->_clip, 0) - ((int)x + stamp->_x);
+  int jFrom = VecGet(that->_clip, 1) - ((int)y + stamp->_y);
+  int iTo = VecGet(that->_clip, 2) - ((int)x + stamp->_x);
+  int jTo = VecGet(that->_clip, 3) - ((int)y + stamp->_y);
+  if (iFrom < 0) iFrom = 0;
+  if (jFrom < 0) jFrom = 0;
+  if (iTo > stamp->_width - 1) iTo = stamp->_width - 1;
+  if (jTo > stamp->_height - 1) jTo = stamp->_height - 1;
+  // For each pixel of the stamp
+  for (short j = jFrom; j <= jTo; ++j) {
+    for (short i = iFrom; i <= iTo; ++i) {
+      // Get the number of hits of this pixel by the tip
+      int iStamp = j * stamp->_width + i;
+      int hits = stamp->_hits[iStamp];
+      // If the pixel is not covered by the tip
+      if (hits == 0)
+        continue;
+      // Get the integer position of the current pixel
+      VecSet(q, 0, (short)x + stamp->_x + i);
+      VecSet(q, 1, (short)y + stamp->_y + j);
+      // Get a pointer to the current pixel
+      TGAPixel *curPix = TGALayerGetPix(that, q);
+      // If the pixel is in the tga
+      if (curPix != NULL && TGALayerIsReadOnly(that, q) == false) {
+        // If the pen doesn't use antialias
+        if (pen->_antialias == false) {
+          // Set the value of the pixel
+          *curPix = pix;
+        // Else, if the pencil uses antialias
+        } else {
+          // Blend the current pixel with the pixel from the pencil
+          // as many times as the tip hits it
+          for (int iHit = hits; iHit--;)
+            TGAPixelMixTo(curPix, curPix, &pix, 
+              stamp->_coverage[iStamp]);
+        }
+      }
+    }
+  }
+  // Free memory
+  VecFree(&q);
+}
+
+// Draw one stroke at 'pos' with 'pen'
+// in current layer
+// Do nothing in case of invalid arguments
+void TGAStrokePix(TGA *tga, VecFloat *pos, TGAPencil *pen) {
+  // Check arguments
+  if (tga == NULL) 
+    return;
+  // Stroke in current layer
+  TGALayerStrokePix(tga->_curLayer, pos, pen);
+}
+
+// Draw a line between 'from' and 'to' with pencil 'pen'
+// If the pencil is a pixel with antialias the line is antialiased
+// pixels outside the TGA are ignored
+// do nothing if arguments are invalid
+void TGADrawLine(TGA *tga, VecFloat *from, VecFloat *to, 
+  TGAPencil *pen) {
+  // Check arguments
+  if (tga == NULL || from == NULL || to == NULL || pen == NULL)
+    return;
+  // Clean the area of the working layer modified by the previous
+  // drawing
+  TGALayerCleanDirty(tga->_tmpLayer);
+  // Draw the line in the working layer
+  float pts[4] = {VecGet(from, 0), VecGet(from, 1), 
+    VecGet(to, 0), VecGet(to, 1)};
+  float blend[2] = {0.0, 1.0};
+  TGALayerAddPolyline(tga->_tmpLayer, pts, blend, 2, pen);
+  // Blend the area of the working layer modified by the line in 
+  // the current layer
+  TGALayerBlend(tga->_curLayer, tga->_tmpLayer, tga->_tmpLayer->_dirty);
+}
+  
+// Draw the BCurve 'curve' (must be of dimension 2 and order > 0)
+// do nothing if arguments are invalid
+void TGADrawBCurve(TGA *tga, BCurve *curve, TGAPencil *pen) {
+  // Check arguments
+  if (tga == NULL || curve == NULL || pen == NULL || 
+    BCurveOrder(curve) < 1)
+    return;
+  // Clean the area of the working layer modified by the previous
+  // drawing
+  TGALayerCleanDirty(tga->_tmpLayer);
+  // Draw the curve in the working layer
+  TGALayerAddCurve(tga->_tmpLayer, curve, pen);
+  // Blend the area of the working layer modified by the curve in 
+  // the current layer
+  TGALayerBlend(tga->_curLayer, tga->_tmpLayer, tga->_tmpLayer->_dirty);
+}
+
+// Draw the SCurve 'curve' (must be of dimension 2)
+// do nothing if arguments are invalid
+void TGADrawSCurve(TGA *tga, SCurve *curve, TGAPencil *pen) {
+  // Check arguments
+  if (tga == NULL || curve == NULL || pen == NULL)
+    return;
+  // Clean the area of the working layer modified by the previous
+  // drawing
+  TGALayerCleanDirty(tga->_tmpLayer);
+  // Declare a pointer to loop on BCurves of the SCurve
+  GSetElem *ptr = curve->_curves->_head;
+  while (ptr != NULL) {
+    // Draw the curve in the working layer
+    TGALayerAddCurve(tga->_tmpLayer, (BCurve*)(ptr->_data), pen);
+    // Move to the next curve
+    ptr = ptr->_next;
+  }
+  // Blend the area of the working layer modified by the curve in 
+  // the current layer
+  TGALayerBlend(tga->_curLayer, tga->_tmpLayer, tga->_tmpLayer->_dirty);
+}
+  
+// Draw a rectangle between 'from' and 'to' with pencil 'pen'
+// pixels outside the TGA are ignored
+// do nothing if arguments are invalid
+void TGADrawRect(TGA *tga, VecFloat *from, VecFloat *to, 
+  TGAPencil *pen) {
+  // Check arguments
+  if (tga == NULL || from == NULL || to == NULL || pen == NULL)
+    return;
+  // Create the Facoid equivalent to the rectangle
+  Shapoid *facoid = TGAShapoidCreateRect(from, to);
+  if (facoid != NULL) {
+    // Draw the Facoid
+    TGADrawShapoid(tga, facoid, pen);
+    // Free memory
+    ShapoidFree(&facoid);
+  }
+}
+
+// Fill a rectangle between 'from' and 'to' with pencil 'pen'
+// pixels outside the TGA are ignored
+// do nothing if arguments are invalid
+void TGAFillRect(TGA *tga, VecFloat *from, VecFloat *to, 
+  TGAPencil *pen) {
+  // Check arguments
+  if (tga == NULL || from == NULL || to == NULL || pen == NULL)
+    return;
+  // Create the Facoid equivalent to the rectangle
+  Shapoid *facoid = TGAShapoidCreateRect(from, to);
+  if (facoid != NULL) {
+    // Draw the Facoid
+    TGAFillShapoid(tga, facoid, pen);
+    // Free memory
+    ShapoidFree(&facoid);
+  }
+}
+
+// Draw a ellipse at 'center' of radius 'r' (Rx,Ry) 
+// with pencil 'pen' 
+// pixels outside the TGA are ignored
+// do nothing if arguments are invalid
+void TGADrawEllipse(TGA *tga, VecFloat *center, VecFloat *r, 
+  TGAPencil *pen) {
+  // Check arguments
+  if (tga == NULL || center == NULL || r == NULL || pen == NULL ||
+    VecGet(r, 0) <= 0.0 || VecGet(r, 1) <= 0.0)
+    return;
+  // Create the Spheroid equivalent to the ellipse
+  Shapoid *spheroid = TGAShapoidCreateEllipse(center, r);
+  if (spheroid != NULL) {
+    // Draw the Spheroid
+    TGADrawShapoid(tga, spheroid, pen);
+    // Free memory
+    ShapoidFree(&spheroid);
+  }
+}
+
+// Fill an ellipse at 'center' of radius 'r' (Rx, Ry) with pencil 'pen'
+// pixels outside the TGA are ignored
+// do nothing if arguments are invalid
+void TGAFillEllipse(TGA *tga, VecFloat *center, VecFloat *r, 
+  TGAPencil *pen) {
+  // Check arguments
+  if (tga == NULL || center == NULL || r == NULL || pen == NULL ||
+    VecGet(r, 0) <= 0.0 || VecGet(r, 1) <= 0.0)
+    return;
+  // Create the Spheroid equivalent to the ellipse
+  Shapoid *spheroid = TGAShapoidCreateEllipse(center, r);
+  if (spheroid != NULL) {
+    // Draw the Spheroid
+    TGAFillShapoid(tga, spheroid, pen);
+    // Free memory
+    ShapoidFree(&spheroid);
+  }
+}
+
+// Draw the shapoid 's' with pencil 'pen' 
+// The shapoid must be of dimension 2
+// Pixels outside the TGA are ignored
+// Do nothing if arguments are invalid
+void TGADrawShapoid(TGA *tga, Shapoid *s, TGAPencil *pen) {
+  // Check arguments
+  if (tga == NULL || s == NULL || pen == NULL || ShapoidGetDim(s) != 2)
+    return;
+  // Get the SCurve equivalent to the Shapoid
+  SCurve *curve = Shapoid2SCurve(s);
+  // If we could get the SCurve
+  if (curve != NULL) {
+    // Draw the SCurve
+    TGADrawSCurve(tga, curve, pen);
+    // Free memory
+    SCurveFree(&curve);
+  }
+}
+
+// Fill the shapoid 's' with pencil 'pen' 
+// The shapoid must be of dimension 2
+// If the pencil is a pixel with antialias, the pixels on the border 
+// of the shapoid are mixed according to their coverage
+// Pixels outside the TGA are ignored
+// Do nothing if arguments are invalid
+void TGAFillShapoid(TGA *tga, Shapoid *s, TGAPencil *pen) {
+  // Check arguments
+  if (tga == NULL || s == NULL || pen == NULL ||
+    ShapoidGetDim(s) != 2)
+    return;
+  // Clean the area of the working layer modified by the previous
+  // drawing
+  TGALayerCleanDirty(tga->_tmpLayer);
+  // Fill the shapoid in the working layer
+  TGALayerFillShapoid(tga->_tmpLayer, s, pen);
+  // Blend the area of the working layer modified by the shapoid in
+  // the current layer
+  TGALayerBlend(tga->_curLayer, tga->_tmpLayer, 
+    tga->_tmpLayer->_dirty);
+}
+
+// Apply a gaussian blur of 'strength' and 'range' perimeter on the TGA
+// The blur is applied separately along the rows and the columns, the
+// pixels at a distance lower than 'range' along the row/column 
+// contributing with a weight given by the gaussian, normalized over 
+// the pixels inside the TGA
+// The TGA is blurred by bands of rows in parallel
+// Do nothing if arguments are invalid 
+void TGAFilterGaussBlur(TGA *tga, float strength, float range) {
+  // Check arguments
+  if (tga == NULL)
+    return;
+  // Blur the current layer
+  TGALayerFilterGaussBlur(tga->_curLayer, NULL, strength, range, 0);
+}
+
+// Apply a gaussian blur of 'strength' and 'range' perimeter on the 
+// layer 'that'
+// If VecShort 'bound' is not null only pixels inside the box
+// (bound[0],bound[1])-(bound[2],bound[3]) (included) are blurred, 
+// using the pixels of the layer around the box
+// The blur is applied separately along the rows and the columns, the
+// pixels at a distance lower than 'range' along the row/column 
+// contributing with a weight given by the gaussian, normalized over 
+// the pixels inside the layer
+// The layer is blurred by bands of rows in parallel with 'nbThread'
+// threads (as many as processors if 'nbThread' < 1)
+// Do nothing if arguments are invalid 
+void TGALayerFilterGaussBlur(TGALayer *that, VecShort *bound, 
+  float strength, float range, int nbThread) {
+  // Check arguments
+  if (that == NULL || strength <= 0.0)
+    return;
+  // Get the radius of the kernel, as the largest distance lower than
+  // the range
+  int radius = (int)ceil(range) - 1;
+  // Get the box to blur
+  int box[4];
+  // If the kernel is reduced to the current pixel or the box is empty
+  // there is nothing to blur
+  if (radius < 1 || TGALayerGetFilterBox(that, bound, box) == false)
+    return;
+  // Create a Gauss
+  Gauss *gauss = GaussCreate(0.0, strength);
+  // Allocate memory for the kernel
+  float *kernel = (float*)malloc((radius + 1) * sizeof(float));
+  // If we couldn't allocate memory
+  if (gauss == NULL || kernel == NULL) {
+    // Free memory and stop here
+    GaussFree(&gauss);
+    free(kernel);
+    return;
+  }
+  // Calculate the kernel, normalized on the whole window. Its values
+  // are symmetric so only the ones for distances 0 to radius are
+  // memorized
+  float sum = 0.0;
+  for (int d = 0; d <= radius; ++d) {
+    kernel[d] = GaussGet(gauss, (float)d);
+    sum += (d == 0 ? 1.0 : 2.0) * kernel[d];
+  }
+  for (int d = 0; d <= radius; ++d)
+    kernel[d] /= sum;
+  // Blur the box, each worker using a ring of rows blurred along the 
+  // rows and an accumulator for the blur along the columns
+  TGAFilterJob job;
+  TGAFilterJobInit(&job, that, box, radius, nbThread);
+  job._filter = TGAFilterGaussBand;
+  job._param = kernel;
+  job._scratchSize = (size_t)(2 * radius + 2) * 
+    (size_t)(box[2] - box[0] + 1) * 4 * sizeof(float);
+  if (TGAFilterJobRun(&job) == true)
+    // Add the box to the modified area of the layer
+    TGALayerAddDirty(that, box[0], box[1], box[2], box[3]);
+  // Free memory
+  GaussFree(&gauss);
+  free(kernel);
+}
+
+// Apply a recursive gaussian blur of 'strength' on the TGA
+// The gaussian is approximated with the recursive filter of Young and
+// van Vliet applied forward and backward along the rows and the 
+// columns, hence the cost per pixel doesn't depend on 'strength', and
+// the pixels outside the TGA are considered equal to the nearest 
+// pixel on its border
+// 'strength' lower than TGA_GAUSSRECURSIVEMIN is blurred with 
+// TGAFilterGaussBlur instead, as it is then cheap and the recursive
+// filter is less accurate
+// The TGA is blurred by bands of rows then by strips of columns 
+// in parallel, the values being rounded between the two passes
+// Do nothing if arguments are invalid 
+void TGAFilterGaussBlurRecursive(TGA *tga, float strength) {
+  // Check arguments
+  if (tga == NULL)
+    return;
+  // Blur the current layer
+  TGALayerFilterGaussBlurRecursive(tga->_curLayer, NULL, strength, 0);
+}
+
+// Apply a recursive gaussian blur of 'strength' on the layer 'that'
+// If VecShort 'bound' is not null only pixels inside the box
+// (bound[0],bound[1])-(bound[2],bound[3]) (included) are blurred, 
+// using the pixels of the layer at a distance up to 
+// TGA_GAUSSRECURSIVEHALO * 'strength' around the box
+// The gaussian is approximated with the recursive filter of Young and
+// van Vliet applied forward and backward along the rows and the 
+// columns, hence the cost per pixel doesn't depend on 'strength', and
+// the pixels outside the layer are considered equal to the nearest 
+// pixel on its border
+// 'strength' lower than TGA_GAUSSRECURSIVEMIN is blurred with 
+// TGALayerFilterGaussBlur instead, as it is then cheap and the 
+// recursive filter is less accurate
+// The layer is blurred by bands of rows then by strips of columns 
+// in parallel with 'nbThread' threads (as many as processors if 
+// 'nbThread' < 1), the values being rounded between the two passes
+// Do nothing if arguments are invalid 
+void TGALayerFilterGaussBlurRecursive(TGALayer *that, VecShort *bound,
+  float strength, int nbThread) {
+  // Check arguments
+  if (that == NULL || strength <= 0.0)
+    return;
+  // If the strength is too small for the recursive filter
+  if (strength < TGA_GAUSSRECURSIVEMIN) {
+    // Use the gaussian blur truncated where the weights become 
+    // negligible and stop here
+    TGALayerFilterGaussBlur(that, bound, strength, 
+      3.0 * strength + 1.0, nbThread);
+    return;
+  }
+  // Get the box to blur
+  int box[4];
+  // If the box is empty there is nothing to blur
+  if (TGALayerGetFilterBox(that, bound, box) == false)
+    return;
+  // Get the area of the filtered pixels, the box extended by the 
+  // halo inside the layer
+  TGARecursiveParam param;
+  memcpy(param._box, box, 4 * sizeof(int));
+  int halo = (int)ceil(TGA_GAUSSRECURSIVEHALO * strength);
+  for (int i = 2; i--;) {
+    param._area[i] = (box[i] > halo ? box[i] - halo : 0);
+    param._area[2 + i] = 
+      (box[2 + i] + halo < VecGet(that->_dim, i) - 1 ?
+      box[2 + i] + halo : VecGet(that->_dim, i) - 1);
+  }
+  // Calculate the coefficients of the filter
+  TGAGaussGetRecursiveCoef(strength, param._coef);
+  // Allocate memory for the rows of the area outside the box blurred
+  // along the rows, and the memory to blur the strips of columns in
+  // the calling thread if the threads can't be run
+  size_t nbVal = 4 * (size_t)(box[2] - box[0] + 1);
+  int nbHaloRow = 
+    box[1] - param._area[1] + param._area[3] - box[3];
+  size_t stripSize = 4 * TGA_FILTERSTRIPWIDTH * sizeof(float) * 
+    (size_t)(param._area[3] - param._area[1] + 1);
+  param._haloRows = (nbHaloRow > 0 ? 
+    (unsigned char*)malloc(nbHaloRow * nbVal) : NULL);
+  void *strip = malloc(stripSize);
+  // If we couldn't allocate memory
+  if ((nbHaloRow > 0 && param._haloRows == NULL) || strip == NULL) {
+    // Free memory and stop here
+    free(param._haloRows);
+    free(strip);
+    return;
+  }
+  // Blur the rows of the area by bands of rows, each row being 
+  // blurred independently of the others
+  TGAFilterJob job;
+  int rowBox[4] = {box[0], param._area[1], box[2], param._area[3]};
+  TGAFilterJobInit(&job, that, rowBox, 0, nbThread);
+  job._filter = TGAFilterRecursiveRowBand;
+  job._param = &param;
+  job._scratchSize = 
+    4 * (size_t)(param._area[2] - param._area[0] + 1) * sizeof(float);
+  // If we could blur the rows
+  if (TGAFilterJobRun(&job) == true) {
+    // Blur the columns of the box by strips of columns, each strip 
+    // being blurred independently of the others; the bands of this
+    // job are the strips
+    TGAFilterJobInit(&job, that, box, 0, nbThread);
+    job._nbBand = (box[2] - box[0] + TGA_FILTERSTRIPWIDTH) / 
+      TGA_FILTERSTRIPWIDTH;
+    job._filter = TGAFilterRecursiveColumnStrip;
+    job._param = &param;
+    job._scratchSize = stripSize;
+    // If we couldn't run the threads, blur the strips in the calling
+    // thread as the rows are already blurred
+    if (TGAFilterJobRun(&job) == false)
+      for (int iStrip = 0; iStrip < job._nbBand; ++iStrip)
+        TGAFilterRecursiveColumnStrip(&job, iStrip, strip);
+    // Add the box to the modified area of the layer
+    TGALayerAddDirty(that, box[0], box[1], box[2], box[3]);
+  }
+  // Free memory
+  free(param._haloRows);
+  free(strip);
+}
+
+// Get the row 'y' of the area of the TGARecursiveParam of the 
+// TGAFilterJob 'job', blurred along the rows if it is outside the box
+// of the blur
+// Return a pointer to its values in the first column of the box
+unsigned char* TGAFilterRecursiveGetRow(TGAFilterJob *job, int y) {
+  // Get the parameters
+  TGARecursiveParam *param = (TGARecursiveParam*)(job->_param);
+  int *box = param->_box;
+  long nbVal = 4 * (long)(box[2] - box[0] + 1);
+  // If the row is above the box, return its copy
+  if (y < box[1])
+    return param->_haloRows + (long)(y - param->_area[1]) * nbVal;
+  // If the row is below the box, return its copy
+  if (y > box[3])
+    return param->_haloRows + 
+      (long)(box[1] - param->_area[1] + y - box[3] - 1) * nbVal;
+  // Else, return the row of the layer
+  return (unsigned char*)(job->_layer->_pixels + 
+    (long)y * VecGet(job->_layer->_dim, 0) + box[0]);
+}
+
+// Filter of TGAFilterJob blurring along the rows the 'iBand'-th band
+// of 'job' with the TGARecursiveParam in its parameters, the band 
+// covering the rows of the area, the rows outside the box being 
+// written in the param's _haloRows
+// 'scratch' holds one row of the area in float
+void TGAFilterRecursiveRowBand(TGAFilterJob *job, int iBand, 
+  void *scratch) {
+  // Get the parameters and the memory for one row
+  TGARecursiveParam *param = (TGARecursiveParam*)(job->_param);
+  float *row = (float*)scratch;
+  int w = param->_area[2] - param->_area[0] + 1;
+  long nbVal = 4 * (long)(job->_box[2] - job->_box[0] + 1);
+  long width = VecGet(job->_layer->_dim, 0);
+  // Get the rows of the band
+  int y0, y1;
+  TGAFilterJobGetBand(job, iBand, &y0, &y1);
+  // For each row of the band
+  for (int y = y0; y <= y1; ++y) {
+    // Convert the pixels of the row in the area to float values
+    unsigned char *rgba = (unsigned char*)(job->_layer->_pixels + 
+      (long)y * width + param->_area[0]);
+    for (int i = w * 4; i--;)
+      row[i] = (float)(rgba[i]);
+    // Filter the row, the four channels of a pixel together
+    TGAFilterRecursive(row, w, 4, 4, param->_coef);
+    // Copy the filtered values of the box
+    unsigned char *to = TGAFilterRecursiveGetRow(job, y);
+    float *from = row + 4 * (job->_box[0] - param->_area[0]);
+    for (long i = nbVal; i--;)
+      to[i] = (unsigned char)(from[i] < 0.0 ? 0.0 : 
+        (from[i] > 255.0 ? 255.0 : from[i] + 0.5));
+  }
+}
+
+// Filter of TGAFilterJob blurring along the columns the 'iStrip'-th 
+// strip of TGA_FILTERSTRIPWIDTH columns of the box of 'job' with the
+// TGARecursiveParam in its parameters, the rows having been blurred
+// 'scratch' holds the strip over the rows of the area in float
+void TGAFilterRecursiveColumnStrip(TGAFilterJob *job, int iStrip, 
+  void *scratch) {
+  // Get the parameters and the memory for the strip
+  TGARecursiveParam *param = (TGARecursiveParam*)(job->_param);
+  float *data = (float*)scratch;
+  int h = param->_area[3] - param->_area[1] + 1;
+  // Get the columns of the strip, relatively to the box
+  int x0 = iStrip * TGA_FILTERSTRIPWIDTH;
+  int x1 = x0 + TGA_FILTERSTRIPWIDTH - 1;
+  if (x1 > job->_box[2] - job->_box[0])
+    x1 = job->_box[2] - job->_box[0];
+  int nbVal = 4 * (x1 - x0 + 1);
+  // Convert the values of the strip to float values
+  for (int y = 0; y < h; ++y) {
+    unsigned char *rgba = 
+      TGAFilterRecursiveGetRow(job, param->_area[1] + y) + 4 * x0;
+    float *row = data + (long)y * nbVal;
+    for (int i = nbVal; i--;)
+      row[i] = (float)(rgba[i]);
+  }
+  // Filter the columns, all the values of a row of the strip together
+  TGAFilterRecursive(data, h, nbVal, nbVal, param->_coef);
+  // Copy the filtered values of the box in the pixels
+  for (int y = job->_box[1]; y <= job->_box[3]; ++y) {
+    unsigned char *rgba = TGAFilterRecursiveGetRow(job, y) + 4 * x0;
+    float *row = data + (long)(y - param->_area[1]) * nbVal;
+    for (int i = nbVal; i--;)
+      rgba[i] = (unsigned char)(row[i] < 0.0 ? 0.0 : 
+        (row[i] > 255.0 ? 255.0 : row[i] + 0.5));
+  }
+}
+
+// Calculate in 'coef' the coefficients (B, b1/b0, b2/b0, b3/b0) of the
+// recursive filter of Young and van Vliet approximating a gaussian of 
+// standard deviation 'sigma' (>= 0.5)
+void TGAGaussGetRecursiveCoef(float sigma, float *coef) {
+  // Get the parameter of the filter for this sigma
+  double q = (sigma >= 2.5 ? 0.98711 * sigma - 0.96330 :
+    3.97156 - 4.14554 * sqrt(1.0 - 0.26891 * sigma));
+  double q2 = q * q;
+  double q3 = q2 * q;
+  // Get the coefficients of the filter
+  double b0 = 1.57825 + 2.44413 * q + 1.4281 * q2 + 0.422205 * q3;
+  double b1 = 2.44413 * q + 2.85619 * q2 + 1.26661 * q3;
+  double b2 = -1.4281 * q2 - 1.26661 * q3;
+  double b3 = 0.422205 * q3;
+  coef[1] = b1 / b0;
+  coef[2] = b2 / b0;
+  coef[3] = b3 / b0;
+  coef[0] = 1.0 - coef[1] - coef[2] - coef[3];
+}
+
+// Apply forward then backward the recursive filter of coefficients 
+// 'coef' on the 'nb' samples of 'data', each sample made of 'nbLane'
+// contiguous values, separated by 'stride' values
+// The samples before the first one and after the last one are 
+// considered equal to them
+void TGAFilterRecursive(float *data, int nb, long stride, int nbLane,
+  float *coef) {
+  // For each sample, forward
+  for (int i = 0; i < nb; ++i) {
+    // Get the current and previous samples, the first sample standing
+    // for the ones before it (as the filter has a unit gain, the
+    // first sample is unchanged)
+    float *p = data + (long)i * stride;
+    float *p1 = data + (long)(i > 0 ? i - 1 : 0) * stride;
+    float *p2 = data + (long)(i > 1 ? i - 2 : 0) * stride;
+    float *p3 = data + (long)(i > 2 ? i - 3 : 0) * stride;
+    // Filter the values of the sample
+    for (int l = 0; l < nbLane; ++l)
+      p[l] = coef[0] * p[l] + coef[1] * p1[l] + coef[2] * p2[l] + 
+        coef[3] * p3[l];
+  }
+  // For each sample, backward
+  for (int i = nb; i--;) {
+    // Get the current and next samples, the last sample standing
+    // for the ones after it
+    float *p = data + (long)i * stride;
+    float *p1 = data + (long)(i < nb - 1 ? i + 1 : nb - 1) * stride;
+    float *p2 = data + (long)(i < nb - 2 ? i + 2 : nb - 1) * stride;
+    float *p3 = data + (long)(i < nb - 3 ? i + 3 : nb - 1) * stride;
+    // Filter the values of the sample
+    for (int l = 0; l < nbLane; ++l)
+      p[l] = coef[0] * p[l] + coef[1] * p1[l] + coef[2] * p2[l] + 
+        coef[3] * p3[l];
+  }
+}
+
+// Apply an approximated gaussian blur of 'strength' on the TGA
+// The gaussian is approximated with TGA_GAUSSBOXNBPASS successive box
+// blurs along the rows and the columns, whose widths are chosen to 
+// get the variance of the gaussian, calculated with running sums on
+// integers, hence the cost per pixel doesn't depend on 'strength'
+// Compared to TGAFilterGaussBlur on a noisy image, the values at more
+// than 3 * 'strength' from the borders differ by up to 9 (rms 3) for 
+// 'strength' around 2, and by 1 (rms 0.4) above 10. Closer to the 
+// borders they differ more, as TGAFilterGaussBlur normalizes the 
+// weights over the pixels inside the TGA
+// 'strength' lower than TGA_GAUSSBOXMIN is blurred with 
+// TGAFilterGaussBlur instead, as it is then cheap and the boxes are
+// too narrow to approximate the gaussian
+// The pixels outside the TGA are considered equal to the nearest 
+// pixel on its border
+// The TGA is blurred by bands of rows in parallel
+// Do nothing if arguments are invalid 
+void TGAFilterGaussBlurBox(TGA *tga, float strength) {
   // Check arguments
-  if (tga == NULL || pos == NULL ||
-    tga->_layers == NULL || tga->_header == NULL) 
+  if (tga == NULL)
+    return;
+  // Blur the current layer
+  TGALayerFilterGaussBlurBox(tga->_curLayer, NULL, strength, 0);
+}
+
+// Apply an approximated gaussian blur of 'strength' on the layer 
+// 'that'
+// If VecShort 'bound' is not null only pixels inside the box
+// (bound[0],bound[1])-(bound[2],bound[3]) (included) are blurred, 
+// using the pixels of the layer around the box
+// The gaussian is approximated as in TGAFilterGaussBlurBox
+// 'strength' lower than TGA_GAUSSBOXMIN is blurred with 
+// TGALayerFilterGaussBlur instead
+// The pixels outside the layer are considered equal to the nearest 
+// pixel on its border
+// The layer is blurred by bands of rows in parallel with 'nbThread'
+// threads (as many as processors if 'nbThread' < 1)
+// Do nothing if arguments are invalid 
+void TGALayerFilterGaussBlurBox(TGALayer *that, VecShort *bound, 
+  float strength, int nbThread) {
+  // Check arguments
+  if (that == NULL || strength <= 0.0)
+    return;
+  // If the strength is too small for the boxes
+  if (strength < TGA_GAUSSBOXMIN) {
+    // Use the gaussian blur truncated where the weights become 
+    // negligible and stop here
+    TGALayerFilterGaussBlur(that, bound, strength, 
+      3.0 * strength + 1.0, nbThread);
+    return;
+  }
+  // Get the box to blur
+  int box[4];
+  // If the box is empty there is nothing to blur
+  if (TGALayerGetFilterBox(that, bound, box) == false)
+    return;
+  // Get the radius of the boxes
+  int radius[TGA_GAUSSBOXNBPASS];
+  TGAGaussGetBoxRadius(strength, TGA_GAUSSBOXNBPASS, radius);
+  // Blur the box, the pixels of a band being affected by the ones at
+  // a distance up to the sum of the radius
+  TGAFilterJob job;
+  int halo = 0;
+  for (int iPass = TGA_GAUSSBOXNBPASS; iPass--;)
+    halo += radius[iPass];
+  TGAFilterJobInit(&job, that, box, halo, nbThread);
+  // Each worker uses two copies of the band extended by the halo and
+  // the running sums of one row
+  size_t nbVal = 4 * (size_t)(job._cols[1] - job._cols[0] + 1);
+  job._filter = TGAFilterBoxBand;
+  job._param = radius;
+  job._scratchSize = 2 * (size_t)(job._bandHeight + 2 * halo) * nbVal + 
+    nbVal * sizeof(unsigned int);
+  if (TGAFilterJobRun(&job) == true)
+    // Add the box to the modified area of the layer
+    TGALayerAddDirty(that, box[0], box[1], box[2], box[3]);
+}
+
+// Create a kernel of convolution of radius 'rx' along the rows and 
+// 'ry' along the columns, with all its coefficients equal to 0, no
+// bias, convolving the alpha channel, in float
+// Return NULL if arguments are invalid or we couldn't allocate memory
+TGAKernel* TGAKernelCreate(int rx, int ry) {
+  // Check arguments
+  if (rx < 0 || ry < 0)
     return NULL;
-  // Return a pointer toward the requested pixel in the current layer
-  return TGALayerGetPix(tga->_curLayer, pos);
+  // Allocate memory
+  TGAKernel *ret = (TGAKernel*)malloc(sizeof(TGAKernel));
+  // If we could allocate memory
+  if (ret != NULL) {
+    // Set the properties
+    ret->_radius[0] = rx;
+    ret->_radius[1] = ry;
+    ret->_separable = false;
+    ret->_bias = 0.0;
+    ret->_alpha = true;
+    ret->_fixed = false;
+    // Allocate memory for the coefficients, set to 0
+    ret->_coeff = 
+      (float*)calloc((2 * rx + 1) * (2 * ry + 1), sizeof(float));
+    // If we couldn't allocate memory
+    if (ret->_coeff == NULL) {
+      // Free memory
+      free(ret);
+      ret = NULL;
+    }
+  }
+  // Return the new kernel
+  return ret;
 }
 
-// Set the color of one pixel at coord (x,y) = (pos[0],pos[1]) to 'pix'
-// Do nothing in case of invalid arguments
-void TGASetPix(TGA *tga, VecShort *pos, TGAPixel *pix) {
+// Create a separable kernel of convolution of radius 'rx' along the 
+// rows and 'ry' along the columns, with all its coefficients equal to
+// 0, no bias, convolving the alpha channel, in float
+// Return NULL if arguments are invalid or we couldn't allocate memory
+TGAKernel* TGAKernelCreateSeparable(int rx, int ry) {
   // Check arguments
-  if (tga == NULL) 
+  if (rx < 0 || ry < 0)
+    return NULL;
+  // Allocate memory
+  TGAKernel *ret = (TGAKernel*)malloc(sizeof(TGAKernel));
+  // If we could allocate memory
+  if (ret != NULL) {
+    // Set the properties
+    ret->_radius[0] = rx;
+    ret->_radius[1] = ry;
+    ret->_separable = true;
+    ret->_bias = 0.0;
+    ret->_alpha = true;
+    ret->_fixed = false;
+    // Allocate memory for the coefficients, set to 0
+    ret->_coeff = (float*)calloc(2 * rx + 2 * ry + 2, sizeof(float));
+    // If we couldn't allocate memory
+    if (ret->_coeff == NULL) {
+      // Free memory
+      free(ret);
+      ret = NULL;
+    }
+  }
+  // Return the new kernel
+  return ret;
+}
+
+// Free the memory used by the TGAKernel 'that'
+void TGAKernelFree(TGAKernel **that) {
+  // Check arguments
+  if (that == NULL || *that == NULL)
     return;
-  // Set the pixel in the current layer
-  TGALayerSetPix(tga->_curLayer, pos, pix);
+  // Free memory
+  free((*that)->_coeff);
+  free(*that);
+  *that = NULL;
 }
 
-// Draw one stroke at 'pos' with 'pen' of type tgaPenShapoid
-// in current layer
-// Don't do anything in case of invalid arguments
-void TGAStrokePixShapoid(TGA *tga, VecFloat *pos, TGAPencil *pen) {
+// Set the coefficient at (x,y) (relative to the center) of the non
+// separable TGAKernel 'that' to 'v'
+// Do nothing if arguments are invalid
+void TGAKernelSet(TGAKernel *that, int x, int y, float v) {
   // Check arguments
-  if (tga == NULL) 
+  if (that == NULL || that->_separable == true ||
+    abs(x) > that->_radius[0] || abs(y) > that->_radius[1])
     return;
-  // Stroke in the current layer
-  TGALayerStrokePixShapoid(tga->_curLayer, pos, pen);
+  // Set the coefficient
+  that->_coeff[(y + that->_radius[1]) * (2 * that->_radius[0] + 1) + 
+    x + that->_radius[0]] = v;
 }
 
-// Draw one stroke at 'pos' with 'pen' of type tgaPenPixel
-// in current layer
-// Don't do anything in case of invalid arguments
-void TGAStrokePixOnePixel(TGA *tga, VecFloat *pos, TGAPencil *pen) {
+// Set the coefficient at 'x' (relative to the center) along the rows
+// of the separable TGAKernel 'that' to 'v'
+// Do nothing if arguments are invalid
+void TGAKernelSetX(TGAKernel *that, int x, float v) {
   // Check arguments
-  if (tga == NULL) 
+  if (that == NULL || that->_separable == false ||
+    abs(x) > that->_radius[0])
     return;
-  // Stroke in the current layer
-  TGALayerStrokePixOnePixel(tga->_curLayer, pos, pen);
+  // Set the coefficient
+  that->_coeff[x + that->_radius[0]] = v;
 }
 
-// Draw one stroke at 'pos' with 'pen' of type tgaPenPixel
-// in layer 'that'
-// Don't do anything in case of invalid arguments
-void TGALayerStrokePixOnePixel(TGALayer *that, 
-  VecFloat *pos, TGAPencil *pen) {
+// Set the coefficient at 'y' (relative to the center) along the 
+// columns of the separable TGAKernel 'that' to 'v'
+// Do nothing if arguments are invalid
+void TGAKernelSetY(TGAKernel *that, int y, float v) {
   // Check arguments
-  if (that == NULL || pos == NULL || pen == NULL) return;
-  // Declare a variable for the integer position of the 
-  // current pixel
-  VecShort *q = VecShortCreate(2);
-  if (q == NULL)
+  if (that == NULL || that->_separable == false ||
+    abs(y) > that->_radius[1])
     return;
-  VecSet(q, 0, (short)floor(VecGet(pos, 0)));
-  VecSet(q, 1, (short)floor(VecGet(pos, 1)));
-  // Get the curent pixel of the tga
-  TGAPixel *pixTga = TGALayerGetPix(that, q);
-  // If the pixel is not in read only mode
-  if (TGAPixelIsReadOnly(pixTga) == false) {
-    // Get the curent pixel of the pencil
-    TGAPixel *pixPen = TGAPencilGetPixel(pen);
-    // Get a mix of colors
-    TGAPixel *pix = TGAPixelMix(pixTga, pixPen, 1.0);
-    // Set the color of the current pixel
-    memcpy(pixTga, pix, sizeof(TGAPixel));
-    // Free the memory used by the pixel from the pencil
-    TGAPixelFree(&pixPen);
-    TGAPixelFree(&pix);
-    VecFree(&q);
-  }
+  // Set the coefficient
+  that->_coeff[2 * that->_radius[0] + 1 + y + that->_radius[1]] = v;
 }
 
-// Draw one stroke at 'pos' with 'pen' of type tgaPenShapoid
-// in layer 'that'
-// Don't do anything in case of invalid arguments
-void TGALayerStrokePixShapoid(TGALayer *that, 
-  VecFloat *pos, TGAPencil *pen) {
+// Get the coefficient at (x,y) (relative to the center) of the 
+// TGAKernel 'that' (the product of the coefficients along the rows 
+// and columns if it is separable)
+// Return 0.0 if arguments are invalid
+float TGAKernelGet(TGAKernel *that, int x, int y) {
   // Check arguments
-  if (that == NULL || pos == NULL || pen == NULL) return;
-  // Get the curent color of the pencil
-  TGAPixel *pix = TGAPencilGetPixel(pen);
-  // Declare variable for coordinates of pixel
-  VecFloat *p = VecFloatCreate(2);
-  // Declare a clone of the pen tip
-  Shapoid *penTip = ShapoidClone(pen->_tip);
-  // Declare a variable for the integer position of the 
-  // current pixel
-  VecShort *q = VecShortCreate(2);
-  // Declare a Facoid to represent the pixel
-  Shapoid *pixel = FacoidCreate(2);
-  // If we couldn't allocate memory or get the necessary information
-  if (q == NULL || p == NULL || pixel == NULL || penTip == NULL) {
-    // Free memory and stop here
-    VecFree(&p);
-    VecFree(&q);
-    ShapoidFree(&pixel);
-    ShapoidFree(&penTip);
+  if (that == NULL || 
+    abs(x) > that->_radius[0] || abs(y) > that->_radius[1])
+    return 0.0;
+  // Return the coefficient
+  if (that->_separable == true)
+    return that->_coeff[x + that->_radius[0]] * 
+      that->_coeff[2 * that->_radius[0] + 1 + y + that->_radius[1]];
+  else
+    return that->_coeff[(y + that->_radius[1]) * 
+      (2 * that->_radius[0] + 1) + x + that->_radius[0]];
+}
+
+// Set the value added to the result of the convolution by the 
+// TGAKernel 'that' to 'bias'
+// Do nothing if arguments are invalid
+void TGAKernelSetBias(TGAKernel *that, float bias) {
+  // Check arguments
+  if (that == NULL)
+    return;
+  // Set the bias
+  that->_bias = bias;
+}
+
+// Set the flag to convolve the alpha channel with the TGAKernel 'that'
+// to 'alpha' (if false the alpha channel is left unchanged)
+// Do nothing if arguments are invalid
+void TGAKernelSetAlpha(TGAKernel *that, bool alpha) {
+  // Check arguments
+  if (that == NULL)
+    return;
+  // Set the flag
+  that->_alpha = alpha;
+}
+
+// Set the flag to convolve in fixed point with the TGAKernel 'that'
+// to 'fixed'
+// The fixed point convolution is used only if the sum of the absolute
+// values of the coefficients (along each axis if the kernel is 
+// separable) is lower than TGA_KERNELFIXEDMAX, else the float one is
+// used. It is faster but rounds the coefficients to multiples of 
+// 1/2^TGA_KERNELFIXEDSHIFT (their sum being preserved)
+// Do nothing if arguments are invalid
+void TGAKernelSetFixed(TGAKernel *that, bool fixed) {
+  // Check arguments
+  if (that == NULL)
     return;
+  // Set the flag
+  that->_fixed = fixed;
+}
+
+// Create a kernel sharpening the pixels by 'strength' (the four 
+// neighbours along the rows and columns are subtracted 'strength' 
+// times from the pixel), leaving the alpha channel unchanged
+// Return NULL if arguments are invalid or we couldn't allocate memory
+TGAKernel* TGAKernelCreateSharpen(float strength) {
+  // Create the kernel
+  TGAKernel *ret = TGAKernelCreate(1, 1);
+  // If we could create the kernel
+  if (ret != NULL) {
+    // Set the coefficients
+    TGAKernelSet(ret, 0, 0, 1.0 + 4.0 * strength);
+    TGAKernelSet(ret, -1, 0, -strength);
+    TGAKernelSet(ret, 1, 0, -strength);
+    TGAKernelSet(ret, 0, -1, -strength);
+    TGAKernelSet(ret, 0, 1, -strength);
+    TGAKernelSetAlpha(ret, false);
   }
-  // Translate the clone of the pen tip to the pos
-  ShapoidTranslate(penTip, pos);
-  // Get the bounding box of the pen tip
-  Shapoid *tipBox = ShapoidGetBoundingBox(penTip);
+  // Return the new kernel
+  return ret;
+}
+
+// Create a kernel embossing the pixels, lit from the top left, 
+// centered on the grey rgb(128,128,128) and leaving the alpha channel
+// unchanged
+// Return NULL if we couldn't allocate memory
+TGAKernel* TGAKernelCreateEmboss(void) {
+  // Create the kernel
+  TGAKernel *ret = TGAKernelCreate(1, 1);
+  // If we could create the kernel
+  if (ret != NULL) {
+    // Set the coefficients (y toward top)
+    TGAKernelSet(ret, -1, 1, -1.0);
+    TGAKernelSet(ret, 0, 1, -1.0);
+    TGAKernelSet(ret, -1, 0, -1.0);
+    TGAKernelSet(ret, 1, 0, 1.0);
+    TGAKernelSet(ret, 0, -1, 1.0);
+    TGAKernelSet(ret, 1, -1, 1.0);
+    TGAKernelSetBias(ret, 128.0);
+    TGAKernelSetAlpha(ret, false);
+  }
+  // Return the new kernel
+  return ret;
+}
+
+// Create a kernel detecting the edges (laplacian over the 8 
+// neighbours), leaving the alpha channel unchanged
+// Return NULL if we couldn't allocate memory
+TGAKernel* TGAKernelCreateEdge(void) {
+  // Create the kernel
+  TGAKernel *ret = TGAKernelCreate(1, 1);
+  // If we could create the kernel
+  if (ret != NULL) {
+    // Set the coefficients
+    for (int y = -1; y <= 1; ++y)
+      for (int x = -1; x <= 1; ++x)
+        TGAKernelSet(ret, x, y, (x == 0 && y == 0 ? 8.0 : -1.0));
+    TGAKernelSetAlpha(ret, false);
+  }
+  // Return the new kernel
+  return ret;
+}
+
+// Create a separable kernel of gaussian blur of 'strength' and 
+// 'range' perimeter, as the one of TGAFilterGaussBlur but normalized
+// over the whole window (the pixels outside the layer are given by
+// the policy of the convolution)
+// Return NULL if arguments are invalid or we couldn't allocate memory
+TGAKernel* TGAKernelCreateGauss(float strength, float range) {
+  // Check arguments
+  if (strength <= 0.0)
+    return NULL;
+  // Get the radius of the kernel, as the largest distance lower than
+  // the range
+  int radius = (int)ceil(range) - 1;
+  if (radius < 0)
+    radius = 0;
+  // Create the kernel and the Gauss
+  TGAKernel *ret = TGAKernelCreateSeparable(radius, radius);
+  Gauss *gauss = GaussCreate(0.0, strength);
   // If we couldn't allocate memory
-  if (tipBox == NULL) {
+  if (ret == NULL || gauss == NULL) {
     // Free memory and stop here
-    VecFree(&p);
-    VecFree(&q);
-    ShapoidFree(&pixel);
-    ShapoidFree(&penTip);
-    return;
+    TGAKernelFree(&ret);
+    GaussFree(&gauss);
+    return NULL;
   }
-  // Get the end pos of the tip box to avoid recalculate them
-  float end[2];
-  for (int i = 2; i--;)
-    end[i] = VecGet(tipBox->_pos, i) + VecGet(tipBox->_axis[i], i);
-  // Declare a variable to memorize the step in position
-  float delta = 0.5 * pen->_thickness;
-  if (delta > 1.0) delta = 1.0;
-  // For each pixel in the area affected by the pencil
-  for (VecSet(p, 0, VecGet(tipBox->_pos, 0)); 
-    VecGet(p, 0) < end[0] + TGA_EPSILON; 
-    VecSet(p, 0, VecGet(p, 0) + delta)) {
-    for (VecSet(p, 1, VecGet(tipBox->_pos, 1)); 
-      VecGet(p, 1) < end[1] + TGA_EPSILON; 
-      VecSet(p, 1, VecGet(p, 1) + delta)) {
-      if (ShapoidIsPosInside(penTip, p) == true) {
-        // Get the integer position of the current pixel
-        for (int i = 2; i--;)
-          VecSet(q, i, (short)floor(VecGet(p, i)));
-        // Get a pointer to the current pixel
-        TGAPixel *curPix = TGALayerGetPix(that, q);
-        // If the pixel is in the tga
-        if (curPix != NULL && TGAPixelIsReadOnly(curPix) == false) {
-          // If the pen doesn't use antialias
-          if (pen->_antialias == false) {
-            // Set the value of the pixel
-            memcpy(curPix->_rgba, pix->_rgba, 
-              sizeof(unsigned char) * 4);
-          // Else, if the pencil uses antialias
-          } else {
-            // Position the pixel Facoid
-            for(int i = 2; i--;)
-              VecSet(pixel->_pos, i, floor(VecGet(p, i)));
-            // Get the ratio coverage of this pixel by the pen tip
-            float ratio = ShapoidGetCoverage(penTip, pixel);
-            // Blend the current pixel with the pixel from 
-            // the pencil
-            TGAPixel *blendPix = TGAPixelMix(curPix, pix, ratio);
-            //TGAPixel *blendPix = TGAPixelBlend(curPix, mixPix, ratio);
-            //TGAPixel *blendPix = TGAPixelBlend(curPix, pix, ratio);
-            // If the blended pixel is not null
-            if (blendPix != NULL) {
-              // Set the current pixel to the blended pixel
-              memcpy(curPix->_rgba, blendPix->_rgba, 
-                sizeof(unsigned char) * 4);
-              // Free memory used by the blended pixel
-              TGAPixelFree(&blendPix);
-            }
-            //if (ratio >= 1.0 - PBMATH_EPSILON)
-              //curPix->_readOnly = true;
-          }
-        }
-      }
-    }
+  // Set the coefficients, normalized on the whole window
+  float sum = 0.0;
+  for (int d = -radius; d <= radius; ++d)
+    sum += GaussGet(gauss, (float)d);
+  for (int d = -radius; d <= radius; ++d) {
+    TGAKernelSetX(ret, d, GaussGet(gauss, (float)d) / sum);
+    TGAKernelSetY(ret, d, GaussGet(gauss, (float)d) / sum);
   }
   // Free memory
-  TGAPixelFree(&pix);
-  VecFree(&p);
-  VecFree(&q);
-  ShapoidFree(&tipBox);
-  ShapoidFree(&pixel);
-  ShapoidFree(&penTip);
+  GaussFree(&gauss);
+  // Return the new kernel
+  return ret;
 }
 
-// Draw one stroke at 'pos' with 'pen'
-// in current layer
-// Do nothing in case of invalid arguments
-void TGAStrokePix(TGA *tga, VecFloat *pos, TGAPencil *pen) {
+// Convolve the TGA with the TGAKernel 'kernel', the pixels outside 
+// the TGA being given by the policy 'edge'
+// The TGA is convolved by bands of rows in parallel
+// Do nothing if arguments are invalid 
+void TGAFilterConvolve(TGA *tga, TGAKernel *kernel, tgaConvEdge edge) {
   // Check arguments
-  if (tga == NULL) 
+  if (tga == NULL)
     return;
-  // Stroke in current layer
-  TGALayerStrokePix(tga->_curLayer, pos, pen);
+  // Convolve the current layer
+  TGALayerFilterConvolve(tga->_curLayer, NULL, kernel, edge, 0);
 }
 
-// Draw a line between 'from' and 'to' with pencil 'pen'
-// pixels outside the TGA are ignored
-// do nothing if arguments are invalid
-void TGADrawLine(TGA *tga, VecFloat *from, VecFloat *to, 
-  TGAPencil *pen) {
-  // Create a BCurve equivalent to the line
-  BCurve *curve = BCurveCreate(1, 2);
-  BCurveSet(curve, 0, from);
-  BCurveSet(curve, 1, to);
-  // Draw a curve with control points located at anchor points
-  TGADrawCurve(tga, curve, pen);
-  // Free memory
-  BCurveFree(&curve);
-}
-  
-// Draw the BCurve 'curve' (must be of dimension 2 and order > 0)
-// do nothing if arguments are invalid
-void TGADrawBCurve(TGA *tga, BCurve *curve, TGAPencil *pen) {
+// Convolve the layer 'that' with the TGAKernel 'kernel', the pixels 
+// outside the layer being given by the policy 'edge'
+// If VecShort 'bound' is not null only pixels inside the box
+// (bound[0],bound[1])-(bound[2],bound[3]) (included) are convolved, 
+// using the pixels of the layer around the box
+// The layer is convolved by bands of rows in parallel with 
+// 'nbThread' threads (as many as processors if 'nbThread' < 1)
+// Do nothing if arguments are invalid 
+void TGALayerFilterConvolve(TGALayer *that, VecShort *bound, 
+  TGAKernel *kernel, tgaConvEdge edge, int nbThread) {
   // Check arguments
-  if (tga == NULL || curve == NULL || pen == NULL || 
-    BCurveOrder(curve) < 1)
+  if (that == NULL || kernel == NULL)
     return;
-  // Clean the working layer
-  TGALayerClean(tga->_tmpLayer);
-  // Draw the curve in the working layer
-  TGALayerAddCurve(tga->_tmpLayer, curve, pen);
-  // Get the bounding box of the curve
-  VecShort *bound = NULL;
-  Shapoid *shape = BCurveGetBoundingBox(curve);
-  if (shape != NULL) {
-    bound = VecShortCreate(4);
-    if (bound != NULL) {
-      for (int i = 2; i--;) {
-        VecSet(bound, i, VecGet(shape->_pos, i) - pen->_thickness);
-        VecSet(bound, 2 + i, VecGet(shape->_pos, i) + pen->_thickness);
+  // Get the box to convolve
+  int box[4];
+  // If the box is empty there is nothing to convolve
+  if (TGALayerGetFilterBox(that, bound, box) == false)
+    return;
+  // Declare the parameters of the filter
+  TGAConvParam param;
+  param._kernel = kernel;
+  param._edge = edge;
+  param._coeffFixed = NULL;
+  // Get the number of coefficients along the rows and columns
+  int nbX = 2 * kernel->_radius[0] + 1;
+  int nbY = 2 * kernel->_radius[1] + 1;
+  // If the kernel is in fixed point
+  if (kernel->_fixed == true) {
+    // Get the coefficients in fixed point, if they are not too large
+    // (else, the kernel is convolved in float)
+    param._coeffFixed = (short*)malloc(
+      (kernel->_separable == true ? nbX + nbY : nbX * nbY) * 
+      sizeof(short));
+    if (param._coeffFixed != NULL && 
+      TGAKernelGetFixed(kernel, param._coeffFixed) == false) {
+      free(param._coeffFixed);
+      param._coeffFixed = NULL;
+    }
+  }
+  // Declare the job, the rows and columns around the box being used
+  // up to the radius of the kernel
+  TGAFilterJob job;
+  TGAFilterJobInit(&job, that, box, 
+    (kernel->_radius[0] > kernel->_radius[1] ? 
+    kernel->_radius[0] : kernel->_radius[1]), nbThread);
+  // If the pixels outside the layer are the ones on the opposite side
+  // the convolution uses whole rows
+  if (edge == tgaConvEdgeWrap) {
+    job._cols[0] = 0;
+    job._cols[1] = VecGet(that->_dim, 0) - 1;
+  }
+  // If the pixels outside the layer are pixels of the layer, the rows
+  // near its border are copied, as far as the mirror can reach
+  if (edge != tgaConvEdgeTransparent)
+    job._nbEdgeRow = (job._halo + 1 < VecGet(that->_dim, 1) ? 
+      job._halo + 1 : VecGet(that->_dim, 1));
+  // Each worker uses a ring of nbY rows, the source rows extended by
+  // the radius if the kernel is not separable, else the rows 
+  // convolved along the rows plus one extended source row, and an 
+  // accumulator of one row
+  size_t nbVal = 4 * (size_t)(box[2] - box[0] + 1);
+  size_t nbExtVal = nbVal + 8 * (size_t)(kernel->_radius[0]);
+  job._filter = TGAFilterConvolveBand;
+  job._param = &param;
+  if (kernel->_separable == true)
+    job._scratchSize = 
+      ((size_t)nbY * nbVal + nbVal) * sizeof(float) + nbExtVal;
+  else
+    job._scratchSize = (size_t)nbY * nbExtVal + nbVal * sizeof(float);
+  // Select the row convolution kernels before the threads use them
+  TGARowConvolveSelect();
+  // Convolve the box
+  if (TGAFilterJobRun(&job) == true)
+    // Add the box to the modified area of the layer
+    TGALayerAddDirty(that, box[0], box[1], box[2], box[3]);
+  // Free memory
+  free(param._coeffFixed);
+}
+
+// Get in 'box' the box (x0,y0,x1,y1, included) 'bound' (the whole 
+// layer if NULL) of the layer 'that' clipped to its clip box
+// Return false if the box is empty
+bool TGALayerGetFilterBox(TGALayer *that, VecShort *bound, int *box) {
+  // For each coordinate of the box
+  for (int i = 4; i--;) {
+    // Get the coordinate of the clip box, or the one of the bound if
+    // it is inside
+    box[i] = VecGet(that->_clip, i);
+    if (bound != NULL && (i < 2 ? VecGet(bound, i) > box[i] : 
+      VecGet(bound, i) < box[i]))
+      box[i] = VecGet(bound, i);
+  }
+  // Return the flag for the non empty box
+  return (box[0] <= box[2] && box[1] <= box[3]);
+}
+
+// Calculate in 'radius' the radius of the 'nbPass' successive box 
+// blurs whose variance is the nearest to the one of a gaussian of 
+// standard deviation 'sigma'
+void TGAGaussGetBoxRadius(float sigma, int nbPass, int *radius) {
+  // Get the ideal width of the boxes if they were all equal, rounded
+  // down to the nearest odd width
+  double variance = 12.0 * sigma * sigma;
+  int wl = (int)floor(sqrt(variance / (double)nbPass + 1.0));
+  if (wl % 2 == 0)
+    --wl;
+  // Get the number of passes with this width such as the other ones,
+  // with the next odd width, complete the variance
+  int m = (int)round((variance - nbPass * wl * wl - 4 * nbPass * wl - 
+    3 * nbPass) / (-4.0 * wl - 4.0));
+  // Set the radius of each pass
+  for (int iPass = nbPass; iPass--;)
+    radius[iPass] = (iPass < m ? (wl - 1) / 2 : (wl + 1) / 2);
+}
+
+// Apply a box blur of 'radius' on the 'nb' samples of 'from' and 
+// memorize the result in 'to', each sample made of 'nbLane' 
+// contiguous values, separated by 'stride' values
+// 'sums' is a buffer of 'nbLane' values for the running sums
+// The samples before the first one and after the last one are 
+// considered equal to them
+void TGAFilterBox(unsigned char *from, unsigned char *to, int nb, 
+  long stride, int nbLane, int radius, unsigned int *sums) {
+  // Get the reciprocal of the width of the box in fixed point, 
+  // such as the sums can be divided by a multiplication 
+  unsigned int width = 2 * radius + 1;
+  unsigned int inv = ((1u << 16) + width / 2) / width;
+  // Initialize the sums with the window around the first sample
+  for (int l = 0; l < nbLane; ++l)
+    sums[l] = (unsigned int)(radius + 1) * from[l];
+  for (int i = 1; i <= radius; ++i) {
+    unsigned char *p = from + (long)(i < nb ? i : nb - 1) * stride;
+    for (int l = 0; l < nbLane; ++l)
+      sums[l] += p[l];
+  }
+  // For each sample
+  for (int i = 0; i < nb; ++i) {
+    // Memorize the average of the window
+    unsigned char *q = to + (long)i * stride;
+    for (int l = 0; l < nbLane; ++l)
+      q[l] = (unsigned char)((sums[l] * inv + (1u << 15)) >> 16);
+    // Slide the window to the next sample
+    unsigned char *pIn = from + 
+      (long)(i + radius + 1 < nb ? i + radius + 1 : nb - 1) * stride;
+    unsigned char *pOut = from + 
+      (long)(i - radius > 0 ? i - radius : 0) * stride;
+    for (int l = 0; l < nbLane; ++l)
+      sums[l] += pIn[l] - pOut[l];
+  }
+}
+
+// Initialize the TGAFilterJob 'that' to filter the box 'box' (x0,y0,
+// x1,y1, included, inside the layer) of the layer 'layer' with a
+// filter using the pixels at a distance up to 'halo' from the 
+// filtered ones, with 'nbThread' threads (as many as processors if 
+// 'nbThread' < 1)
+// The filter, its parameters and the size of its memory per worker 
+// must be set before running the job
+void TGAFilterJobInit(TGAFilterJob *that, TGALayer *layer, int *box, 
+  int halo, int nbThread) {
+  // Set the layer, box and halo
+  that->_layer = layer;
+  memcpy(that->_box, box, 4 * sizeof(int));
+  that->_halo = halo;
+  // Get the columns of the box extended by the halo inside the layer
+  that->_cols[0] = (box[0] > halo ? box[0] - halo : 0);
+  that->_cols[1] = (box[2] + halo < VecGet(layer->_dim, 0) - 1 ? 
+    box[2] + halo : VecGet(layer->_dim, 0) - 1);
+  // Get the number of threads, as many as processors by default
+  that->_nbThread = (nbThread < 1 ? 
+    (int)sysconf(_SC_NPROCESSORS_ONLN) : nbThread);
+  if (that->_nbThread < 1)
+    that->_nbThread = 1;
+  // Get the bands, a few per thread within the limits, and high 
+  // enough for the copies of the rows around their limits and the 
+  // rows filtered twice because of the halo to stay small compared to 
+  // the box
+  int nbRow = box[3] - box[1] + 1;
+  int nbBand = that->_nbThread * TGA_FILTERNBBANDPERTHREAD;
+  that->_bandHeight = (nbRow + nbBand - 1) / nbBand;
+  if (that->_bandHeight < TGA_FILTERBANDMIN)
+    that->_bandHeight = TGA_FILTERBANDMIN;
+  if (that->_bandHeight > TGA_FILTERBANDMAX)
+    that->_bandHeight = TGA_FILTERBANDMAX;
+  if (that->_bandHeight < 4 * halo)
+    that->_bandHeight = 4 * halo;
+  that->_nbBand = (nbRow + that->_bandHeight - 1) / that->_bandHeight;
+  that->_haloRows = NULL;
+  that->_nbEdgeRow = 0;
+  that->_edgeRows = NULL;
+  // Initialize the filter
+  that->_filter = NULL;
+  that->_param = NULL;
+  that->_scratchSize = 0;
+  atomic_init(&(that->_iNextBand), 0);
+}
+
+// Run the TGAFilterJob 'that' with its threads (no more than bands)
+// Return false if we couldn't allocate memory, in which case the 
+// layer is unchanged
+bool TGAFilterJobRun(TGAFilterJob *that) {
+  // Get the number of workers, one per thread and no more than bands
+  int nbThread = (that->_nbThread < that->_nbBand ? 
+    that->_nbThread : that->_nbBand);
+  // Allocate memory for the copies of the rows around the limits 
+  // between bands, the workers and their memory
+  int nbCol = that->_cols[1] - that->_cols[0] + 1;
+  long nbHaloRow = (long)(that->_nbBand - 1) * 2 * that->_halo;
+  if (nbHaloRow > 0)
+    that->_haloRows = 
+      (TGAPixel*)malloc(nbHaloRow * nbCol * sizeof(TGAPixel));
+  if (that->_nbEdgeRow > 0)
+    that->_edgeRows = (TGAPixel*)malloc(
+      2 * (long)(that->_nbEdgeRow) * nbCol * sizeof(TGAPixel));
+  TGAFilterWorker *workers = 
+    (TGAFilterWorker*)calloc(nbThread, sizeof(TGAFilterWorker));
+  pthread_t *threads = (pthread_t*)malloc(nbThread * sizeof(pthread_t));
+  bool ok = ((nbHaloRow == 0 || that->_haloRows != NULL) && 
+    (that->_nbEdgeRow == 0 || that->_edgeRows != NULL) &&
+    workers != NULL && threads != NULL);
+  for (int iThread = 0; iThread < nbThread && ok == true; ++iThread) {
+    workers[iThread]._job = that;
+    workers[iThread]._scratch = malloc(that->_scratchSize);
+    ok = (workers[iThread]._scratch != NULL);
+  }
+  // If we could allocate memory
+  if (ok == true) {
+    // Copy the rows of the box around the limits between bands before
+    // they are modified
+    int w = VecGet(that->_layer->_dim, 0);
+    for (int iLimit = 0; iLimit < that->_nbBand - 1; ++iLimit) {
+      int yLimit = that->_box[1] + (iLimit + 1) * that->_bandHeight;
+      for (int iRow = 0; iRow < 2 * that->_halo && 
+        yLimit - that->_halo + iRow <= that->_box[3]; ++iRow)
+        memcpy(that->_haloRows + 
+          ((long)iLimit * 2 * that->_halo + iRow) * nbCol, 
+          that->_layer->_pixels + 
+          (long)(yLimit - that->_halo + iRow) * w + that->_cols[0],
+          nbCol * sizeof(TGAPixel));
+    }
+    // Copy the rows at the top and bottom of the layer before they
+    // are modified
+    int h = VecGet(that->_layer->_dim, 1);
+    for (int iRow = 0; iRow < that->_nbEdgeRow; ++iRow) {
+      memcpy(that->_edgeRows + (long)iRow * nbCol, 
+        that->_layer->_pixels + (long)iRow * w + that->_cols[0],
+        nbCol * sizeof(TGAPixel));
+      memcpy(that->_edgeRows + (long)(that->_nbEdgeRow + iRow) * nbCol, 
+        that->_layer->_pixels + 
+        (long)(h - that->_nbEdgeRow + iRow) * w + that->_cols[0],
+        nbCol * sizeof(TGAPixel));
+    }
+    // Start the workers, the last one in the calling thread; the 
+    // bands are shared dynamically, so if a thread couldn't be 
+    // started the other workers filter its bands
+    for (int iThread = 0; iThread < nbThread - 1; ++iThread)
+      workers[iThread]._started = (pthread_create(threads + iThread, 
+        NULL, TGAFilterWorkerRun, workers + iThread) == 0);
+    TGAFilterWorkerRun(workers + nbThread - 1);
+    // Wait for the other workers
+    for (int iThread = 0; iThread < nbThread - 1; ++iThread)
+      if (workers[iThread]._started == true)
+        pthread_join(threads[iThread], NULL);
+  }
+  // Free memory
+  for (int iThread = 0; workers != NULL && iThread < nbThread; 
+    ++iThread)
+    free(workers[iThread]._scratch);
+  free(workers);
+  free(threads);
+  free(that->_haloRows);
+  that->_haloRows = NULL;
+  free(that->_edgeRows);
+  that->_edgeRows = NULL;
+  // Return the success
+  return ok;
+}
+
+// Get in 'y0' and 'y1' the first and last rows of the 'iBand'-th band
+// of the TGAFilterJob 'that'
+void TGAFilterJobGetBand(TGAFilterJob *that, int iBand, int *y0, 
+  int *y1) {
+  *y0 = that->_box[1] + iBand * that->_bandHeight;
+  *y1 = *y0 + that->_bandHeight - 1;
+  if (*y1 > that->_box[3])
+    *y1 = that->_box[3];
+}
+
+// Get the row 'y' of the layer of the TGAFilterJob 'that', as it was
+// before filtering, for the 'iBand'-th band. The row must be at a 
+// distance up to the halo of the band
+// Return a pointer to its pixel in the first column of _cols, or NULL
+// if the row is outside the layer
+// The rows of the band are the ones of the layer, so the filter must
+// get them before modifying them
+TGAPixel* TGAFilterJobGetRow(TGAFilterJob *that, int iBand, int y) {
+  // If the row is outside the layer
+  if (y < 0 || y >= VecGet(that->_layer->_dim, 1))
+    return NULL;
+  // Get the rows of the band
+  int y0, y1;
+  TGAFilterJobGetBand(that, iBand, &y0, &y1);
+  int nbCol = that->_cols[1] - that->_cols[0] + 1;
+  // If the row is in the previous band, it may have been filtered
+  // already, return its copy
+  if (y < y0 && y >= that->_box[1])
+    return that->_haloRows + 
+      ((long)(iBand - 1) * 2 * that->_halo + y - y0 + that->_halo) * 
+      nbCol;
+  // If the row is in the next band, it may have been filtered
+  // already, return its copy
+  if (y > y1 && y <= that->_box[3])
+    return that->_haloRows + 
+      ((long)iBand * 2 * that->_halo + y - y1 - 1 + that->_halo) * 
+      nbCol;
+  // Else, the row is not modified by other bands
+  return that->_layer->_pixels + 
+    (long)y * VecGet(that->_layer->_dim, 0) + that->_cols[0];
+}
+
+// Get the copy of the row 'y' of the layer of the TGAFilterJob 'that'
+// taken before filtering, 'y' being one of the _nbEdgeRow rows at 
+// the top or bottom of the layer
+// Return a pointer to its pixel in the first column of _cols
+TGAPixel* TGAFilterJobGetEdgeRow(TGAFilterJob *that, int y) {
+  // Get the number of columns of the copies
+  int nbCol = that->_cols[1] - that->_cols[0] + 1;
+  // If the row is at the top of the layer
+  if (y < that->_nbEdgeRow)
+    return that->_edgeRows + (long)y * nbCol;
+  // Else, the row is at the bottom of the layer
+  return that->_edgeRows + (long)(that->_nbEdgeRow + y - 
+    VecGet(that->_layer->_dim, 1) + that->_nbEdgeRow) * nbCol;
+}
+
+// Filter the bands of the job of the TGAFilterWorker 'arg' until 
+// there is no more band to filter
+// Return NULL (for pthread_create)
+void* TGAFilterWorkerRun(void *arg) {
+  // Get the worker and its job
+  TGAFilterWorker *that = (TGAFilterWorker*)arg;
+  TGAFilterJob *job = that->_job;
+  // While there are bands to filter, take the next one and filter it
+  int iBand;
+  while ((iBand = atomic_fetch_add(&(job->_iNextBand), 1)) < 
+    job->_nbBand)
+    job->_filter(job, iBand, that->_scratch);
+  // Return NULL
+  return NULL;
+}
+
+// Filter of TGAFilterJob blurring the 'iBand'-th band of 'job' with 
+// the separable normalized kernel in its parameters (values for 
+// distances 0 to its halo), renormalized where the window is cut by
+// the border of the layer
+// 'scratch' holds a ring of (2 * halo + 1) rows blurred along the 
+// rows followed by the accumulator of one row
+void TGAFilterGaussBand(TGAFilterJob *job, int iBand, void *scratch) {
+  // Get the kernel and the dimensions of the layer
+  float *kernel = (float*)(job->_param);
+  int radius = job->_halo;
+  int w = VecGet(job->_layer->_dim, 0);
+  int h = VecGet(job->_layer->_dim, 1);
+  // Get the ring of rows and the accumulator in the memory
+  int nbVal = 4 * (job->_box[2] - job->_box[0] + 1);
+  int nbRing = 2 * radius + 1;
+  float *ring = (float*)scratch;
+  float *acc = ring + (long)nbRing * nbVal;
+  // Get the rows of the band, and the columns of the box relative to
+  // the first column of the rows given by the job
+  int y0, y1;
+  TGAFilterJobGetBand(job, iBand, &y0, &y1);
+  int x0 = job->_box[0] - job->_cols[0];
+  int x1 = job->_box[2] - job->_cols[0];
+  // Declare the index of the next row to blur along the row
+  int yNext = (y0 > radius ? y0 - radius : 0);
+  // For each row of the band
+  for (int y = y0; y <= y1; ++y) {
+    // Blur along the row the rows used by the current one
+    for (; yNext <= y + radius && yNext < h; ++yNext) {
+      TGAPixel *row = TGAFilterJobGetRow(job, iBand, yNext);
+      float *out = ring + (long)(yNext % nbRing) * nbVal;
+      // For each pixel of the box in the row
+      for (int x = x0; x <= x1; ++x) {
+        // Get the window of pixels inside the layer
+        int from = (x + job->_cols[0] > radius ? 
+          -radius : -x - job->_cols[0]);
+        int to = (x + job->_cols[0] < w - radius ? 
+          radius : w - 1 - x - job->_cols[0]);
+        // Accumulate the weighted values of the four channels
+        float p[4] = {0.0, 0.0, 0.0, 0.0};
+        float weight = 0.0;
+        for (int d = from; d <= to; ++d) {
+          float g = kernel[(d < 0 ? -d : d)];
+          unsigned char *rgba = row[x + d]._rgba;
+          for (int irgb = 4; irgb--;)
+            p[irgb] += g * (float)(rgba[irgb]);
+          weight += g;
+        }
+        // Memorize the blurred values, renormalized if the window is
+        // cut by the border of the layer
+        for (int irgb = 4; irgb--;)
+          out[4 * (x - x0) + irgb] = p[irgb] / weight;
       }
-      for (int i = 2; i--;)
-        VecSet(bound, 2 + i, 
-          VecGet(bound, 2 + i) + VecGet(shape->_axis[i], i));
     }
+    // Get the window of rows inside the layer
+    int from = (y > radius ? -radius : -y);
+    int to = (y < h - radius ? radius : h - 1 - y);
+    // Accumulate the weighted rows blurred along the rows
+    for (int i = nbVal; i--;)
+      acc[i] = 0.0;
+    float weight = 0.0;
+    for (int d = from; d <= to; ++d) {
+      float g = kernel[(d < 0 ? -d : d)];
+      float *in = ring + (long)((y + d) % nbRing) * nbVal;
+      for (int i = 0; i < nbVal; ++i)
+        acc[i] += g * in[i];
+      weight += g;
+    }
+    // Copy the blurred values, renormalized if the window is cut
+    // by the border of the layer, in the pixels of the row
+    unsigned char *rgba = 
+      (unsigned char*)(job->_layer->_pixels + (long)y * w + job->_box[0]);
+    for (int i = 0; i < nbVal; ++i)
+      rgba[i] = (unsigned char)round(acc[i] / weight);
+  }
+}
+
+// Filter of TGAFilterJob blurring the 'iBand'-th band of 'job' with 
+// the TGA_GAUSSBOXNBPASS successive box blurs whose radius are in its
+// parameters, the pixels outside the layer being equal to the nearest
+// pixel on its border
+// 'scratch' holds two copies of the band extended by the halo 
+// followed by the running sums of one row
+// The rows and columns of the extension are blurred with a wrong
+// border but the error moves inward by the radius of the box at each 
+// pass, hence it doesn't reach the band
+void TGAFilterBoxBand(TGAFilterJob *job, int iBand, void *scratch) {
+  // Get the radius of the boxes and the dimensions of the layer
+  int *radius = (int*)(job->_param);
+  int w = VecGet(job->_layer->_dim, 0);
+  int h = VecGet(job->_layer->_dim, 1);
+  // Get the rows of the band, and the ones extended by the halo 
+  // inside the layer
+  int y0, y1;
+  TGAFilterJobGetBand(job, iBand, &y0, &y1);
+  int s0 = (y0 > job->_halo ? y0 - job->_halo : 0);
+  int s1 = (y1 + job->_halo < h - 1 ? y1 + job->_halo : h - 1);
+  int nbRow = s1 - s0 + 1;
+  int nbCol = job->_cols[1] - job->_cols[0] + 1;
+  long nbVal = 4 * (long)nbCol;
+  // Get the copies of the band and the running sums in the memory
+  unsigned char *a = (unsigned char*)scratch;
+  unsigned char *b = a + nbRow * nbVal;
+  unsigned int *sums = (unsigned int*)(b + nbRow * nbVal);
+  // Copy the extended band
+  for (int y = s0; y <= s1; ++y)
+    memcpy(a + (y - s0) * nbVal, TGAFilterJobGetRow(job, iBand, y), 
+      nbVal);
+  // For each pass
+  for (int iPass = 0; iPass < TGA_GAUSSBOXNBPASS; ++iPass) {
+    // If the box is reduced to one pixel, skip the pass
+    if (radius[iPass] == 0)
+      continue;
+    // Blur each row in the second copy, the four channels of a pixel
+    // together
+    for (int iRow = 0; iRow < nbRow; ++iRow)
+      TGAFilterBox(a + iRow * nbVal, b + iRow * nbVal, nbCol, 4, 4, 
+        radius[iPass], sums);
+    // Blur the columns back in the first copy, all the values of a 
+    // row together
+    TGAFilterBox(b, a, nbRow, nbVal, nbVal, radius[iPass], sums);
+  }
+  // Copy the blurred pixels of the box in the band in the layer
+  for (int y = y0; y <= y1; ++y)
+    memcpy(job->_layer->_pixels + (long)y * w + job->_box[0], 
+      a + (y - s0) * nbVal + 4 * (job->_box[0] - job->_cols[0]), 
+      4 * (job->_box[2] - job->_box[0] + 1));
+}
+
+// Get in 'coeff' the coefficients of the TGAKernel 'that' in fixed
+// point with TGA_KERNELFIXEDSHIFT bits of fraction, the rounding 
+// error of their sum (along each axis if the kernel is separable) 
+// being given to the largest one so that the sum is preserved
+// Return false if the sum of the absolute values of the coefficients 
+// is not lower than TGA_KERNELFIXEDMAX
+bool TGAKernelGetFixed(TGAKernel *that, short *coeff) {
+  // Get the number of coefficients along the rows and columns
+  int nbX = 2 * that->_radius[0] + 1;
+  int nbY = 2 * that->_radius[1] + 1;
+  // Get the groups of coefficients to convert, one per axis if the
+  // kernel is separable
+  int nbGroup = (that->_separable == true ? 2 : 1);
+  int group[2][2] = {{0, nbX}, {nbX, nbY}};
+  if (that->_separable == false)
+    group[0][1] = nbX * nbY;
+  // For each group of coefficients
+  for (int iGroup = 0; iGroup < nbGroup; ++iGroup) {
+    float *c = that->_coeff + group[iGroup][0];
+    short *q = coeff + group[iGroup][0];
+    int nb = group[iGroup][1];
+    // Round the coefficients and get the largest one
+    float sum = 0.0;
+    float sumAbs = 0.0;
+    int sumQ = 0;
+    int iMax = 0;
+    for (int i = 0; i < nb; ++i) {
+      q[i] = (short)round(c[i] * (float)(1 << TGA_KERNELFIXEDSHIFT));
+      sum += c[i];
+      sumAbs += fabs(c[i]);
+      sumQ += q[i];
+      if (fabs(c[i]) > fabs(c[iMax]))
+        iMax = i;
+    }
+    // If the coefficients are too large
+    if (sumAbs >= TGA_KERNELFIXEDMAX)
+      return false;
+    // Correct the largest coefficient to preserve the sum
+    q[iMax] += 
+      (int)round(sum * (float)(1 << TGA_KERNELFIXEDSHIFT)) - sumQ;
+  }
+  // Return the success
+  return true;
+}
+
+// Get the position of 'x' (outside [0,n-1]) in [0,n-1] according to 
+// the policy 'edge'
+// Return -1 if the position is transparent
+int TGAConvGetEdgePos(int x, int n, tgaConvEdge edge) {
+  // If the position is inside there is nothing to do
+  if (x >= 0 && x < n)
+    return x;
+  switch (edge) {
+    case tgaConvEdgeClamp:
+      return (x < 0 ? 0 : n - 1);
+    case tgaConvEdgeWrap:
+      return ((x % n) + n) % n;
+    case tgaConvEdgeMirror: {
+      // The positions are periodic of period 2n-2, and symmetric
+      // relatively to 0 and n-1
+      if (n == 1)
+        return 0;
+      int p = 2 * n - 2;
+      x = ((x % p) + p) % p;
+      return (x < n ? x : p - x);
+    }
+    default:
+      return -1;
   }
-  // Blend the working layer in the current layer
-  TGALayerBlend(tga->_curLayer, tga->_tmpLayer, bound);
-  // Free memory
-  VecFree(&bound);
-  ShapoidFree(&shape);
 }
 
-// Draw the SCurve 'curve' (must be of dimension 2)
-// do nothing if arguments are invalid
-void TGADrawSCurve(TGA *tga, SCurve *curve, TGAPencil *pen) {
-  // Check arguments
-  if (tga == NULL || curve == NULL || pen == NULL)
+// Get in 'ext' the pixels of the row 'y' of the layer of the 
+// TGAFilterJob 'job' for the 'iBand'-th band, from the first column
+// of the box minus 'radius' to the last column of the box plus 
+// 'radius', the pixels outside the layer being given by the policy
+// 'edge'
+// 'y' must be at a distance up to the halo of the band, and if it is
+// outside the layer the job must have copies of the rows near the 
+// border of the layer for the policy
+void TGAFilterJobGetConvRow(TGAFilterJob *job, int iBand, int y, 
+  tgaConvEdge edge, int radius, unsigned char *ext) {
+  // Get the dimensions of the layer
+  int w = VecGet(job->_layer->_dim, 0);
+  int h = VecGet(job->_layer->_dim, 1);
+  // Get the columns of the extended row, and the ones inside the 
+  // layer
+  int xFrom = job->_box[0] - radius;
+  int xTo = job->_box[2] + radius;
+  int inFrom = (xFrom > 0 ? xFrom : 0);
+  int inTo = (xTo < w - 1 ? xTo : w - 1);
+  // Get the row, from the copies of the rows near the border if it
+  // is outside the layer
+  TGAPixel *row = NULL;
+  if (y >= 0 && y < h) {
+    row = TGAFilterJobGetRow(job, iBand, y);
+  } else {
+    y = TGAConvGetEdgePos(y, h, edge);
+    if (y >= 0)
+      row = TGAFilterJobGetEdgeRow(job, y);
+  }
+  // If the row is transparent
+  if (row == NULL) {
+    // Set the pixels to rgba(0,0,0,0) and stop here
+    memset(ext, 0, 4 * (size_t)(xTo - xFrom + 1));
     return;
-  // Clean the working layer
-  TGALayerClean(tga->_tmpLayer);
-  // Declare a pointer to loop on BCurves of the SCurve
-  GSetElem *ptr = curve->_curves->_head;
-  while (ptr != NULL) {
-    // Draw the curve in the working layer
-    TGALayerAddCurve(tga->_tmpLayer, (BCurve*)(ptr->_data), pen);
-    // Move to the next curve
-    ptr = ptr->_next;
   }
-  // Get the bounding box of the curve
-  VecShort *bound = NULL;
-  Shapoid *shape = SCurveGetBoundingBox(curve);
-  if (shape != NULL) {
-    bound = VecShortCreate(4);
-    if (bound != NULL) {
-      for (int i = 2; i--;) {
-        VecSet(bound, i, VecGet(shape->_pos, i) - pen->_thickness);
-        VecSet(bound, 2 + i, VecGet(shape->_pos, i) + pen->_thickness);
+  // Copy the pixels inside the layer
+  memcpy(ext + 4 * (inFrom - xFrom), row + inFrom - job->_cols[0],
+    4 * (size_t)(inTo - inFrom + 1));
+  // Set the pixels outside the layer
+  for (int x = xFrom; x <= xTo; x = (x == inFrom - 1 ? inTo + 1 : x + 1)) {
+    if (x >= inFrom && x <= inTo)
+      continue;
+    int pos = TGAConvGetEdgePos(x, w, edge);
+    if (pos < 0)
+      memset(ext + 4 * (x - xFrom), 0, 4);
+    else
+      memcpy(ext + 4 * (x - xFrom), row + pos - job->_cols[0], 4);
+  }
+}
+
+// Filter of TGAFilterJob convolving the 'iBand'-th band of 'job' with
+// the TGAConvParam in its parameters
+// 'scratch' holds a ring of rows (source rows extended by the radius 
+// of the kernel if it is not separable, else rows convolved along the
+// rows followed by one extended source row) and the accumulator of 
+// one row
+void TGAFilterConvolveBand(TGAFilterJob *job, int iBand, void *scratch) {
+  // Get the parameters and the kernel
+  TGAConvParam *param = (TGAConvParam*)(job->_param);
+  TGAKernel *kernel = param->_kernel;
+  bool fixed = (param->_coeffFixed != NULL);
+  int rx = kernel->_radius[0];
+  int ry = kernel->_radius[1];
+  int nbX = 2 * rx + 1;
+  int nbY = 2 * ry + 1;
+  // Get the number of pixels and values of the rows of the box, and 
+  // of the extended rows
+  long nbPix = job->_box[2] - job->_box[0] + 1;
+  long nbVal = 4 * nbPix;
+  long nbExtVal = 4 * (nbPix + 2 * rx);
+  // Get the ring of rows, the extended row and the accumulator in the
+  // memory
+  long ringRowSize = (kernel->_separable == true ? 
+    nbVal * (long)sizeof(float) : nbExtVal);
+  unsigned char *ring = (unsigned char*)scratch;
+  unsigned char *ext = ring + nbY * ringRowSize;
+  float *acc = (float*)(ext + 
+    (kernel->_separable == true ? nbExtVal : 0));
+  int *accFixed = (int*)acc;
+  // Get the number of bits of fraction of the accumulated values in 
+  // fixed point, and the bias in float and fixed point
+  int shift = TGA_KERNELFIXEDSHIFT + 
+    (kernel->_separable == true ? TGA_KERNELFIXEDINTER : 0);
+  int biasFixed = (int)round(kernel->_bias * (float)(1 << shift)) + 
+    (1 << (shift - 1));
+  // Get the number of channels to convolve
+  int nbChannel = (kernel->_alpha == true ? 4 : 3);
+  // Get the rows of the band
+  int y0, y1;
+  TGAFilterJobGetBand(job, iBand, &y0, &y1);
+  // Declare the index of the next row to put in the ring
+  int yNext = y0 - ry;
+  // For each row of the band
+  for (int y = y0; y <= y1; ++y) {
+    // Put in the ring the rows used by the current one
+    for (; yNext <= y + ry; ++yNext) {
+      unsigned char *slot = ring + 
+        (long)((yNext - y0 + ry) % nbY) * ringRowSize;
+      // If the kernel is not separable
+      if (kernel->_separable == false) {
+        // Put the extended row
+        TGAFilterJobGetConvRow(job, iBand, yNext, param->_edge, rx, 
+          slot);
+      // Else, the kernel is separable
+      } else {
+        // Put the extended row convolved along the row
+        TGAFilterJobGetConvRow(job, iBand, yNext, param->_edge, rx, 
+          ext);
+        memset(slot, 0, nbVal * sizeof(float));
+        if (fixed == true) {
+          int *conv = (int*)slot;
+          TGARowConvolveFixed(conv, ext, param->_coeffFixed, nbX, nbPix);
+          // Keep TGA_KERNELFIXEDINTER bits of fraction for the 
+          // convolution along the column
+          for (long i = 0; i < nbVal; ++i)
+            conv[i] = (conv[i] + (1 << (TGA_KERNELFIXEDSHIFT - 
+              TGA_KERNELFIXEDINTER - 1))) >> 
+              (TGA_KERNELFIXEDSHIFT - TGA_KERNELFIXEDINTER);
+        } else {
+          TGARowConvolve((float*)slot, ext, kernel->_coeff, nbX, nbPix);
+        }
+      }
+    }
+    // Accumulate the rows of the ring weighted by the coefficients
+    memset(acc, 0, nbVal * sizeof(float));
+    for (int dy = -ry; dy <= ry; ++dy) {
+      unsigned char *slot = ring + 
+        (long)((y + dy - y0 + ry) % nbY) * ringRowSize;
+      // Get the index of the coefficients for this row
+      int iY = dy + ry;
+      if (kernel->_separable == false) {
+        if (fixed == true)
+          TGARowConvolveFixed(accFixed, slot, 
+            param->_coeffFixed + iY * nbX, nbX, nbPix);
+        else
+          TGARowConvolve(acc, slot, kernel->_coeff + iY * nbX, nbX, 
+            nbPix);
+      } else {
+        if (fixed == true) {
+          int c = param->_coeffFixed[nbX + iY];
+          int *conv = (int*)slot;
+          for (long i = 0; i < nbVal; ++i)
+            accFixed[i] += c * conv[i];
+        } else {
+          float c = kernel->_coeff[nbX + iY];
+          float *conv = (float*)slot;
+          for (long i = 0; i < nbVal; ++i)
+            acc[i] += c * conv[i];
+        }
+      }
+    }
+    // Copy the convolved values, with the bias and clipped to
+    // [0,255], in the pixels of the row
+    unsigned char *rgba = (unsigned char*)(job->_layer->_pixels + 
+      (long)y * VecGet(job->_layer->_dim, 0) + job->_box[0]);
+    for (long i = 0; i < nbVal; i += 4) {
+      for (int c = 0; c < nbChannel; ++c) {
+        float v = (fixed == true ? 
+          (float)((accFixed[i + c] + biasFixed) >> shift) :
+          round(acc[i + c] + kernel->_bias));
+        rgba[i + c] = (unsigned char)(v < 0.0 ? 0.0 : 
+          (v > 255.0 ? 255.0 : v));
       }
-      for (int i = 2; i--;)
-        VecSet(bound, 2 + i, 
-          VecGet(bound, 2 + i) + VecGet(shape->_axis[i], i));
     }
   }
-  // Blend the working layer in the current layer
-  TGALayerBlend(tga->_curLayer, tga->_tmpLayer, bound);
+}
+
+// Print the string 's' with its anchor position at 'pos', TGAPencil 
+// 'pen' and font 'font'
+void TGAPrintString(TGA *tga, TGAPencil *pen, TGAFont *font, 
+  unsigned char *s, VecFloat *pos) {
+  // Check arguments
+  if (tga == NULL || pen == NULL || font == NULL || s == NULL ||
+    pos == NULL)
+    return;
+  // Record the string in a draw list
+  TGADrawList *list = TGADrawListCreate();
+  TGADrawListPrintString(list, pen, font, s, pos);
+  // Draw the list
+  TGAExecDrawList(tga, list);
   // Free memory
-  VecFree(&bound);
-  ShapoidFree(&shape);
+  TGADrawListFree(&list);
 }
-  
-// Draw a rectangle between 'from' and 'to' with pencil 'pen'
-// pixels outside the TGA are ignored
-// do nothing if arguments are invalid
-void TGADrawRect(TGA *tga, VecFloat *from, VecFloat *to, 
-  TGAPencil *pen) {
+
+// Print the char 'c' with its (bottom, left) position at 'pos'
+// and (width, height) dimension 'dim' with font 'font'
+void TGAPrintChar(TGA *tga, TGAPencil *pen, TGAFont *font, 
+  unsigned char c, VecFloat *pos) {
   // Check arguments
-  if (tga == NULL || from == NULL || to == NULL || pen == NULL)
+  if (tga == NULL || pen == NULL || font == NULL || pos == NULL)
     return;
-  // Create the Facoid equivalent to the rectangle
-  Shapoid *facoid = FacoidCreate(2);
-  if (facoid != NULL) {
-    ShapoidSetPos(facoid, from);
-    VecFloat *s = VecGetOp(to, 1.0, from, -1.0);
-    ShapoidScale(facoid, s);
-    VecFree(&s);
-    // Draw the Facoid
-    TGADrawShapoid(tga, facoid, pen);
+  // Get the curve of the character at its position
+  SCurve *curve = TGAFontGetCharCurve(font, c, pos);
+  // If we could get the curve
+  if (curve != NULL) {
+    // Draw the curve
+    TGADrawSCurve(tga, curve, pen);
     // Free memory
-    ShapoidFree(&facoid);
+    SCurveFree(&curve);
   }
 }
 
-// Fill a rectangle between 'from' and 'to' with pencil 'pen'
-// pixels outside the TGA are ignored
-// do nothing if arguments are invalid
-void TGAFillRect(TGA *tga, VecFloat *from, VecFloat *to, 
-  TGAPencil *pen) {
+// Get the SCurve of the char 'c' of the font 'font' with its 
+// (bottom, left) position at 'pos'
+// Return NULL if we couldn't allocate memory
+SCurve* TGAFontGetCharCurve(TGAFont *font, unsigned char c, 
+  VecFloat *pos) {
+  // Declare a vecfloat to scale the curve
+  VecFloat *scale = VecGetOp(font->_scale, font->_size, NULL, 0.0);
+  if (scale == NULL)
+    return NULL;
+  // Set a pointer to the requested character's definition
+  TGAChar *ch = font->_char + c;
+  // Declare a variable to memorize the angle between the abciss
+  // and the right direction of the font
+  float theta = TGAFontGetAngleWithAbciss(font);
+  // Clone the curve
+  SCurve *clone = SCurveClone(ch->_curve);
+  // If we could clone the curve
+  if (clone != NULL) {
+    // Scale the curve
+    SCurveScale(clone, scale);
+    // Rotate the curve
+    SCurveRot2D(clone, theta);
+    // Translate the curve
+    SCurveTranslate(clone, pos);
+  }
+  // Free memory
+  VecFree(&scale);
+  // Return the curve
+  return clone;
+}
+
+// Create the Facoid equivalent to the rectangle between 'from' and
+// 'to'
+// Return NULL if arguments are invalid or we couldn't allocate memory
+Shapoid* TGAShapoidCreateRect(VecFloat *from, VecFloat *to) {
   // Check arguments
-  if (tga == NULL || from == NULL || to == NULL || pen == NULL)
-    return;
-  // Create the Facoid equivalent to the rectangle
+  if (from == NULL || to == NULL)
+    return NULL;
+  // Create the Facoid
   Shapoid *facoid = FacoidCreate(2);
   if (facoid != NULL) {
     ShapoidSetPos(facoid, from);
     VecFloat *s = VecGetOp(to, 1.0, from, -1.0);
     ShapoidScale(facoid, s);
     VecFree(&s);
-    // Draw the Facoid
-    TGAFillShapoid(tga, facoid, pen);
-    // Free memory
-    ShapoidFree(&facoid);
   }
+  // Return the Facoid
+  return facoid;
 }
 
-// Draw a ellipse at 'center' of radius 'r' (Rx,Ry) 
-// with pencil 'pen' 
-// pixels outside the TGA are ignored
-// do nothing if arguments are invalid
-void TGADrawEllipse(TGA *tga, VecFloat *center, VecFloat *r, 
-  TGAPencil *pen) {
+// Create the Spheroid equivalent to the ellipse at 'center' of radius
+// 'r' (Rx,Ry)
+// Return NULL if arguments are invalid or we couldn't allocate memory
+Shapoid* TGAShapoidCreateEllipse(VecFloat *center, VecFloat *r) {
   // Check arguments
-  if (tga == NULL || center == NULL || r == NULL || pen == NULL ||
+  if (center == NULL || r == NULL || 
     VecGet(r, 0) <= 0.0 || VecGet(r, 1) <= 0.0)
-    return;
-  // Create the Spheroid equivalent to the ellipse
+    return NULL;
+  // Create the Spheroid
   Shapoid *spheroid = SpheroidCreate(2);
   if (spheroid != NULL) {
     ShapoidSetPos(spheroid, center);
     // Declare a variable to memorize the diameter of the ellipse
     VecFloat *diameter = VecGetOp(r, 2.0, NULL, 0.0);
-    if (diameter != NULL) {
-      // Scale the Spheroid
-      ShapoidScale(spheroid, diameter);
-      VecFree(&diameter);
-      // Draw the Spheroid
-      TGADrawShapoid(tga, spheroid, pen);
+    // If we couldn't allocate memory
+    if (diameter == NULL) {
+      // Free memory and stop here
+      ShapoidFree(&spheroid);
+      return NULL;
     }
-    // Free memory
-    ShapoidFree(&spheroid);
+    // Scale the Spheroid
+    ShapoidScale(spheroid, diameter);
+    VecFree(&diameter);
   }
+  // Return the Spheroid
+  return spheroid;
 }
 
-// Fill an ellipse at 'center' of radius 'r' (Rx, Ry) with pencil 'pen'
-// pixels outside the TGA are ignored
-// do nothing if arguments are invalid
-void TGAFillEllipse(TGA *tga, VecFloat *center, VecFloat *r, 
-  TGAPencil *pen) {
-  // Check arguments
-  if (tga == NULL || center == NULL || r == NULL || pen == NULL ||
-    VecGet(r, 0) <= 0.0 || VecGet(r, 1) <= 0.0)
-    return;
-  // Create the Spheroid
-  Shapoid *spheroid = SpheroidCreate(2);
-  if (spheroid != NULL) {
-    ShapoidSetPos(spheroid, center);
-    // Declare a variable to memorize the diameter of the ellipse
-    VecFloat *diameter = VecGetOp(r, 2.0, NULL, 0.0);
-    if (diameter != NULL) {
-      // Scale the Spheroid
-      ShapoidScale(spheroid, diameter);
-      VecFree(&diameter);
-      // Draw the Spheroid
-      TGAFillShapoid(tga, spheroid, pen);
+// Create an empty TGADrawList
+// Return NULL if we couldn't allocate memory
+TGADrawList* TGADrawListCreate(void) {
+  // Allocate memory
+  TGADrawList *ret = (TGADrawList*)malloc(sizeof(TGADrawList));
+  // If we could allocate memory
+  if (ret != NULL) {
+    // Create the sets of commands and pencils
+    ret->_cmds = GSetCreate();
+    ret->_pens = GSetCreate();
+    // If we couldn't allocate memory
+    if (ret->_cmds == NULL || ret->_pens == NULL) {
+      // Free memory
+      GSetFree(&(ret->_cmds));
+      GSetFree(&(ret->_pens));
+      free(ret);
+      ret = NULL;
     }
-    // Free memory
-    ShapoidFree(&spheroid);
   }
+  // Return the new list
+  return ret;
 }
 
-// Draw the shapoid 's' with pencil 'pen' 
-// The shapoid must be of dimension 2
-// Pixels outside the TGA are ignored
+// Free the memory used by the TGADrawList 'that' and its commands
+void TGADrawListFree(TGADrawList **that) {
+  // Check arguments
+  if (that == NULL || *that == NULL)
+    return;
+  // Free the commands and pencils
+  TGADrawListFlush(*that);
+  // Free memory
+  GSetFree(&((*that)->_cmds));
+  GSetFree(&((*that)->_pens));
+  free(*that);
+  *that = NULL;
+}
+
+// Remove all the commands of the TGADrawList 'that'
 // Do nothing if arguments are invalid
-void TGADrawShapoid(TGA *tga, Shapoid *s, TGAPencil *pen) {
+void TGADrawListFlush(TGADrawList *that) {
   // Check arguments
-  if (tga == NULL || s == NULL || pen == NULL || ShapoidGetDim(s) != 2)
+  if (that == NULL)
     return;
-  // Get the SCurve equivalent to the Shapoid
-  SCurve *curve = Shapoid2SCurve(s);
-  // If we could get the SCurve
-  if (curve != NULL) {
-    // Draw the SCurve
-    TGADrawSCurve(tga, curve, pen);
-    // Free memory
-    SCurveFree(&curve);
+  // Free the commands
+  while (that->_cmds->_nbElem > 0) {
+    TGADrawCmd *cmd = (TGADrawCmd*)GSetPop(that->_cmds);
+    TGADrawCmdFree(&cmd);
+  }
+  // Free the pencils
+  while (that->_pens->_nbElem > 0) {
+    TGAPencil *pen = (TGAPencil*)GSetPop(that->_pens);
+    TGAPencilFree(&pen);
   }
 }
 
-// Fill the shapoid 's' with pencil 'pen' 
-// The shapoid must be of dimension 2
-// Pixels outside the TGA are ignored
+// Record in the TGADrawList 'that' the drawing of a line between 
+// 'from' and 'to' with pencil 'pen'
+// The arguments are copied, they can be modified or freed after the
+// call
 // Do nothing if arguments are invalid
-void TGAFillShapoid(TGA *tga, Shapoid *s, TGAPencil *pen) {
+void TGADrawListDrawLine(TGADrawList *that, VecFloat *from, 
+  VecFloat *to, TGAPencil *pen) {
   // Check arguments
-  if (tga == NULL || s == NULL || pen == NULL ||
-    ShapoidGetDim(s) != 2)
+  if (that == NULL || from == NULL || to == NULL || pen == NULL)
     return;
-  // Clean the working layer
-  TGALayerClean(tga->_tmpLayer);
+  // Add the command
+  float pts[4] = {VecGet(from, 0), VecGet(from, 1), 
+    VecGet(to, 0), VecGet(to, 1)};
+  TGADrawListAddCmd(that, tgaDrawCmdLine, pts, NULL, NULL, NULL, pen);
+}
 
-  // Get the bounding box of the curve
-  VecShort *bound = NULL;
-  Shapoid *bounding = ShapoidGetBoundingBox(s);
-  // If we could get the bounding box
-  if (bounding != NULL) {
-    bound = VecShortCreate(4);
-    if (bound != NULL) {
-      for (int i = 2; i--;) {
-        VecSet(bound, i, VecGet(bounding->_pos, i) - pen->_thickness);
-        VecSet(bound, 2 + i, VecGet(bounding->_pos, i) + 
-          pen->_thickness);
-      }
-      for (int i = 2; i--;)
-        VecSet(bound, 2 + i, 
-          VecGet(bound, 2 + i) + VecGet(bounding->_axis[i], i));
-    }
-    // Declare a variable to memorize the upper right limit of 
-    // the bounding box
-    VecFloat *to = 
-      VecGetOp(bounding->_pos, 1.0, bounding->_axis[0], 1.0);
-    VecOp(to, 1.0, bounding->_axis[1], 1.0);
-    // If we couldn't get the upper right limit
-    if (to == NULL) {
-      // Free memory and stop here
-      ShapoidFree(&bounding);
-      return;
-    }
-    // Declare a variable to memorize the pixel position
-    VecFloat *pos = VecFloatCreate(2);
-    // If we couldn't allocate memory
-    if (pos == NULL) {
-      // Free memory and stop here
-      ShapoidFree(&bounding);
-      VecFree(&to);
-      return;
-    }
-    // For each pixel in the bounding box
-    for (VecSet(pos, 0, VecGet(bounding->_pos, 0));
-      VecGet(pos, 0) < VecGet(to, 0) + PBMATH_EPSILON;
-      VecSet(pos, 0, VecGet(pos, 0) + 1.0)) {
-      for (VecSet(pos, 1, VecGet(bounding->_pos, 1));
-        VecGet(pos, 1) < VecGet(to, 1) + PBMATH_EPSILON;
-        VecSet(pos, 1, VecGet(pos, 1) + 1.0)) {
-        // If the pixel is in the Shapoid
-        if (ShapoidIsPosInside(s, pos) == true) {
-          // Set the blend of the pencil with the depth of the pos 
-          // in the shapoid for the case the pencil is in 
-          // tgaPenBlend mode
-          TGAPencilSetBlend(pen, 1.0 - ShapoidGetPosDepth(s, pos));
-          // Draw the pixel
-          TGALayerStrokePix(tga->_tmpLayer, pos, pen);
-        }
-      }
-    }
-    // Blend the working layer in the current layer
-    TGALayerBlend(tga->_curLayer, tga->_tmpLayer, bound);
+// Record in the TGADrawList 'that' the drawing of the BCurve 'curve' 
+// (must be of dimension 2 and order > 0) with pencil 'pen'
+// The arguments are copied, they can be modified or freed after the
+// call
+// Do nothing if arguments are invalid
+void TGADrawListDrawBCurve(TGADrawList *that, BCurve *curve, 
+  TGAPencil *pen) {
+  // Check arguments
+  if (that == NULL || curve == NULL || pen == NULL || 
+    BCurveOrder(curve) < 1 || BCurveDim(curve) != 2)
+    return;
+  // Add the command with a copy of the curve
+  TGADrawListAddCmd(that, tgaDrawCmdBCurve, NULL, BCurveClone(curve), 
+    NULL, NULL, pen);
+}
+
+// Record in the TGADrawList 'that' the drawing of the SCurve 'curve'
+// (must be of dimension 2) with pencil 'pen'
+// The arguments are copied, they can be modified or freed after the
+// call
+// Do nothing if arguments are invalid
+void TGADrawListDrawSCurve(TGADrawList *that, SCurve *curve, 
+  TGAPencil *pen) {
+  // Check arguments
+  if (that == NULL || curve == NULL || pen == NULL)
+    return;
+  // Add the command with a copy of the curve
+  TGADrawListAddCmd(that, tgaDrawCmdSCurve, NULL, NULL, 
+    SCurveClone(curve), NULL, pen);
+}
+
+// Record in the TGADrawList 'that' the drawing of a rectangle between
+// 'from' and 'to' with pencil 'pen'
+// The arguments are copied, they can be modified or freed after the
+// call
+// Do nothing if arguments are invalid
+void TGADrawListDrawRect(TGADrawList *that, VecFloat *from, 
+  VecFloat *to, TGAPencil *pen) {
+  // Check arguments
+  if (that == NULL || from == NULL || to == NULL || pen == NULL)
+    return;
+  // Create the Facoid equivalent to the rectangle
+  Shapoid *facoid = TGAShapoidCreateRect(from, to);
+  if (facoid != NULL) {
+    // Record the drawing of the Facoid
+    TGADrawListDrawShapoid(that, facoid, pen);
     // Free memory
-    ShapoidFree(&bounding);
-    VecFree(&to);
-    VecFree(&pos);
-    VecFree(&bound);
+    ShapoidFree(&facoid);
   }
 }
 
-// Apply a gaussian blur of 'strength' and 'range' perimeter on the TGA
-// Do nothing if arguments are invalid 
-void TGAFilterGaussBlur(TGA *tga, float strength, float range) {
+// Record in the TGADrawList 'that' the filling of a rectangle between
+// 'from' and 'to' with pencil 'pen'
+// The arguments are copied, they can be modified or freed after the
+// call
+// Do nothing if arguments are invalid
+void TGADrawListFillRect(TGADrawList *that, VecFloat *from, 
+  VecFloat *to, TGAPencil *pen) {
   // Check arguments
-  if (tga == NULL || tga->_header == NULL || strength <= 0.0)
+  if (that == NULL || from == NULL || to == NULL || pen == NULL)
     return;
-  // Create a Gauss
-  Gauss *gauss = GaussCreate(0.0, strength);
-  // If we couldn't create the gauss
-  if (gauss == NULL) {
-    // Stop here
+  // Add the command with the Facoid equivalent to the rectangle
+  TGADrawListAddCmd(that, tgaDrawCmdFill, NULL, NULL, NULL, 
+    TGAShapoidCreateRect(from, to), pen);
+}
+
+// Record in the TGADrawList 'that' the drawing of an ellipse at 
+// 'center' of radius 'r' (Rx,Ry) with pencil 'pen'
+// The arguments are copied, they can be modified or freed after the
+// call
+// Do nothing if arguments are invalid
+void TGADrawListDrawEllipse(TGADrawList *that, VecFloat *center, 
+  VecFloat *r, TGAPencil *pen) {
+  // Check arguments
+  if (that == NULL || center == NULL || r == NULL || pen == NULL)
     return;
+  // Create the Spheroid equivalent to the ellipse
+  Shapoid *spheroid = TGAShapoidCreateEllipse(center, r);
+  if (spheroid != NULL) {
+    // Record the drawing of the Spheroid
+    TGADrawListDrawShapoid(that, spheroid, pen);
+    // Free memory
+    ShapoidFree(&spheroid);
   }
-  // Allocate memory for a temporary buffer
-  float *drgb = (float*)malloc(tga->_header->_width *
-    tga->_header->_height * 4 * sizeof(float));
-  // If we couldn't allocate memory
-  if (drgb == NULL) {
-    // Stop here
-    GaussFree(&gauss);
+}
+
+// Record in the TGADrawList 'that' the filling of an ellipse at 
+// 'center' of radius 'r' (Rx,Ry) with pencil 'pen'
+// The arguments are copied, they can be modified or freed after the
+// call
+// Do nothing if arguments are invalid
+void TGADrawListFillEllipse(TGADrawList *that, VecFloat *center, 
+  VecFloat *r, TGAPencil *pen) {
+  // Check arguments
+  if (that == NULL || center == NULL || r == NULL || pen == NULL ||
+    VecGet(r, 0) <= 0.0 || VecGet(r, 1) <= 0.0)
     return;
-  }
-  // Declare a variable for passing argument
-  VecShort *v = VecShortCreate(2);
-  if (v == NULL) {
-    // Stop here
-    GaussFree(&gauss);
-    free(drgb);
-    return;
-  }
-  // Declare variable to memorize current pixel
-  short px[2];
-  // Declare variable to memorize index of rgba
-  int irgb = 0;
-  // For each pixel
-  for (px[0] = tga->_header->_width; px[0]--;) {
-    for (px[1] = tga->_header->_height; px[1]--;) {
-      // Get index of the current pixel
-      long int index = 4 * (px[1] * tga->_header->_width + px[0]);
-      // For each rgba value
-      for (irgb = 4; irgb--;)
-        // Initialize the value in the temporary buffer to 0
-        drgb[index + irgb] = 0.0;
-    }
-  }
-  // For each pixel
-  for (px[0] = tga->_header->_width; px[0]--;) {
-    for (px[1] = tga->_header->_height; px[1]--;) {
-      // Get index of the current pixel
-      long int indexp = 4 * (px[1] * tga->_header->_width + px[0]);
-      // For each rgba value
-      for (irgb = 4; irgb--;) {
-        // Declare a variable to memorize position of pixel in range
-        short qx[2];
-        // Declare variables to calculate new value of rgba
-        double sum = 0.0;
-        double p = 0.0;
-        // Calculate the corners positions of the area in range
-        short from[2];
-        short to[2];
-        from[0] = (px[0] > range ? px[0] - range : 0);
-        from[1] = (px[1] > range ? px[1] - range : 0);
-        to[0] = (px[0] < tga->_header->_width - range ? 
-          px[0] + range : tga->_header->_width);
-        to[1] = (px[1] < tga->_header->_height - range ? 
-          px[1] + range : tga->_header->_height);
-        // For each pixel in range
-        for (qx[0] = from[0]; qx[0] < to[0]; ++(qx[0])) {
-          for (qx[1] = from[1]; qx[1] < to[1]; ++(qx[1])) {
-            // Calculate the distance of this pixel to the current pixel
-            double dist = sqrt(pow(qx[0] - px[0], 2.0) + 
-              pow(qx[1] - px[1], 2.0));
-            // If this pixel is in range
-            if (dist < range) {
-              // Calculate the Gauss coefficient
-              double g = GaussGet(gauss, dist);
-              // Update the values to calculate the new rgba
-              sum += g;
-              VecSet(v, 0, qx[0]);
-              VecSet(v, 1, qx[1]);
-              TGAPixel *pixelQ = TGAGetPix(tga, v);
-              p += g * (double)(pixelQ->_rgba[irgb]);
-            }
-          }
-        }
-        // Update the new value of the current pixel in the 
-        // temporary buffer
-        drgb[indexp + irgb] = p / sum;
-      }
-    }
-  }
-  // For each pixel
-  for (px[0] = tga->_header->_width; px[0]--;) {
-    for (px[1] = tga->_header->_height; px[1]--;) {
-      // Get the index of the pixel
-      long int index = 4 * (px[1] * tga->_header->_width + px[0]);
-      // Get a pointer to the pixel
-      VecSet(v, 0, px[0]);
-      VecSet(v, 1, px[1]);
-      TGAPixel *pixel = TGAGetPix(tga, v);
-      // For each rgba value
-      for (irgb = 4; irgb--;) {
-        // Copy the new value from the temporary buffer to the tga
-        pixel->_rgba[irgb] = 
-          (unsigned char)round(drgb[index + irgb]);  
-      }
-    }
-  } 
-  // Free memory
-  VecFree(&v);
-  GaussFree(&gauss);
-  free(drgb);
-  drgb = NULL;
+  // Add the command with the Spheroid equivalent to the ellipse
+  TGADrawListAddCmd(that, tgaDrawCmdFill, NULL, NULL, NULL, 
+    TGAShapoidCreateEllipse(center, r), pen);
+}
+
+// Record in the TGADrawList 'that' the drawing of the shapoid 's' 
+// (must be of dimension 2) with pencil 'pen'
+// The arguments are copied, they can be modified or freed after the
+// call
+// Do nothing if arguments are invalid
+void TGADrawListDrawShapoid(TGADrawList *that, Shapoid *s, 
+  TGAPencil *pen) {
+  // Check arguments
+  if (that == NULL || s == NULL || pen == NULL || 
+    ShapoidGetDim(s) != 2)
+    return;
+  // Add the command with the SCurve equivalent to the Shapoid
+  TGADrawListAddCmd(that, tgaDrawCmdSCurve, NULL, NULL, 
+    Shapoid2SCurve(s), NULL, pen);
+}
+
+// Record in the TGADrawList 'that' the filling of the shapoid 's' 
+// (must be of dimension 2) with pencil 'pen'
+// The arguments are copied, they can be modified or freed after the
+// call
+// Do nothing if arguments are invalid
+void TGADrawListFillShapoid(TGADrawList *that, Shapoid *s, 
+  TGAPencil *pen) {
+  // Check arguments
+  if (that == NULL || s == NULL || pen == NULL || 
+    ShapoidGetDim(s) != 2)
+    return;
+  // Add the command with a copy of the Shapoid
+  TGADrawListAddCmd(that, tgaDrawCmdFill, NULL, NULL, NULL, 
+    ShapoidClone(s), pen);
 }
 
-// Print the string 's' with its anchor position at 'pos', TGAPencil 
-// 'pen' and font 'font'
-void TGAPrintString(TGA *tga, TGAPencil *pen, TGAFont *font, 
-  unsigned char *s, VecFloat *pos) {
+// Record in the TGADrawList 'that' the printing of the string 's' 
+// with its anchor position at 'pos', TGAPencil 'pen' and font 'font'
+// The arguments are copied, they can be modified or freed after the
+// call
+// Do nothing if arguments are invalid
+void TGADrawListPrintString(TGADrawList *that, TGAPencil *pen, 
+  TGAFont *font, unsigned char *s, VecFloat *pos) {
   // Check arguments
-  if (tga == NULL || pen == NULL || font == NULL || s == NULL ||
+  if (that == NULL || pen == NULL || font == NULL || s == NULL ||
     pos == NULL)
     return;
   // Get the bounding box in pixel
@@ -1143,7 +4370,7 @@ void TGAPrintString(TGA *tga, TGAPencil *pen, TGAFont *font,
     // Else, the character should be a printable character
     } else {
       // Print the character
-      TGAPrintChar(tga, pen, font, s[iChar], cursor);
+      TGADrawListPrintChar(that, pen, font, s[iChar], cursor);
       // Increment the position in abciss by one character plus
       // interspace
       VecOp(cursor, 1.0, right, 1.0);
@@ -1163,38 +4390,584 @@ void TGAPrintString(TGA *tga, TGAPencil *pen, TGAFont *font,
   ShapoidFree(&boundbox);
 }
 
-// Print the char 'c' with its (bottom, left) position at 'pos'
-// and (width, height) dimension 'dim' with font 'font'
-void TGAPrintChar(TGA *tga, TGAPencil *pen, TGAFont *font, 
-  unsigned char c, VecFloat *pos) {
+// Record in the TGADrawList 'that' the printing of the char 'c' with
+// its (bottom, left) position at 'pos', TGAPencil 'pen' and font 
+// 'font'
+// The arguments are copied, they can be modified or freed after the
+// call
+// Do nothing if arguments are invalid
+void TGADrawListPrintChar(TGADrawList *that, TGAPencil *pen, 
+  TGAFont *font, unsigned char c, VecFloat *pos) {
   // Check arguments
-  if (tga == NULL || pen == NULL || font == NULL || pos == NULL)
+  if (that == NULL || pen == NULL || font == NULL || pos == NULL)
     return;
-  // Declare a vecfloat to scale the curve
-  VecFloat *scale = VecGetOp(font->_scale, font->_size, NULL, 0.0);
-  if (scale == NULL)
+  // Add the command with the curve of the character at its position
+  TGADrawListAddCmd(that, tgaDrawCmdSCurve, NULL, NULL, 
+    TGAFontGetCharCurve(font, c, pos), NULL, pen);
+}
+
+// Add to the TGADrawList 'that' a command of type 'type' with pencil
+// 'pen' and geometry 'pts', 'bcurve', 'scurve' or 'shape' according
+// to its type
+// The geometry belongs to the command, it's freed if the command 
+// can't be added
+void TGADrawListAddCmd(TGADrawList *that, tgaDrawCmdType type, 
+  float *pts, BCurve *bcurve, SCurve *scurve, Shapoid *shape, 
+  TGAPencil *pen) {
+  // Allocate memory for the command
+  TGADrawCmd *cmd = (TGADrawCmd*)malloc(sizeof(TGADrawCmd));
+  // If we could allocate memory
+  if (cmd != NULL) {
+    // Set the command
+    cmd->_type = type;
+    cmd->_pen = NULL;
+    if (pts != NULL)
+      memcpy(cmd->_pts, pts, 4 * sizeof(float));
+    cmd->_bcurve = bcurve;
+    cmd->_scurve = scurve;
+    cmd->_shape = shape;
+    // If the last recorded pencil draws like 'pen'
+    GSetElem *last = that->_pens->_tail;
+    if (last != NULL && TGAPencilIsSame((TGAPencil*)(last->_data), pen))
+      // Share it with the previous commands
+      cmd->_pen = (TGAPencil*)(last->_data);
+    // Else, record a copy of 'pen'
+    else {
+      cmd->_pen = TGAPencilClone(pen);
+      if (cmd->_pen != NULL)
+        GSetAppend(that->_pens, cmd->_pen);
+    }
+    cmd->_iPen = that->_pens->_nbElem - 1;
+  }
+  // If we couldn't allocate memory or copy the geometry
+  if (cmd == NULL || cmd->_pen == NULL || (type == tgaDrawCmdBCurve && 
+    bcurve == NULL) || (type == tgaDrawCmdSCurve && scurve == NULL) ||
+    (type == tgaDrawCmdFill && shape == NULL)) {
+    // Free memory and stop here
+    if (cmd != NULL) {
+      TGADrawCmdFree(&cmd);
+    } else {
+      BCurveFree(&bcurve);
+      SCurveFree(&scurve);
+      ShapoidFree(&shape);
+    }
     return;
-  // Set a pointer to the requested character's definition
-  TGAChar *ch = font->_char + c;
-  // Declare a variable to memorize the angle between the abciss
-  // and the right direction of the font
-  float theta = TGAFontGetAngleWithAbciss(font);
-  // Clone the curve
-  SCurve *clone = SCurveClone(ch->_curve);
-  // If we could clone the curve
-  if (clone != NULL) {
-    // Scale the curve
-    SCurveScale(clone, scale);
-    // Rotate the curve
-    SCurveRot2D(clone, theta);
-    // Translate the curve
-    SCurveTranslate(clone, pos);
+  }
+  // Get the pixels the command may modify
+  TGADrawCmdUpdateBox(cmd);
+  // Add the command to the list
+  GSetAppend(that->_cmds, cmd);
+}
+
+// Free the memory used by the TGADrawCmd 'that' (not its pencil)
+void TGADrawCmdFree(TGADrawCmd **that) {
+  // Check arguments
+  if (that == NULL || *that == NULL)
+    return;
+  // Free memory
+  BCurveFree(&((*that)->_bcurve));
+  SCurveFree(&((*that)->_scurve));
+  ShapoidFree(&((*that)->_shape));
+  free(*that);
+  *that = NULL;
+}
+
+// Update the box of the pixels the TGADrawCmd 'that' may modify
+void TGADrawCmdUpdateBox(TGADrawCmd *that) {
+  // Declare a variable to memorize the box of the geometry
+  float box[4] = {INFINITY, INFINITY, -INFINITY, -INFINITY};
+  // Declare variables to get the support of Shapoids
+  float n[2];
+  float kMin[2];
+  float kMax[2];
+  // If the command is a line
+  if (that->_type == tgaDrawCmdLine) {
+    // The box is the one of its ends
+    for (int iPt = 2; iPt--;) {
+      for (int i = 2; i--;) {
+        box[i] = fmin(box[i], that->_pts[2 * iPt + i]);
+        box[2 + i] = fmax(box[2 + i], that->_pts[2 * iPt + i]);
+      }
+    }
+  // Else, if the command is a curve
+  } else if (that->_type == tgaDrawCmdBCurve || 
+    that->_type == tgaDrawCmdSCurve) {
+    // Declare a pointer to loop on the BCurves of the command
+    GSetElem *ptr = (that->_scurve != NULL ? 
+      that->_scurve->_curves->_head : NULL);
+    BCurve *curve = (that->_bcurve != NULL ? that->_bcurve : 
+      (ptr != NULL ? (BCurve*)(ptr->_data) : NULL));
+    while (curve != NULL) {
+      // The curve is inside the box of its control points
+      for (int iCtrl = curve->_order + 1; iCtrl--;) {
+        for (int i = 2; i--;) {
+          box[i] = fmin(box[i], VecGet(curve->_ctrl[iCtrl], i));
+          box[2 + i] = fmax(box[2 + i], VecGet(curve->_ctrl[iCtrl], i));
+        }
+      }
+      // Move to the next curve
+      ptr = (ptr != NULL ? ptr->_next : NULL);
+      curve = (ptr != NULL ? (BCurve*)(ptr->_data) : NULL);
+    }
+  // Else, the command is a filled Shapoid
+  } else {
+    // The box is given by the support of the Shapoid along the axis
+    for (int i = 2; i--;) {
+      n[i] = 1.0;
+      n[1 - i] = 0.0;
+      TGAShapoidGetSupport(that->_shape, n, kMin, kMax);
+      box[i] = kMin[i];
+      box[2 + i] = kMax[i];
+    }
+  }
+  // If the pencil is a Shapoid, extend the box by the one of its tip
+  if (that->_pen->_shape == tgaPenShapoid && that->_pen->_tip != NULL) {
+    for (int i = 2; i--;) {
+      n[i] = 1.0;
+      n[1 - i] = 0.0;
+      TGAShapoidGetSupport(that->_pen->_tip, n, kMin, kMax);
+      box[i] += kMin[i];
+      box[2 + i] += kMax[i];
+    }
+  }
+  // If the command has no geometry
+  if (box[0] > box[2] || box[1] > box[3]) {
+    // The box is empty
+    that->_box[0] = that->_box[1] = 0;
+    that->_box[2] = that->_box[3] = -1;
+  // Else, convert the box to pixels, with a margin of one pixel for 
+  // the antialias and the rounding of the strokes, clipped to the 
+  // range of the coordinates of pixels
+  } else {
+    for (int i = 2; i--;) {
+      that->_box[i] = (int)fmax(floor(box[i]) - 1.0, SHRT_MIN);
+      that->_box[2 + i] = (int)fmin(ceil(box[2 + i]) + 1.0, SHRT_MAX);
+    }
+  }
+}
+
+// Draw the command 'cmd' in the layer 'that' with the pencil 'pen'
+void TGALayerAddDrawCmd(TGALayer *that, TGADrawCmd *cmd, 
+  TGAPencil *pen) {
+  // If the command is a line
+  if (cmd->_type == tgaDrawCmdLine) {
+    // Draw the line
+    float blend[2] = {0.0, 1.0};
+    TGALayerAddPolyline(that, cmd->_pts, blend, 2, pen);
+  // Else, if the command is a BCurve
+  } else if (cmd->_type == tgaDrawCmdBCurve) {
     // Draw the curve
-    TGADrawSCurve(tga, clone, pen);
-    // Free memory
-    SCurveFree(&clone);
+    TGALayerAddCurve(that, cmd->_bcurve, pen);
+  // Else, if the command is a SCurve
+  } else if (cmd->_type == tgaDrawCmdSCurve) {
+    // Draw each BCurve of the SCurve
+    GSetElem *ptr = cmd->_scurve->_curves->_head;
+    while (ptr != NULL) {
+      TGALayerAddCurve(that, (BCurve*)(ptr->_data), pen);
+      ptr = ptr->_next;
+    }
+  // Else, the command is a filled Shapoid
+  } else {
+    // Fill the Shapoid
+    TGALayerFillShapoid(that, cmd->_shape, pen);
+  }
+}
+
+// Execute the commands of the TGADrawList 'list' on the current 
+// layer of the TGA 'tga'
+// The result is the same as calling the corresponding TGADraw*, 
+// TGAFill* and TGAPrint* functions in the order of recording, but
+// commands whose pixels don't overlap are drawn together in the 
+// working layer and blended at once, area by area
+// Commands outside the TGA are skipped
+// The list is left unchanged and can be executed again
+// Do nothing if arguments are invalid
+void TGAExecDrawList(TGA *tga, TGADrawList *list) {
+  // Check arguments
+  if (tga == NULL || list == NULL)
+    return;
+  // Clean the area of the working layer modified by the previous
+  // drawing
+  TGALayerCleanDirty(tga->_tmpLayer);
+  // Draw the commands
+  TGALayerExecDrawCmds(tga->_curLayer, tga->_tmpLayer, 
+    list->_cmds->_head, NULL, NULL, 0, NULL);
+}
+
+// Draw in the layer 'that', through its clean working layer 'tmp', 
+// the commands of the set starting at 'elem' if it's not NULL, else 
+// the 'nbCmd' commands 'cmds[iCmds[i]]'
+// The commands are drawn with the pencils 'pens[cmd->_iPen]' (copied
+// from their own pencil when NULL) if 'pens' is not NULL, else with 
+// their own pencil
+// The pixels are clipped to the clip box of 'tmp' and 'tmp' is clean
+// at the end
+void TGALayerExecDrawCmds(TGALayer *that, TGALayer *tmp, 
+  GSetElem *elem, TGADrawCmd **cmds, int *iCmds, int nbCmd, 
+  TGAPencil **pens) {
+  // Declare a pointer to the dirty box of the working layer
+  VecShort *dirty = tmp->_dirty;
+  // Declare variables to memorize the areas of the working layer 
+  // drawn and not yet blended
+  int areas[4 * TGA_DRAWLISTNBAREA];
+  int nbArea = 0;
+  // Loop on the commands
+  for (int iCmd = 0; elem != NULL || iCmd < nbCmd; ++iCmd) {
+    // Get the command
+    TGADrawCmd *cmd = NULL;
+    if (elem != NULL) {
+      cmd = (TGADrawCmd*)(elem->_data);
+      elem = elem->_next;
+    } else {
+      cmd = cmds[iCmds[iCmd]];
+    }
+    // Get the box of the command clipped to the working layer
+    int box[4];
+    for (int i = 2; i--;) {
+      box[i] = (cmd->_box[i] > VecGet(tmp->_clip, i) ? 
+        cmd->_box[i] : VecGet(tmp->_clip, i));
+      box[2 + i] = (cmd->_box[2 + i] < VecGet(tmp->_clip, 2 + i) ? 
+        cmd->_box[2 + i] : VecGet(tmp->_clip, 2 + i));
+    }
+    // If the command is outside the working layer, skip it
+    if (box[0] > box[2] || box[1] > box[3])
+      continue;
+    // Get the pencil of the command
+    TGAPencil *pen = cmd->_pen;
+    if (pens != NULL) {
+      if (pens[cmd->_iPen] == NULL)
+        pens[cmd->_iPen] = TGAPencilClone(cmd->_pen);
+      pen = pens[cmd->_iPen];
+      // If we couldn't copy the pencil, skip the command
+      if (pen == NULL)
+        continue;
+    }
+    // If the command may modify pixels in the areas not yet blended,
+    // or there is no more room for its area, blend the areas first
+    bool overlap = (nbArea == TGA_DRAWLISTNBAREA);
+    for (int iArea = nbArea; iArea-- && overlap == false;) {
+      int *area = areas + 4 * iArea;
+      overlap = (box[0] <= area[2] && area[0] <= box[2] && 
+        box[1] <= area[3] && area[1] <= box[3]);
+    }
+    if (overlap == true) {
+      TGALayerBlendAreas(that, tmp, areas, nbArea);
+      nbArea = 0;
+    }
+    // Draw the command in the working layer, its dirty box being 
+    // empty before to get the area actually drawn
+    TGALayerAddDrawCmd(tmp, cmd, pen);
+    int drawn[4];
+    for (int i = 4; i--;)
+      drawn[i] = VecGet(dirty, i);
+    VecSet(dirty, 0, 0);
+    VecSet(dirty, 1, 0);
+    VecSet(dirty, 2, -1);
+    VecSet(dirty, 3, -1);
+    // If nothing has been drawn, there is nothing to blend
+    if (drawn[0] > drawn[2])
+      continue;
+    // If there is a previous area and the union with it is not much
+    // larger than the two areas, merge them, unless the union 
+    // overlaps another area
+    bool merged = false;
+    if (nbArea > 0) {
+      int *last = areas + 4 * (nbArea - 1);
+      int u[4] = {(drawn[0] < last[0] ? drawn[0] : last[0]), 
+        (drawn[1] < last[1] ? drawn[1] : last[1]),
+        (drawn[2] > last[2] ? drawn[2] : last[2]),
+        (drawn[3] > last[3] ? drawn[3] : last[3])};
+      float surf = (float)(u[2] - u[0] + 1) * (float)(u[3] - u[1] + 1);
+      float sum = (float)(drawn[2] - drawn[0] + 1) * 
+        (float)(drawn[3] - drawn[1] + 1) +
+        (float)(last[2] - last[0] + 1) * (float)(last[3] - last[1] + 1);
+      if (surf <= TGA_DRAWLISTMERGE * sum) {
+        merged = true;
+        for (int iArea = nbArea - 1; iArea-- && merged == true;) {
+          int *area = areas + 4 * iArea;
+          merged = !(u[0] <= area[2] && area[0] <= u[2] && 
+            u[1] <= area[3] && area[1] <= u[3]);
+        }
+        if (merged == true)
+          memcpy(last, u, 4 * sizeof(int));
+      }
+    }
+    // If the area couldn't be merged, add it to the areas
+    if (merged == false) {
+      memcpy(areas + 4 * nbArea, drawn, 4 * sizeof(int));
+      ++nbArea;
+    }
+  }
+  // Blend the remaining areas
+  TGALayerBlendAreas(that, tmp, areas, nbArea);
+}
+
+// Blend the 'nbArea' boxes 'areas' (x0,y0,x1,y1 quadruplets, not 
+// overlapping) of the working layer 'tmp' in the layer 'that' and 
+// erase them in the working layer
+void TGALayerBlendAreas(TGALayer *that, TGALayer *tmp, int *areas, 
+  int nbArea) {
+  // If there is no area, there is nothing to do
+  if (nbArea == 0)
+    return;
+  // Declare a variable to pass the areas to TGALayerBlend
+  VecShort *bound = VecShortCreate(4);
+  // For each area
+  for (int iArea = 0; iArea < nbArea; ++iArea) {
+    int *area = areas + 4 * iArea;
+    // Blend the area in the layer
+    if (bound != NULL) {
+      for (int i = 4; i--;)
+        VecSet(bound, i, area[i]);
+      TGALayerBlend(that, tmp, bound);
+    }
+    // Erase the area in the working layer
+    TGALayerCleanBox(tmp, area[0], area[1], area[2], area[3]);
+  }
+  // Free memory
+  VecFree(&bound);
+}
+
+// Execute the commands of the TGADrawList 'list' on the current 
+// layer of the TGA 'tga' with 'nbThread' threads (as many as 
+// processors if 'nbThread' < 1)
+// The TGA is split into tiles of TGA_TILESIZE pixels, each command is
+// attached to the tiles its box overlaps, and the threads draw the 
+// tiles in parallel, each one with the commands in their order of
+// recording clipped to the tile
+// The result is the same as TGAExecDrawList
+// Do nothing if arguments are invalid
+void TGAExecDrawListTiled(TGA *tga, TGADrawList *list, int nbThread) {
+  // Check arguments
+  if (tga == NULL || list == NULL)
+    return;
+  // Declare the job shared by the workers
+  TGATileJob job;
+  job._layer = tga->_curLayer;
+  job._tmpLayer = tga->_tmpLayer;
+  job._nbTileX = 
+    (VecGet(job._layer->_dim, 0) + TGA_TILESIZE - 1) / TGA_TILESIZE;
+  job._nbTile = job._nbTileX * 
+    ((VecGet(job._layer->_dim, 1) + TGA_TILESIZE - 1) / TGA_TILESIZE);
+  job._nbPen = list->_pens->_nbElem;
+  atomic_init(&(job._iNextTile), 0);
+  // Get the number of workers, one per thread and no more than tiles
+  if (nbThread < 1)
+    nbThread = (int)sysconf(_SC_NPROCESSORS_ONLN);
+  if (nbThread > job._nbTile)
+    nbThread = job._nbTile;
+  // If there is only one thread
+  if (nbThread < 2) {
+    // Draw the list in the calling thread and stop here
+    TGAExecDrawList(tga, list);
+    return;
+  }
+  // Allocate memory for the commands, the bins of the tiles and the 
+  // workers
+  int nbCmd = list->_cmds->_nbElem;
+  job._cmds = (TGADrawCmd**)malloc((nbCmd + 1) * sizeof(TGADrawCmd*));
+  job._binStart = (int*)calloc(job._nbTile + 1, sizeof(int));
+  job._binCmds = NULL;
+  int *binEnd = (int*)malloc(job._nbTile * sizeof(int));
+  TGATileWorker *workers = 
+    (TGATileWorker*)calloc(nbThread, sizeof(TGATileWorker));
+  pthread_t *threads = (pthread_t*)malloc(nbThread * sizeof(pthread_t));
+  bool ok = (job._cmds != NULL && job._binStart != NULL && 
+    binEnd != NULL && workers != NULL && threads != NULL);
+  // If we could allocate memory
+  if (ok == true) {
+    // Get the commands in an array and count the commands per tile
+    GSetElem *ptr = list->_cmds->_head;
+    for (int iCmd = 0; iCmd < nbCmd; ++iCmd, ptr = ptr->_next) {
+      job._cmds[iCmd] = (TGADrawCmd*)(ptr->_data);
+      int tiles[4];
+      if (TGATileJobGetTiles(&job, job._cmds[iCmd], tiles) == true)
+        for (int ty = tiles[1]; ty <= tiles[3]; ++ty)
+          for (int tx = tiles[0]; tx <= tiles[2]; ++tx)
+            ++(job._binStart[ty * job._nbTileX + tx + 1]);
+    }
+    // Get the index of the first command of each tile in the bins
+    for (int iTile = 0; iTile < job._nbTile; ++iTile)
+      job._binStart[iTile + 1] += job._binStart[iTile];
+    // Allocate memory for the bins
+    job._binCmds = 
+      (int*)malloc((job._binStart[job._nbTile] + 1) * sizeof(int));
+    ok = (job._binCmds != NULL);
+  }
+  // If we could allocate memory
+  if (ok == true) {
+    // Attach the commands to the tiles, in their order of recording
+    memcpy(binEnd, job._binStart, job._nbTile * sizeof(int));
+    for (int iCmd = 0; iCmd < nbCmd; ++iCmd) {
+      int tiles[4];
+      if (TGATileJobGetTiles(&job, job._cmds[iCmd], tiles) == true)
+        for (int ty = tiles[1]; ty <= tiles[3]; ++ty)
+          for (int tx = tiles[0]; tx <= tiles[2]; ++tx)
+            job._binCmds[(binEnd[ty * job._nbTileX + tx])++] = iCmd;
+    }
+    // Create the workers
+    for (int iThread = 0; iThread < nbThread && ok == true; ++iThread)
+      ok = TGATileWorkerInit(workers + iThread, &job);
+  }
+  // If we could create the workers
+  if (ok == true) {
+    // Clean the area of the working layer modified by the previous
+    // drawing
+    TGALayerCleanDirty(job._tmpLayer);
+    // Start the workers, the last one in the calling thread; the 
+    // tiles are shared dynamically, so if a thread couldn't be 
+    // started the other workers draw its tiles
+    for (int iThread = 0; iThread < nbThread - 1; ++iThread)
+      workers[iThread]._started = (pthread_create(threads + iThread, 
+        NULL, TGATileWorkerRun, workers + iThread) == 0);
+    TGATileWorkerRun(workers + nbThread - 1);
+    // Wait for the other workers
+    for (int iThread = 0; iThread < nbThread - 1; ++iThread)
+      if (workers[iThread]._started == true)
+        pthread_join(threads[iThread], NULL);
+    // Add the areas modified by the workers to the modified area of
+    // the layer
+    for (int iThread = 0; iThread < nbThread; ++iThread) {
+      VecShort *dirty = workers[iThread]._layer._dirty;
+      TGALayerAddDirty(job._layer, VecGet(dirty, 0), VecGet(dirty, 1),
+        VecGet(dirty, 2), VecGet(dirty, 3));
+    }
+  }
+  // Free memory
+  for (int iThread = 0; workers != NULL && iThread < nbThread; 
+    ++iThread)
+    TGATileWorkerFree(workers + iThread);
+  free(binEnd);
+  free(job._binCmds);
+  free(job._binStart);
+  free(job._cmds);
+  free(workers);
+  free(threads);
+  // If we couldn't allocate memory, draw the list in the calling 
+  // thread
+  if (ok == false)
+    TGAExecDrawList(tga, list);
+}
+
+// Get in 'tiles' the range of tiles (x0,y0,x1,y1, included) of the 
+// TGATileJob 'that' overlapped by the box of the command 'cmd'
+// Return false if the box is outside the layer
+bool TGATileJobGetTiles(TGATileJob *that, TGADrawCmd *cmd, 
+  int *tiles) {
+  // Clip the box of the command to the layer
+  int box[4];
+  for (int i = 2; i--;) {
+    box[i] = (cmd->_box[i] > 0 ? cmd->_box[i] : 0);
+    box[2 + i] = (cmd->_box[2 + i] < VecGet(that->_layer->_dim, i) - 1 ?
+      cmd->_box[2 + i] : VecGet(that->_layer->_dim, i) - 1);
+  }
+  // If the box is outside the layer
+  if (box[0] > box[2] || box[1] > box[3])
+    return false;
+  // Get the tiles
+  for (int i = 4; i--;)
+    tiles[i] = box[i] / TGA_TILESIZE;
+  return true;
+}
+
+// Initialize the TGATileWorker 'that' for the TGATileJob 'job'
+// Return false if we couldn't allocate memory
+bool TGATileWorkerInit(TGATileWorker *that, TGATileJob *job) {
+  // Set the job
+  that->_job = job;
+  that->_started = false;
+  // Create the views on the layers, sharing their pixels with their
+  // own dirty and clip boxes
+  that->_layer = *(job->_layer);
+  that->_tmpLayer = *(job->_tmpLayer);
+  that->_layer._dirty = VecShortCreate(4);
+  that->_layer._clip = VecShortCreate(4);
+  that->_tmpLayer._dirty = VecShortCreate(4);
+  that->_tmpLayer._clip = VecShortCreate(4);
+  // Allocate memory for the copies of the pencils
+  that->_pens = (TGAPencil**)calloc(job->_nbPen + 1, sizeof(TGAPencil*));
+  // If we couldn't allocate memory
+  if (that->_layer._dirty == NULL || that->_layer._clip == NULL || 
+    that->_tmpLayer._dirty == NULL || that->_tmpLayer._clip == NULL ||
+    that->_pens == NULL)
+    return false;
+  // The views are not modified yet
+  VecSet(that->_layer._dirty, 2, -1);
+  VecSet(that->_layer._dirty, 3, -1);
+  VecSet(that->_tmpLayer._dirty, 2, -1);
+  VecSet(that->_tmpLayer._dirty, 3, -1);
+  // Return the success
+  return true;
+}
+
+// Free the memory used by the TGATileWorker 'that' (not the worker
+// itself)
+void TGATileWorkerFree(TGATileWorker *that) {
+  // Free the boxes of the views
+  VecFree(&(that->_layer._dirty));
+  VecFree(&(that->_layer._clip));
+  VecFree(&(that->_tmpLayer._dirty));
+  VecFree(&(that->_tmpLayer._clip));
+  // Free the copies of the pencils
+  if (that->_pens != NULL) {
+    for (int iPen = that->_job->_nbPen; iPen--;)
+      TGAPencilFree(that->_pens + iPen);
+    free(that->_pens);
+    that->_pens = NULL;
+  }
+}
+
+// Draw the tiles of the job of the TGATileWorker 'arg' until there is
+// no more tile to draw
+// Return NULL (for pthread_create)
+void* TGATileWorkerRun(void *arg) {
+  // Get the worker and its job
+  TGATileWorker *that = (TGATileWorker*)arg;
+  TGATileJob *job = that->_job;
+  // While there are tiles to draw, take the next one
+  int iTile;
+  while ((iTile = atomic_fetch_add(&(job->_iNextTile), 1)) < 
+    job->_nbTile) {
+    // If the tile has no command, skip it
+    int nbCmd = job->_binStart[iTile + 1] - job->_binStart[iTile];
+    if (nbCmd == 0)
+      continue;
+    // Clip the views to the tile inside the clip box of their layer
+    int tile[4];
+    tile[0] = (iTile % job->_nbTileX) * TGA_TILESIZE;
+    tile[1] = (iTile / job->_nbTileX) * TGA_TILESIZE;
+    tile[2] = tile[0] + TGA_TILESIZE - 1;
+    tile[3] = tile[1] + TGA_TILESIZE - 1;
+    TGATileWorkerClip(&(that->_layer), job->_layer, tile);
+    TGATileWorkerClip(&(that->_tmpLayer), job->_tmpLayer, tile);
+    // If the tile is outside the clip box, skip it
+    if (VecGet(that->_tmpLayer._clip, 0) > 
+      VecGet(that->_tmpLayer._clip, 2) ||
+      VecGet(that->_tmpLayer._clip, 1) > 
+      VecGet(that->_tmpLayer._clip, 3))
+      continue;
+    // Draw the commands of the tile
+    TGALayerExecDrawCmds(&(that->_layer), &(that->_tmpLayer), NULL, 
+      job->_cmds, job->_binCmds + job->_binStart[iTile], nbCmd, 
+      that->_pens);
+  }
+  // Return NULL
+  return NULL;
+}
+
+// Set the clip box of the view 'view' on the layer 'layer' to the
+// intersection of the tile 'tile' (x0,y0,x1,y1, included) with the 
+// clip box of 'layer'
+void TGATileWorkerClip(TGALayer *view, TGALayer *layer, int *tile) {
+  // For each coordinate of the box
+  for (int i = 4; i--;) {
+    // Get the coordinate of the clip box, or the one of the tile if
+    // it is inside
+    int v = VecGet(layer->_clip, i);
+    if (i < 2 ? tile[i] > v : tile[i] < v)
+      v = tile[i];
+    VecSet(view->_clip, i, v);
   }
-  VecFree(&scale);
 }
   
 // Get a white TGAPixel
@@ -1205,8 +4978,6 @@ TGAPixel* TGAGetWhitePixel(void) {
   if (ret != NULL) {
     // Set the pixel rgba values
     ret->_rgba[0] = ret->_rgba[1] = ret->_rgba[2] = ret->_rgba[3] = 255;
-    // Set the read only property
-    ret->_readOnly = false;
   }
   // Return the pixel
   return ret;
@@ -1260,13 +5031,9 @@ TGAPixel* TGAPixelBlend(TGAPixel *pixA, TGAPixel *pixB, float blend) {
   // Get a transparent pixel
   TGAPixel *ret = TGAGetTransparentPixel();
   // If we could get a transparent pixel
-  if (ret != NULL) {
-    // For each rgba value
-    for (int i = 4; i--;)
-      // Calculate the blended value
-      ret->_rgba[i] = (1.0 - blend) * pixA->_rgba[i] + 
-        blend * pixB->_rgba[i];
-  }
+  if (ret != NULL)
+    // Calculate the blended pixel
+    TGAPixelBlendTo(ret, pixA, pixB, blend);
   // Return the blend pixel
   return ret;
 }
@@ -1281,30 +5048,68 @@ TGAPixel* TGAPixelMix(TGAPixel *pixA, TGAPixel *pixB, float ratio) {
   // Get a transparent pixel
   TGAPixel *ret = TGAGetTransparentPixel();
   // If we could get a transparent pixel
-  if (ret != NULL) {
-    // Declare a variable to memorize the opacity in [0,1]
-    float opA = (float)(pixA->_rgba[3]) / 255.0;
-    float opB = ratio * (float)(pixB->_rgba[3]) / 255.0;
-    // If both pixel are not transparent
-    if (opA + opB > 1.0 / 255.0) {
-      // For each rgb value
-      for (int i = 3; i--;) {
-        // Calculate the mixed value
-        float v = (opA * (float)(pixA->_rgba[i]) + 
-          opB * (float)(pixB->_rgba[i])) / (opA + opB);
-        ret->_rgba[i] = (unsigned char)floor(v);
-      }
-      // Calculate mixed opacity (max of pixels opacity)
-      if (opA < opB)
-        ret->_rgba[3] = (unsigned char)floor(opB * 255.0);
-      else
-        ret->_rgba[3] = pixA->_rgba[3];
-    }
-  }
+  if (ret != NULL)
+    // Calculate the mixed pixel
+    TGAPixelMixTo(ret, pixA, pixB, ratio);
   // Return the mixed pixel
   return ret;
 }
 
+// Set 'dst' to the blend of 'pixA' and 'pixB' 
+// dst = (1 - blend) * pixA + blend * pixB
+// 'dst' may be 'pixA' or 'pixB'
+// Do nothing if arguments are invalid
+void TGAPixelBlendTo(TGAPixel *dst, TGAPixel *pixA, TGAPixel *pixB,
+  float blend) {
+  // Check arguments
+  if (dst == NULL || pixA == NULL || pixB == NULL || 
+    blend < 0.0 || blend > 1.0)
+    return;
+  // Declare a pixel for the result, as 'dst' may be an argument
+  TGAPixel ret;
+  // For each rgba value
+  for (int i = 4; i--;)
+    // Calculate the blended value
+    ret._rgba[i] = (1.0 - blend) * pixA->_rgba[i] + 
+      blend * pixB->_rgba[i];
+  // Set the result
+  *dst = ret;
+}
+
+// Set 'dst' to the addition of 'ratio' (in [0.0,1.0]) * 'pixB' 
+// to 'pixA'
+// 'dst' may be 'pixA' or 'pixB'
+// Do nothing if arguments are invalid
+void TGAPixelMixTo(TGAPixel *dst, TGAPixel *pixA, TGAPixel *pixB,
+  float ratio) {
+  // Check arguments
+  if (dst == NULL || pixA == NULL || pixB == NULL)
+    return;
+  // Declare a pixel for the result, transparent by default, as 'dst'
+  // may be an argument
+  TGAPixel ret = {{255, 255, 255, 0}};
+  // Declare a variable to memorize the opacity in [0,1]
+  float opA = (float)(pixA->_rgba[3]) / 255.0;
+  float opB = ratio * (float)(pixB->_rgba[3]) / 255.0;
+  // If both pixel are not transparent
+  if (opA + opB > 1.0 / 255.0) {
+    // For each rgb value
+    for (int i = 3; i--;) {
+      // Calculate the mixed value
+      float v = (opA * (float)(pixA->_rgba[i]) + 
+        opB * (float)(pixB->_rgba[i])) / (opA + opB);
+      ret._rgba[i] = (unsigned char)floor(v);
+    }
+    // Calculate mixed opacity (max of pixels opacity)
+    if (opA < opB)
+      ret._rgba[3] = (unsigned char)floor(opB * 255.0);
+    else
+      ret._rgba[3] = pixA->_rgba[3];
+  }
+  // Set the result
+  *dst = ret;
+}
+
 // Create a default TGAPencil with all color set to transparent
 // solid mode, thickness = 1.0, tip as facoid, no antialias
 // Return NULL if it couldn't allocate memory
@@ -1335,7 +5140,12 @@ TGAPencil* TGAGetPencil(void) {
     ret->_blend = 0.0;
     ret->_thickness = 1.0;
     ret->_antialias = false;
+    ret->_blendRampValid = false;
     ret->_tip = NULL;
+    for (int i = TGA_PENCILNBPHASE * TGA_PENCILNBPHASE; i--;) {
+      ret->_stamps[i]._hits = NULL;
+      ret->_stamps[i]._coverage = NULL;
+    }
     TGAPencilSetShapeSquare(ret);
   }
   // Return the new pencil
@@ -1348,6 +5158,8 @@ void TGAPencilFree(TGAPencil **pencil) {
   if (pencil == NULL || *pencil == NULL)
     return;
   // Free memory used by the pencil
+  ShapoidFree(&((*pencil)->_tip));
+  TGAPencilFreeStamps(*pencil);
   free(*pencil);
   *pencil = NULL;
 }
@@ -1364,11 +5176,48 @@ TGAPencil* TGAPencilClone(TGAPencil *pen) {
   if (ret != NULL) {
     // Copy the pencil in the clone
     memcpy(ret, pen, sizeof(TGAPencil));
+    // Clone the tip, the stamps are calculated again when needed
+    ret->_tip = ShapoidClone(pen->_tip);
+    for (int i = TGA_PENCILNBPHASE * TGA_PENCILNBPHASE; i--;) {
+      ret->_stamps[i]._hits = NULL;
+      ret->_stamps[i]._coverage = NULL;
+    }
+    // If we couldn't clone the tip
+    if (pen->_tip != NULL && ret->_tip == NULL) {
+      // Free memory
+      free(ret);
+      ret = NULL;
+    }
   }
   // Return the cloned pencil
   return ret;
 }
 
+// Return true if the TGAPencils 'a' and 'b' draw the same way (their
+// current blend is ignored as the drawing functions set it)
+bool TGAPencilIsSame(TGAPencil *a, TGAPencil *b) {
+  // Compare the properties of the pencils
+  if (memcmp(a->_colors, b->_colors, sizeof(a->_colors)) != 0 ||
+    a->_activeColor != b->_activeColor || 
+    a->_modeColor != b->_modeColor || a->_shape != b->_shape ||
+    a->_blendColor[0] != b->_blendColor[0] ||
+    a->_blendColor[1] != b->_blendColor[1] ||
+    a->_thickness != b->_thickness || a->_antialias != b->_antialias)
+    return false;
+  // Compare the tips
+  if (a->_tip == NULL || b->_tip == NULL)
+    return (a->_tip == b->_tip);
+  if (a->_tip->_type != b->_tip->_type || 
+    ShapoidGetDim(a->_tip) != ShapoidGetDim(b->_tip) ||
+    VecIsEqual(a->_tip->_pos, b->_tip->_pos) == false)
+    return false;
+  for (int iAxis = ShapoidGetDim(a->_tip); iAxis--;)
+    if (VecIsEqual(a->_tip->_axis[iAxis], b->_tip->_axis[iAxis]) == false)
+      return false;
+  // The pencils are the same
+  return true;
+}
+
 // Create a TGAPencil with 1st color active and set to black
 // Return NULL if it couldn't create
 TGAPencil* TGAGetBlackPencil(void) {
@@ -1387,63 +5236,219 @@ TGAPencil* TGAGetBlackPencil(void) {
       // Return NULL
       return NULL;
     }
-    // Set the color to the black pixel
-    TGAPencilSetColor(ret, pixel);
-    // Free memory used by the pixel
-    TGAPixelFree(&pixel);
+    // Set the color to the black pixel
+    TGAPencilSetColor(ret, pixel);
+    // Free memory used by the pixel
+    TGAPixelFree(&pixel);
+  }
+  // Return the new pencil
+  return ret;
+}
+
+// Select the active color of TGAPencil 'pen' to 'iCol'
+// Do nothing if arguments are invalid
+void TGAPencilSelectColor(TGAPencil *pen, int iCol) {
+  // Check arguments
+  if (pen == NULL || iCol < 0 || iCol >= TGA_NBCOLORPENCIL)
+    return;
+  // Set the active color
+  pen->_activeColor = iCol;
+}
+
+// Get the index of active color of TGAPencil 'pen'
+// Return -1 if arguments are invalid
+int TGAPencilGetColor(TGAPencil *pen) {
+  // Check arguments
+  if (pen == NULL)
+    return -1;
+  // Return the active color
+  return pen->_activeColor;
+}
+
+// Get a TGAPixel equal to the active color of the TGAPencil 'pen'
+// Return NULL if arguments are invalid
+TGAPixel* TGAPencilGetPixel(TGAPencil *pen) {
+  // Check arguments
+  if (pen == NULL)
+    return NULL;
+  // Get a white pixel
+  TGAPixel *ret = TGAGetWhitePixel();
+  // If we couldn't get the pixel
+  if (ret == NULL) {
+    // Return nuLL
+    return NULL;
+  }
+  // Set the pixel to the active color
+  TGAPencilGetPixelTo(pen, ret);
+  // Return the pixel
+  return ret;
+}
+
+// Set 'pix' to the active color of the TGAPencil 'pen'
+// In tgaPenBlend mode the color is the one precomputed for the 
+// nearest value of the blend
+// Do nothing if arguments are invalid
+void TGAPencilGetPixelTo(TGAPencil *pen, TGAPixel *pix) {
+  // Check arguments
+  if (pen == NULL || pix == NULL)
+    return;
+  // If the pen's color mode is tgaPenSolid
+  if (pen->_modeColor == tgaPenSolid) {
+    // Set the active color to the pixel 
+    *pix = pen->_colors[pen->_activeColor];
+  // Else, if the pen's color mode is tgaPenBlend
+  } else if (pen->_modeColor == tgaPenBlend) {
+    // If the ramp is not up to date
+    if (pen->_blendRampValid == false)
+      // Calculate the ramp
+      TGAPencilUpdateRamp(pen);
+    // Set the color of the ramp for the current blend to the pixel
+    int i = (int)round(pen->_blend * (float)(TGA_PENCILRAMPSIZE - 1));
+    *pix = pen->_blendRamp[i];
+  }
+}
+
+// Get the stamp of the tip of the TGAPencil 'pen' for the sub-pixel 
+// phase ('ix', 'iy'), calculating it if needed
+// Return NULL if we couldn't calculate the stamp
+TGAPencilStamp* TGAPencilGetStamp(TGAPencil *pen, int ix, int iy) {
+  // Set a pointer to the stamp
+  TGAPencilStamp *stamp = pen->_stamps + iy * TGA_PENCILNBPHASE + ix;
+  // If the stamp is already calculated
+  if (stamp->_hits != NULL)
+    // Return it
+    return stamp;
+  // If the pencil has no tip
+  if (pen->_tip == NULL)
+    return NULL;
+  // Declare the position at the center of the phase in the pixel
+  // (0,0) and variable for coordinates of pixel
+  VecFloat *pos = VecFloatCreate(2);
+  VecFloat *p = VecFloatCreate(2);
+  // Declare a clone of the pen tip
+  Shapoid *penTip = ShapoidClone(pen->_tip);
+  // Declare a Facoid to represent the pixel
+  Shapoid *pixel = FacoidCreate(2);
+  // If we couldn't allocate memory
+  if (pos == NULL || p == NULL || penTip == NULL || pixel == NULL) {
+    // Free memory and stop here
+    VecFree(&pos);
+    VecFree(&p);
+    ShapoidFree(&penTip);
+    ShapoidFree(&pixel);
+    return NULL;
+  }
+  // Translate the clone of the pen tip to the position
+  VecSet(pos, 0, ((float)ix + 0.5) / (float)TGA_PENCILNBPHASE);
+  VecSet(pos, 1, ((float)iy + 0.5) / (float)TGA_PENCILNBPHASE);
+  ShapoidTranslate(penTip, pos);
+  // Get the bounding box of the pen tip
+  Shapoid *tipBox = ShapoidGetBoundingBox(penTip);
+  // If we couldn't allocate memory
+  if (tipBox == NULL) {
+    // Free memory and stop here
+    VecFree(&pos);
+    VecFree(&p);
+    ShapoidFree(&penTip);
+    ShapoidFree(&pixel);
+    return NULL;
+  }
+  // Get the end pos of the tip box to avoid recalculate them
+  float end[2];
+  for (int i = 2; i--;)
+    end[i] = VecGet(tipBox->_pos, i) + VecGet(tipBox->_axis[i], i);
+  // Get the pixels of the stamp, from the pixel of the start to
+  // the one of the end of the tip box
+  stamp->_x = (short)floor(VecGet(tipBox->_pos, 0));
+  stamp->_y = (short)floor(VecGet(tipBox->_pos, 1));
+  stamp->_width = (short)floor(end[0] + TGA_EPSILON) - stamp->_x + 1;
+  stamp->_height = (short)floor(end[1] + TGA_EPSILON) - stamp->_y + 1;
+  // Allocate memory for the stamp
+  int size = stamp->_width * stamp->_height;
+  stamp->_hits = (unsigned char*)calloc(size, sizeof(unsigned char));
+  stamp->_coverage = (float*)calloc(size, sizeof(float));
+  // If we could allocate memory
+  if (stamp->_hits != NULL && stamp->_coverage != NULL) {
+    // Declare a variable to memorize the step in position
+    float delta = 0.5 * pen->_thickness;
+    if (delta > 1.0) delta = 1.0;
+    // For each position in the area affected by the pencil
+    for (VecSet(p, 0, VecGet(tipBox->_pos, 0)); 
+      VecGet(p, 0) < end[0] + TGA_EPSILON; 
+      VecSet(p, 0, VecGet(p, 0) + delta)) {
+      for (VecSet(p, 1, VecGet(tipBox->_pos, 1)); 
+        VecGet(p, 1) < end[1] + TGA_EPSILON; 
+        VecSet(p, 1, VecGet(p, 1) + delta)) {
+        // If the position is in the tip
+        if (ShapoidIsPosInside(penTip, p) == true) {
+          // Count one more hit for the pixel of this position
+          int i = ((int)floor(VecGet(p, 1)) - stamp->_y) * 
+            stamp->_width + (int)floor(VecGet(p, 0)) - stamp->_x;
+          if (stamp->_hits[i] < 255)
+            ++(stamp->_hits[i]);
+        }
+      }
+    }
+    // If the pencil uses antialias
+    if (pen->_antialias == true) {
+      // For each pixel hit by the tip
+      for (int i = 0; i < size; ++i) {
+        if (stamp->_hits[i] > 0) {
+          // Position the pixel Facoid
+          VecSet(pixel->_pos, 0, stamp->_x + i % stamp->_width);
+          VecSet(pixel->_pos, 1, stamp->_y + i / stamp->_width);
+          // Get the ratio coverage of this pixel by the pen tip
+          stamp->_coverage[i] = ShapoidGetCoverage(penTip, pixel);
+        }
+      }
+    }
+  // Else, we couldn't allocate memory
+  } else {
+    // Free memory
+    free(stamp->_hits);
+    free(stamp->_coverage);
+    stamp->_hits = NULL;
+    stamp->_coverage = NULL;
   }
-  // Return the new pencil
-  return ret;
-}
-
-// Select the active color of TGAPencil 'pen' to 'iCol'
-// Do nothing if arguments are invalid
-void TGAPencilSelectColor(TGAPencil *pen, int iCol) {
-  // Check arguments
-  if (pen == NULL || iCol < 0 || iCol >= TGA_NBCOLORPENCIL)
-    return;
-  // Set the active color
-  pen->_activeColor = iCol;
+  // Free memory
+  VecFree(&pos);
+  VecFree(&p);
+  ShapoidFree(&tipBox);
+  ShapoidFree(&pixel);
+  ShapoidFree(&penTip);
+  // Return the stamp
+  return (stamp->_hits != NULL ? stamp : NULL);
 }
 
-// Get the index of active color of TGAPencil 'pen'
-// Return -1 if arguments are invalid
-int TGAPencilGetColor(TGAPencil *pen) {
-  // Check arguments
-  if (pen == NULL)
-    return -1;
-  // Return the active color
-  return pen->_activeColor;
+// Free the stamps of the TGAPencil 'pen', they are calculated again
+// when needed
+void TGAPencilFreeStamps(TGAPencil *pen) {
+  // For each stamp
+  for (int i = TGA_PENCILNBPHASE * TGA_PENCILNBPHASE; i--;) {
+    // Free memory
+    free(pen->_stamps[i]._hits);
+    free(pen->_stamps[i]._coverage);
+    pen->_stamps[i]._hits = NULL;
+    pen->_stamps[i]._coverage = NULL;
+  }
 }
 
-// Get a TGAPixel equal to the active color of the TGAPencil 'pen'
-// Return NULL if arguments are invalid
-TGAPixel* TGAPencilGetPixel(TGAPencil *pen) {
-  // Check arguments
-  if (pen == NULL)
-    return NULL;
-  // Get a white pixel
-  TGAPixel *ret = TGAGetWhitePixel();
-  // If we couldn't get the pixel
-  if (ret == NULL) {
-    // Return nuLL
-    return NULL;
-  }
-  // If the pen's color mode is tgaPenSolid
-  if (pen->_modeColor == tgaPenSolid) {
-    // Set the active color to the pixel 
-    memcpy(ret, pen->_colors + pen->_activeColor, sizeof(TGAPixel));
-  // Else, if the pen's color mode is tgaPenBlend
-  } else if (pen->_modeColor == tgaPenBlend) {
-    // Calculate the current color
+// Calculate the colors of the blend ramp of the TGAPencil 'pen'
+void TGAPencilUpdateRamp(TGAPencil *pen) {
+  // Get the two blended colors
+  unsigned char *from = pen->_colors[pen->_blendColor[0]]._rgba;
+  unsigned char *to = pen->_colors[pen->_blendColor[1]]._rgba;
+  // For each color of the ramp
+  for (int i = 0; i < TGA_PENCILRAMPSIZE; ++i) {
+    // Get the blend value of this color
+    float blend = (float)i / (float)(TGA_PENCILRAMPSIZE - 1);
+    // Calculate the color
     for (int irgb = 0; irgb < 4; ++irgb)
-      ret->_rgba[irgb] = (unsigned char)round((1.0 - pen->_blend) * 
-        (float)(pen->_colors[pen->_blendColor[0]]._rgba[irgb]) + 
-        pen->_blend * 
-        (float)(pen->_colors[pen->_blendColor[1]]._rgba[irgb]));
+      pen->_blendRamp[i]._rgba[irgb] = (unsigned char)round(
+        (1.0 - blend) * (float)(from[irgb]) + blend * (float)(to[irgb]));
   }
-  // Return the pixel
-  return ret;
+  // The ramp is now up to date
+  pen->_blendRampValid = true;
 }
 
 // Set the active color of TGAPencil 'pen' to TGAPixel 'col'
@@ -1454,6 +5459,8 @@ void TGAPencilSetColor(TGAPencil *pen, TGAPixel *col) {
     return;
   // Set the color values
   memcpy(pen->_colors + pen->_activeColor, col, sizeof(TGAPixel));  
+  // The blend ramp may use this color
+  pen->_blendRampValid = false;
 }
 
 // Set the active color of TGAPencil 'pen' to 'rgba'
@@ -1465,6 +5472,8 @@ void TGAPencilSetColRGBA(TGAPencil *pen, unsigned char *rgba) {
   // Set the color values
   memcpy(&(pen->_colors[pen->_activeColor]._rgba), rgba, 
     sizeof(unsigned char) * 4);  
+  // The blend ramp may use this color
+  pen->_blendRampValid = false;
 }
 
 // Set the thickness of TGAPencil 'pen' to 'v'
@@ -1491,6 +5500,8 @@ void TGAPencilSetThickness(TGAPencil *pen, float v) {
   }
   // Set the thickness
   pen->_thickness = v;
+  // The stamps of the previous thickness are not valid anymore
+  TGAPencilFreeStamps(pen);
 }
 
 // Set the antialias of the TGAPencil 'pen' to 'v'
@@ -1501,6 +5512,8 @@ void TGAPencilSetAntialias(TGAPencil *pen, bool v) {
     return;
   // Setthe antialias
   pen->_antialias = v;
+  // The stamps of the previous antialias are not valid anymore
+  TGAPencilFreeStamps(pen);
 }
 
 // Set the blend value 'v' of the TGAPencil 'pen'
@@ -1527,6 +5540,8 @@ void TGAPencilSetShapeSquare(TGAPencil *pen) {
     // Stop here
     return;
   }
+  // The stamps of the previous tip are not valid anymore
+  TGAPencilFreeStamps(pen);
   // Set the shape
   pen->_shape = tgaPenShapoid;
   // Free the eventual actual shapoid
@@ -1570,6 +5585,8 @@ void TGAPencilSetShapeRound(TGAPencil *pen) {
     // Stop here
     return;
   }
+  // The stamps of the previous tip are not valid anymore
+  TGAPencilFreeStamps(pen);
   // Set the shape
   pen->_shape = tgaPenShapoid;
   // If there was a shapoid allocated for the pen tip
@@ -1611,6 +5628,8 @@ void TGAPencilSetShapeShapoid(TGAPencil *pen, Shapoid *shape) {
     // Stop here
     return;
   }
+  // The stamps of the previous tip are not valid anymore
+  TGAPencilFreeStamps(pen);
   // Set the shape
   pen->_shape = tgaPenShapoid;
   // If there was a shapoid allocated for the pen tip
@@ -1640,6 +5659,8 @@ void TGAPencilSetShapePixel(TGAPencil *pen) {
   // Check arguments
   if (pen == NULL)
     return;
+  // The stamps of the previous tip are not valid anymore
+  TGAPencilFreeStamps(pen);
   // Set the shape
   pen->_shape = tgaPenPixel;
   // If there was a shapoid allocated for the pen tip
@@ -1671,6 +5692,8 @@ void TGAPencilSetModeColorBlend(TGAPencil *pen, int fromCol, int toCol) {
   pen->_modeColor = tgaPenBlend;
   pen->_blendColor[0] = fromCol;
   pen->_blendColor[1] = toCol;
+  // The blend ramp must be calculated for these colors
+  pen->_blendRampValid = false;
 }
 
 // Function to decode rgba values when loading a TGA file
@@ -1733,39 +5756,37 @@ TGAPixel *TGAGetAverageColor(TGA *tga) {
   return pixel;
 }
 
-// Set the read only flag of a TGAPixel
+// Set the read only flag of the pixel at coord (x,y) = (pos[0],pos[1])
+// in the current layer of 'tga'
 // Do nothing if arguments are invalid
-void TGAPixelSetReadOnly(TGAPixel *pix, bool v) {
+void TGASetReadOnly(TGA *tga, VecShort *pos, bool v) {
   // Check arguments
-  if (pix == NULL)
+  if (tga == NULL)
     return;
-  pix->_readOnly = v;
+  // Set the flag in the current layer
+  TGALayerSetReadOnly(tga->_curLayer, pos, v);
 }
 
-// Set the read only flag of all the TGAPixel of a TGA
+// Set the read only flag of all the pixels in the current layer 
+// of 'tga'
 // Do nothing if arguments are invalid
 void TGAPixelSetAllReadOnly(TGA *tga, bool v) {
   // Check arguments
   if (tga == NULL)
     return;
-  VecShort *pos = VecShortCreate(2);
-  for (VecSet(pos, 0, 0); VecGet(pos, 0) < tga->_header->_width; 
-    VecSet(pos, 0, VecGet(pos, 0) + 1)) {
-    for (VecSet(pos, 1, 0); VecGet(pos, 1) < tga->_header->_width; 
-      VecSet(pos, 1, VecGet(pos, 1) + 1)) {
-      TGAPixelSetReadOnly(TGAGetPix(tga, pos), v);
-    }
-  }
-  VecFree(&pos);
+  // Set the flags in the current layer
+  TGALayerSetAllReadOnly(tga->_curLayer, v);
 }  
 
-// Get the read only flag of a TGAPixel
+// Get the read only flag of the pixel at coord (x,y) = 
+// (pos[0],pos[1]) in the current layer of 'tga'
 // Return true if arguments are invalid
-bool TGAPixelIsReadOnly(TGAPixel *pix) {
+bool TGAIsReadOnly(TGA *tga, VecShort *pos) {
   // Check arguments
-  if (pix == NULL)
+  if (tga == NULL)
     return true;
-  return pix->_readOnly;
+  // Get the flag in the current layer
+  return TGALayerIsReadOnly(tga->_curLayer, pos);
 }
 
 // Create a TGALayer of width dim[0] and height dim[1] and background
@@ -1786,6 +5807,9 @@ TGALayer* TGALayerCreate(VecShort *dim, TGAPixel *pixel) {
   // Set the pointers to NULL
   ret->_dim = NULL;
   ret->_pixels = NULL;
+  ret->_readOnly = NULL;
+  ret->_dirty = NULL;
+  ret->_clip = NULL;
   // Copy the dimensions
   ret->_dim = VecClone(dim);
   // If we couldn't allocate memory
@@ -1795,30 +5819,41 @@ TGALayer* TGALayerCreate(VecShort *dim, TGAPixel *pixel) {
     // Return NULL
     return NULL;
   }
-  // Allocate memory for the pixels
-  ret->_pixels = (TGAPixel*)malloc(VecGet(dim, 0) * VecGet(dim, 1) * 
-    sizeof(TGAPixel));
+  // Get the number of pixels
+  long nbPix = (long)VecGet(dim, 0) * (long)VecGet(dim, 1);
+  // Allocate memory for the pixels, and for their read only flags 
+  // initialized in read-write
+  ret->_pixels = (TGAPixel*)malloc(nbPix * sizeof(TGAPixel));
+  ret->_readOnly = (unsigned char*)calloc((nbPix + 7) / 8, 1);
+  // Allocate memory for the dirty box, the whole layer is considered
+  // as modified until it's cleaned, and the clip box, the whole layer
+  ret->_dirty = VecShortCreate(4);
+  ret->_clip = VecShortCreate(4);
   // If we couldn't allocate memory
-  if (ret->_pixels == NULL) {
+  if (ret->_pixels == NULL || ret->_readOnly == NULL || 
+    ret->_dirty == NULL || ret->_clip == NULL) {
     // Free the memory
-    VecFree(&(ret->_dim));
-    free(ret);
+    TGALayerFree(&ret);
     // Return NULL
     return NULL;
   }
+  VecSet(ret->_dirty, 0, 0);
+  VecSet(ret->_dirty, 1, 0);
+  VecSet(ret->_dirty, 2, VecGet(dim, 0) - 1);
+  VecSet(ret->_dirty, 3, VecGet(dim, 1) - 1);
+  VecCopy(ret->_clip, ret->_dirty);
   // Set a pointer to the pixels
   TGAPixel *p = ret->_pixels;
-  // For each pixel
-  for (int i = 0; i < VecGet(dim, 0) * VecGet(dim, 1); ++i) {
-    // For each value RGBA
-    for (int irgb = 0; irgb < 4; ++irgb)
+  // If there is no background color
+  if (pixel == NULL) {
+    // Initialize the values to 0
+    memset(p, 0, nbPix * sizeof(TGAPixel));
+  // Else, there is a background color
+  } else {
+    // For each pixel
+    for (long i = 0; i < nbPix; ++i)
       // Initialize the value
-      if (pixel != NULL)
-        p[i]._rgba[irgb] = pixel->_rgba[irgb];
-      else
-        p[i]._rgba[irgb] = 0;
-    // Initialize in read-write
-    p[i]._readOnly = false;
+      p[i] = *pixel;
   }
   // Return the created TGALayer
   return ret;
@@ -1843,20 +5878,27 @@ TGALayer* TGALayerClone(TGALayer *that) {
       // Return NULL
       return NULL;
     }
-    // Allocate memory for the pixels
-    ret->_pixels = (TGAPixel*)malloc(VecGet(that->_dim, 0) * 
-      VecGet(that->_dim, 1) * sizeof(TGAPixel));
+    // Get the number of pixels and the size of the read only flags
+    long nbPix = (long)VecGet(that->_dim, 0) * 
+      (long)VecGet(that->_dim, 1);
+    long sizeReadOnly = (nbPix + 7) / 8;
+    // Allocate memory for the pixels and the read only flags
+    ret->_pixels = (TGAPixel*)malloc(nbPix * sizeof(TGAPixel));
+    ret->_readOnly = (unsigned char*)malloc(sizeReadOnly);
+    // Clone the dirty box and the clip box
+    ret->_dirty = VecClone(that->_dirty);
+    ret->_clip = VecClone(that->_clip);
     // If we couldn't allocate memory
-    if (ret->_pixels == NULL) {
+    if (ret->_pixels == NULL || ret->_readOnly == NULL || 
+      ret->_dirty == NULL || ret->_clip == NULL) {
       // Free memory
-      VecFree(&(ret->_dim));
-      free(ret);
+      TGALayerFree(&ret);
       // Return NULL
       return NULL;
     }
-    // Copy the pixels
-    memcpy(ret->_pixels, that->_pixels, VecGet(that->_dim, 0) * 
-      VecGet(that->_dim, 1) * sizeof(TGAPixel));
+    // Copy the pixels and the read only flags
+    memcpy(ret->_pixels, that->_pixels, nbPix * sizeof(TGAPixel));
+    memcpy(ret->_readOnly, that->_readOnly, sizeReadOnly);
   }
   // Return the cloned TGA
   return ret;
@@ -1870,6 +5912,9 @@ void TGALayerFree(TGALayer **that) {
   // Free the memory
   VecFree(&((*that)->_dim));
   TGAPixelFree(&((*that)->_pixels));
+  free((*that)->_readOnly);
+  VecFree(&((*that)->_dirty));
+  VecFree(&((*that)->_clip));
   free(*that);
   *that = NULL;
 }
@@ -1923,49 +5968,52 @@ void TGALayerBlend(TGALayer *that, TGALayer *tho, VecShort *bound) {
     VecSet(bound, 2, VecGet(that->_dim, 0) - 1);
     VecSet(bound, 3, VecGet(that->_dim, 1) - 1);
   }
-  // Create a vector for looping on the pixels
-  VecShort *pos = VecShortCreate(2);
-  // If we couldn't allocate memory or the bounding box is invalid
-  if (bound == NULL || pos == NULL || VecGet(bound, 0) > VecGet(bound, 2) || VecGet(bound, 1) > VecGet(bound, 3)) {
-    VecFree(&pos);
-    if (flagBound == true)
-      VecFree(&bound);
-  }
-  // Loop on the pixels
-  for (VecSet(pos, 0, VecGet(bound, 0)); 
-    VecGet(pos, 0) <= VecGet(bound, 2);
-    VecSet(pos, 0, VecGet(pos, 0) + 1)) {
-    for (VecSet(pos, 1, VecGet(bound, 1)); 
-      VecGet(pos, 1) <= VecGet(bound, 3);
-      VecSet(pos, 1, VecGet(pos, 1) + 1)) {
+  // If we couldn't allocate memory
+  if (bound == NULL)
+    return;
+  // Get the bounding box clipped to the clip box of 'that'
+  long x0 = (VecGet(bound, 0) > VecGet(that->_clip, 0) ? 
+    VecGet(bound, 0) : VecGet(that->_clip, 0));
+  long y0 = (VecGet(bound, 1) > VecGet(that->_clip, 1) ? 
+    VecGet(bound, 1) : VecGet(that->_clip, 1));
+  long x1 = (VecGet(bound, 2) < VecGet(that->_clip, 2) ? 
+    VecGet(bound, 2) : VecGet(that->_clip, 2));
+  long y1 = (VecGet(bound, 3) < VecGet(that->_clip, 3) ? 
+    VecGet(bound, 3) : VecGet(that->_clip, 3));
+  long width = VecGet(that->_dim, 0);
+  // Free memory
+  if (flagBound == true)
+    VecFree(&bound);
+  // If the bounding box is empty there is nothing to blend
+  if (x0 > x1 || y0 > y1)
+    return;
+  // Add the box to the modified area of 'that'
+  TGALayerAddDirty(that, x0, y0, x1, y1);
+  // Loop on the pixels, by rows
+  for (long y = y0; y <= y1; ++y) {
+    for (long x = x0; x <= x1; ++x) {
       // Get the pixel in each layer
-      TGAPixel *pixThat = TGALayerGetPix(that, pos);
-      TGAPixel *pixTho = TGALayerGetPix(tho, pos);
-      // If both pixel exists and the one in 'that' is not readonly
-      if (pixThat != NULL && pixTho != NULL &&
-        TGAPixelIsReadOnly(pixThat) == false) {
-        TGAPixel *pixBlend = TGAPixelBlend(pixThat, pixTho, 
+      long i = y * width + x;
+      TGAPixel *pixThat = that->_pixels + i;
+      TGAPixel *pixTho = tho->_pixels + i;
+      // If the pixel in 'tho' is not transparent and the one in 
+      // 'that' is not readonly
+      if (pixTho->_rgba[3] != 0 && 
+        ((that->_readOnly[i >> 3] >> (i & 7)) & 1) == 0) {
+        TGAPixel pixBlend;
+        TGAPixelBlendTo(&pixBlend, pixThat, pixTho, 
           (float)(pixTho->_rgba[3]) / 255.0);
-        // If we could blend the pixel
-        if (pixBlend != NULL) {
-          // Correct the opacity of the blended pixel
-          if (255.0 - (float)(pixThat->_rgba[3]) > 
-            (float)(pixTho->_rgba[3]))
-            pixBlend->_rgba[3] = pixThat->_rgba[3] + pixTho->_rgba[3];
-          else
-            pixBlend->_rgba[3] = 255.0;
-          // Copy the resulting pixel in 'that'
-          TGALayerSetPix(that, pos, pixBlend);
-        }
-        // Free memory
-        TGAPixelFree(&pixBlend);
+        // Correct the opacity of the blended pixel
+        if (255.0 - (float)(pixThat->_rgba[3]) > 
+          (float)(pixTho->_rgba[3]))
+          pixBlend._rgba[3] = pixThat->_rgba[3] + pixTho->_rgba[3];
+        else
+          pixBlend._rgba[3] = 255.0;
+        // Copy the resulting pixel in 'that'
+        *pixThat = pixBlend;
       }
     }
   }
-  // Free memory
-  VecFree(&pos);
-  if (flagBound == true)
-    VecFree(&bound);
 }
 
 // Get a pointer to the pixel at coord (x,y) = (pos[0],pos[1]) 
@@ -1998,9 +6046,55 @@ void TGALayerSetPix(TGALayer *that, VecShort *pos, TGAPixel *pix) {
   // Set a pointer to the pixels
   TGAPixel *p = TGALayerGetPix(that, pos);
   // If the pixel is not null and not in read only mode
-  if (p != NULL && TGAPixelIsReadOnly(p) == false) 
+  if (p != NULL && TGALayerIsReadOnly(that, pos) == false) {
     // Set the value of the pixel
     memcpy(p, pix, sizeof(TGAPixel));
+    // Add the pixel to the modified area of the layer
+    TGALayerAddDirty(that, VecGet(pos, 0), VecGet(pos, 1), 
+      VecGet(pos, 0), VecGet(pos, 1));
+  }
+}
+
+// Set the read only flag of the pixel at coord (x,y) = (pos[0],pos[1])
+// in the layer 'that'
+// Do nothing if arguments are invalid
+void TGALayerSetReadOnly(TGALayer *that, VecShort *pos, bool v) {
+  // Check arguments
+  if (TGALayerIsPosInside(that, pos) == false)
+    return;
+  // Calculate the index of the requested pixel
+  long i = (long)VecGet(pos, 1) * (long)VecGet(that->_dim, 0) + 
+    (long)VecGet(pos, 0);
+  // Set the flag
+  if (v == true)
+    that->_readOnly[i >> 3] |= (unsigned char)(1 << (i & 7));
+  else
+    that->_readOnly[i >> 3] &= (unsigned char)~(1 << (i & 7));
+}
+
+// Set the read only flag of all the pixels in the layer 'that'
+// Do nothing if arguments are invalid
+void TGALayerSetAllReadOnly(TGALayer *that, bool v) {
+  // Check arguments
+  if (that == NULL)
+    return;
+  // Set all the flags, including the unused bits of the last byte
+  long nbPix = (long)VecGet(that->_dim, 0) * (long)VecGet(that->_dim, 1);
+  memset(that->_readOnly, (v == true ? 0xFF : 0), (nbPix + 7) / 8);
+}
+
+// Get the read only flag of the pixel at coord (x,y) = 
+// (pos[0],pos[1]) in the layer 'that'
+// Return true if arguments are invalid
+bool TGALayerIsReadOnly(TGALayer *that, VecShort *pos) {
+  // Check arguments
+  if (TGALayerIsPosInside(that, pos) == false)
+    return true;
+  // Calculate the index of the requested pixel
+  long i = (long)VecGet(pos, 1) * (long)VecGet(that->_dim, 0) + 
+    (long)VecGet(pos, 0);
+  // Return the flag
+  return ((that->_readOnly[i >> 3] >> (i & 7)) & 1);
 }
 
 // Add the BCurve 'curve' (must be of dimension 2 and order > 0)
@@ -2009,92 +6103,871 @@ void TGALayerSetPix(TGALayer *that, VecShort *pos, TGAPixel *pix) {
 void TGALayerAddCurve(TGALayer *layer, BCurve *curve, TGAPencil *pen) {
   // Check arguments
   if (layer == NULL || curve == NULL || pen == NULL || 
-    BCurveOrder(curve) < 1)
+    BCurveOrder(curve) < 1 || BCurveDim(curve) != 2)
     return;
-  // GetThe approximate length of the curve
-  float l = BCurveApproxLen(curve);
-  // Declare a variable to memorize the step of the parameter of 
-  // the BCurve
-  float dt = 1.0 / l;
-  // Declare the parameter of the curve
-  float t = 0.0;
-  // Declare the parameter value of last drawn pixel
-  float lastT = t;
-  // Declare a variable to memorize the position on the curve
-  VecFloat *pos = VecClone(curve->_ctrl[0]);
-  // Declare a variable to memorize the last pixel stroke to avoid
-  // stroking several time the same pixel as dt is underestimated
-  VecFloat *prevPos = VecClone(pos);
-  if (prevPos == NULL)
-    return;
-  // Set the blend value of the pencil to calculate the pencil 
-  // current color
-  TGAPencilSetBlend(pen, 0.0);
-  // Stroke the first pixel
-  TGALayerStrokePix(layer, curve->_ctrl[0], pen);  
-  // While we haven't reached the end of the curve
-  while (t < 1.0 + dt) {
-    // Calculate the current position on the curve
-    VecFree(&pos);
-    pos = BCurveGet(curve, t);
-    // Declare a variable to memorize the pixel distance to the previous
-    // drawn pixel
-    float pixelDist = VecPixelDist(prevPos, pos);
-    // Declare a flag to memorize if we need to draw the current pixel
-    bool flagDraw = false;
-    // If we are still on the previous pixel
-    if (pixelDist < 0.5) {
-      // Update the position of the last stroke pixel
-      VecCopy(prevPos, pos);
-      // Update the parameter value of last drawn pixel
-      lastT = t;
-      // Move along the curve by dt
-      t += dt;
-    // Else, we have moved to a different pixel
+  // Get the order of the curve
+  int order = BCurveOrder(curve);
+  // Get the maximum norm of the second differences of the control 
+  // points, the distance between the curve and the polyline joining
+  // the points at 'nbSeg' uniform steps of its parameter is lower 
+  // than order.(order - 1).dd / (8.nbSeg^2)
+  float dd = 0.0;
+  for (int i = 0; i + 2 <= order; ++i) {
+    float d[2];
+    for (int j = 2; j--;)
+      d[j] = VecGet(curve->_ctrl[i + 2], j) - 
+        2.0 * VecGet(curve->_ctrl[i + 1], j) + 
+        VecGet(curve->_ctrl[i], j);
+    float n = sqrt(d[0] * d[0] + d[1] * d[1]);
+    if (n > dd) dd = n;
+  }
+  // Get the number of segments of the polyline to be at a distance 
+  // lower than TGA_FLATNESS from the curve
+  int nbSeg = (int)ceil(sqrt((float)(order * (order - 1)) * dd / 
+    (8.0 * TGA_FLATNESS)));
+  if (nbSeg < 1) nbSeg = 1;
+  if (nbSeg > TGA_MAXNBSEGMENT) nbSeg = TGA_MAXNBSEGMENT;
+  // Allocate memory for the points of the polyline and their blend,
+  // and for the forward differences of the curve
+  float *pts = (float*)malloc(3 * (nbSeg + 1) * sizeof(float));
+  double *diff = (double*)malloc(4 * (order + 1) * sizeof(double));
+  // If we couldn't allocate memory
+  if (pts == NULL || diff == NULL) {
+    // Free memory and stop here
+    free(pts);
+    free(diff);
+    return;
+  }
+  float *blend = pts + 2 * (nbSeg + 1);
+  double *w = diff + 2 * (order + 1);
+  // Get the first (order + 1) points of the polyline with the 
+  // De Casteljau's algorithm
+  for (int k = 0; k <= order; ++k) {
+    double t = (double)k / (double)nbSeg;
+    for (int i = 0; i <= order; ++i)
+      for (int j = 2; j--;)
+        w[2 * i + j] = VecGet(curve->_ctrl[i], j);
+    for (int l = 1; l <= order; ++l)
+      for (int i = 0; i <= order - l; ++i)
+        for (int j = 2; j--;)
+          w[2 * i + j] = 
+            (1.0 - t) * w[2 * i + j] + t * w[2 * (i + 1) + j];
+    for (int j = 2; j--;)
+      diff[2 * k + j] = w[j];
+  }
+  // Convert them into the forward differences at the first point
+  for (int l = 1; l <= order; ++l)
+    for (int k = order; k >= l; --k)
+      for (int j = 2; j--;)
+        diff[2 * k + j] -= diff[2 * (k - 1) + j];
+  // Get the points of the polyline by forward differencing, the 
+  // blend of the pencil is the parameter of the curve
+  for (int k = 0; k <= nbSeg; ++k) {
+    for (int j = 2; j--;)
+      pts[2 * k + j] = diff[j];
+    blend[k] = (float)k / (float)nbSeg;
+    for (int l = 0; l < order; ++l)
+      for (int j = 2; j--;)
+        diff[2 * l + j] += diff[2 * (l + 1) + j];
+  }
+  // Set exactly the ends of the polyline on the ends of the curve
+  for (int j = 2; j--;) {
+    pts[j] = VecGet(curve->_ctrl[0], j);
+    pts[2 * nbSeg + j] = VecGet(curve->_ctrl[order], j);
+  }
+  // Draw the polyline
+  TGALayerAddPolyline(layer, pts, blend, nbSeg + 1, pen);
+  // Free memory
+  free(pts);
+  free(diff);
+}
+
+// Get the interval ['from','to'] of abscissa of the points of the 
+// Shapoid 's' (of dimension 2) at ordinate 'y'
+// 'inv' is the inverse of the matrix of the axis of 's' (row major)
+// Return false if the Shapoid has no point at ordinate 'y'
+bool TGAShapoidGetSpan(Shapoid *s, float *inv, float y, 
+  float *from, float *to) {
+  // The coordinates in the Shapoid space of the point at abscissa
+  // (pos[0] + x) and ordinate 'y' are (a[i] + b[i] * x)
+  float dy = y - VecGet(s->_pos, 1);
+  float a[2] = {inv[1] * dy, inv[3] * dy};
+  float b[2] = {inv[0], inv[2]};
+  // Declare the interval of x, unbounded at first
+  float lo = -HUGE_VALF;
+  float hi = HUGE_VALF;
+  // Declare the linear constraints min <= c + d * x <= max defining
+  // the Shapoid
+  float c[3], d[3], min[3], max[3];
+  int nbConstraint = 0;
+  // If the Shapoid is a Facoid, its coordinates are in [0,1]
+  if (s->_type == ShapoidTypeFacoid) {
+    for (int i = 0; i < 2; ++i) {
+      c[i] = a[i]; d[i] = b[i]; min[i] = 0.0; max[i] = 1.0;
+    }
+    nbConstraint = 2;
+  // Else, if the Shapoid is a Pyramidoid, its coordinates are 
+  // positive and their sum is lower than 1
+  } else if (s->_type == ShapoidTypePyramidoid) {
+    for (int i = 0; i < 2; ++i) {
+      c[i] = a[i]; d[i] = b[i]; min[i] = 0.0; max[i] = HUGE_VALF;
+    }
+    c[2] = a[0] + a[1]; d[2] = b[0] + b[1]; 
+    min[2] = -HUGE_VALF; max[2] = 1.0;
+    nbConstraint = 3;
+  // Else, if the Shapoid is a Spheroid, the norm of its coordinates
+  // is lower than 0.5
+  } else if (s->_type == ShapoidTypeSpheroid) {
+    // Solve qa.x^2 + qb.x + qc <= 0
+    float qa = b[0] * b[0] + b[1] * b[1];
+    float qb = 2.0 * (a[0] * b[0] + a[1] * b[1]);
+    float qc = a[0] * a[0] + a[1] * a[1] - 0.25;
+    float delta = qb * qb - 4.0 * qa * qc;
+    if (qa == 0.0 || delta < 0.0)
+      return false;
+    lo = (-qb - sqrt(delta)) / (2.0 * qa);
+    hi = (-qb + sqrt(delta)) / (2.0 * qa);
+  // Else, the Shapoid is invalid
+  } else {
+    return false;
+  }
+  // Intersect the interval with each linear constraint
+  for (int i = 0; i < nbConstraint; ++i) {
+    // If the constraint doesn't depend on x
+    if (d[i] == 0.0) {
+      // If the constraint is not satisfied, there is no point at 
+      // this ordinate
+      if (c[i] < min[i] || c[i] > max[i])
+        return false;
+    // Else, the constraint is satisfied on an interval of x
     } else {
-      // If we are on a side pixel
-      if (pixelDist < 1.5) {
-        // We are good to draw
-        flagDraw = true;
-      // Else, we are at a pixel distance of more than 2.0
-      // It means we jumped over, or moved in diagonal
-      } else {
-        // If we are on a diagonal pixel
-        if (abs((int)floor(VecGet(pos, 0)) - 
-          (int)floor(VecGet(prevPos, 0))) <= 1 && 
-          abs((int)floor(VecGet(pos, 1)) - 
-          (int)floor(VecGet(prevPos, 1))) <= 1) {
-          // We are good to draw
-          flagDraw = true;
-        // Else, we have jump over a pixel
+      float t0 = (min[i] - c[i]) / d[i];
+      float t1 = (max[i] - c[i]) / d[i];
+      if (t0 > t1) {
+        float t = t0;
+        t0 = t1;
+        t1 = t;
+      }
+      if (t0 > lo) lo = t0;
+      if (t1 < hi) hi = t1;
+    }
+  }
+  // If the interval is empty
+  if (lo > hi)
+    return false;
+  // Return the interval
+  *from = VecGet(s->_pos, 0) + lo;
+  *to = VecGet(s->_pos, 0) + hi;
+  return true;
+}
+
+// Get in 'inv' the inverse of the matrix of the axis of the Shapoid
+// 's' (of dimension 2), row major
+// Return false if the Shapoid is degenerated
+bool TGAShapoidGetInverse(Shapoid *s, float *inv) {
+  // Get the determinant of the matrix
+  float det = VecGet(s->_axis[0], 0) * VecGet(s->_axis[1], 1) - 
+    VecGet(s->_axis[1], 0) * VecGet(s->_axis[0], 1);
+  // If the Shapoid is degenerated
+  if (fabs(det) < TGA_EPSILON)
+    return false;
+  // Calculate the inverse
+  inv[0] = VecGet(s->_axis[1], 1) / det;
+  inv[1] = -VecGet(s->_axis[1], 0) / det;
+  inv[2] = -VecGet(s->_axis[0], 1) / det;
+  inv[3] = VecGet(s->_axis[0], 0) / det;
+  return true;
+}
+
+// Fill the Shapoid 's' (of dimension 2) with the pencil 'pen' in the 
+// layer 'that', row by row along the spans of the Shapoid
+// If the pencil is a pixel with antialias the pixels are mixed 
+// according to their coverage by the Shapoid, else each position 
+// inside the Shapoid at integer distance from the origin of its
+// bounding box is stroked
+// Do nothing if arguments are invalid
+void TGALayerFillShapoid(TGALayer *that, Shapoid *s, TGAPencil *pen) {
+  // Check arguments
+  if (that == NULL || s == NULL || pen == NULL || 
+    ShapoidGetDim(s) != 2)
+    return;
+  // If the pencil is a pixel
+  if (pen->_shape == tgaPenPixel) {
+    // Fill the pixels of the Shapoid
+    TGALayerFillShapoidPix(that, s, NULL, pen, NULL);
+    return;
+  }
+  // Get the inverse of the matrix of the axis of the Shapoid
+  float inv[4];
+  // If the Shapoid is degenerated there is nothing to fill
+  if (TGAShapoidGetInverse(s, inv) == false)
+    return;
+  // Get the bounding box of the Shapoid
+  Shapoid *bounding = ShapoidGetBoundingBox(s);
+  // Declare a variable to memorize the position of the strokes
+  VecFloat *pos = VecFloatCreate(2);
+  // If we couldn't allocate memory
+  if (bounding == NULL || pos == NULL) {
+    // Free memory and stop here
+    ShapoidFree(&bounding);
+    VecFree(&pos);
+    return;
+  }
+  // Get the origin and the number of rows of the grid
+  float x0 = VecGet(bounding->_pos, 0);
+  float y0 = VecGet(bounding->_pos, 1);
+  int nbY = (int)floor(VecGet(bounding->_axis[1], 1) + PBMATH_EPSILON);
+  // Get the box of the positions whose stroke can modify pixels in 
+  // the clip box of the layer, from the extent of the tip
+  float clip[4];
+  for (int i = 2; i--;) {
+    float n[2] = {0.0, 0.0};
+    float kMin[2], kMax[2];
+    n[i] = 1.0;
+    TGAShapoidGetSupport(pen->_tip, n, kMin, kMax);
+    clip[i] = (float)VecGet(that->_clip, i) - 1.0 - kMax[i];
+    clip[2 + i] = (float)VecGet(that->_clip, 2 + i) + 2.0 - kMin[i];
+  }
+  // For each row of the grid
+  for (int j = 0; j <= nbY; ++j) {
+    // Get the span of the Shapoid on this row
+    float y = y0 + (float)j;
+    float from, to;
+    if (y < clip[1] || y > clip[3] || 
+      TGAShapoidGetSpan(s, inv, y, &from, &to) == false)
+      continue;
+    // Clip the span
+    if (from < clip[0]) from = clip[0];
+    if (to > clip[2]) to = clip[2];
+    // For each position of the grid in the span
+    int kTo = (int)floor(to - x0 + TGA_EPSILON);
+    for (int k = (int)ceil(from - x0 - TGA_EPSILON); k <= kTo; ++k) {
+      VecSet(pos, 0, x0 + (float)k);
+      VecSet(pos, 1, y);
+      // Set the blend of the pencil with the depth of the pos 
+      // in the shapoid for the case the pencil is in 
+      // tgaPenBlend mode
+      if (pen->_modeColor == tgaPenBlend)
+        TGAPencilSetBlend(pen, 1.0 - ShapoidGetPosDepth(s, pos));
+      // Stroke the position
+      TGALayerStrokePixShapoid(that, pos, pen);
+    }
+  }
+  // Free memory
+  ShapoidFree(&bounding);
+  VecFree(&pos);
+}
+
+// Mix the pixels inside the Shapoid 's' (of dimension 2) of the 
+// layer 'that' with the color of the pencil 'pen', whatever its shape
+// If the pencil uses antialias the pixels are mixed according to 
+// their coverage by the Shapoid, else the pixels containing a 
+// position inside the Shapoid at integer distance from 'org' (the
+// origin of the bounding box of the Shapoid if 'org' is NULL) are 
+// mixed
+// In tgaPenBlend mode, the blend of the pencil goes from 'blend[0]'
+// to 'blend[1]' along the first axis of the Shapoid if 'blend' is not
+// NULL, else it's 1.0 minus the depth of the position in the Shapoid
+void TGALayerFillShapoidPix(TGALayer *that, Shapoid *s, float *org,
+  TGAPencil *pen, float *blend) {
+  // Get the inverse of the matrix of the axis of the Shapoid
+  float inv[4];
+  // If the Shapoid is degenerated there is nothing to fill
+  if (TGAShapoidGetInverse(s, inv) == false)
+    return;
+  // Get the bounding box of the Shapoid
+  Shapoid *bounding = ShapoidGetBoundingBox(s);
+  // Declare a variable to memorize the position in the Shapoid
+  VecFloat *pos = VecFloatCreate(2);
+  // If we couldn't allocate memory
+  if (bounding == NULL || pos == NULL) {
+    // Free memory and stop here
+    ShapoidFree(&bounding);
+    VecFree(&pos);
+    return;
+  }
+  // Get the width of the layer and its clip box
+  int width = VecGet(that->_dim, 0);
+  int clip[4];
+  for (int i = 4; i--;)
+    clip[i] = VecGet(that->_clip, i);
+  // If the Shapoid is outside the clip box, there is nothing to fill
+  if (VecGet(bounding->_pos, 0) > clip[2] + 1 || 
+    VecGet(bounding->_pos, 1) > clip[3] + 1 ||
+    VecGet(bounding->_pos, 0) + VecGet(bounding->_axis[0], 0) < 
+      clip[0] - 1 ||
+    VecGet(bounding->_pos, 1) + VecGet(bounding->_axis[1], 1) < 
+      clip[1] - 1) {
+    // Free memory and stop here
+    ShapoidFree(&bounding);
+    VecFree(&pos);
+    return;
+  }
+  // Get the color of the pencil, and the result of its mix with a 
+  // transparent pixel to set directly the transparent pixels fully 
+  // covered by the Shapoid when the color is constant
+  bool modeBlend = (pen->_modeColor == tgaPenBlend);
+  TGAPixel pix;
+  TGAPencilGetPixelTo(pen, &pix);
+  TGAPixel solid = {{0, 0, 0, 0}};
+  TGAPixelMixTo(&solid, &solid, &pix, 1.0);
+  // If the pencil uses antialias
+  if (pen->_antialias == true) {
+    // Get the pixels covered by the bounding box, clipped to the clip
+    // box of the layer
+    int xFrom = (int)floor(VecGet(bounding->_pos, 0));
+    int yFrom = (int)floor(VecGet(bounding->_pos, 1));
+    int xTo = (int)floor(VecGet(bounding->_pos, 0) + 
+      VecGet(bounding->_axis[0], 0));
+    int yTo = (int)floor(VecGet(bounding->_pos, 1) + 
+      VecGet(bounding->_axis[1], 1));
+    if (xFrom < clip[0]) xFrom = clip[0];
+    if (yFrom < clip[1]) yFrom = clip[1];
+    if (xTo > clip[2]) xTo = clip[2];
+    if (yTo > clip[3]) yTo = clip[3];
+    // Allocate memory for the coverage of the pixels of one row
+    float *coverage = NULL;
+    if (xFrom <= xTo)
+      coverage = (float*)malloc((xTo - xFrom + 1) * sizeof(float));
+    // For each row of pixels
+    for (int y = yFrom; y <= yTo && coverage != NULL; ++y) {
+      // Reset the coverage and the covered pixels of the row
+      for (int x = xFrom; x <= xTo; ++x)
+        coverage[x - xFrom] = 0.0;
+      int cFrom = xTo + 1;
+      int cTo = xFrom - 1;
+      // For each sub-row of the row
+      for (int iSub = 0; iSub < TGA_PENCILNBPHASE; ++iSub) {
+        // Get the span of the Shapoid on this sub-row
+        float from, to;
+        float sy = (float)y + 
+          ((float)iSub + 0.5) / (float)TGA_PENCILNBPHASE;
+        if (TGAShapoidGetSpan(s, inv, sy, &from, &to) == false)
+          continue;
+        // Clip the span to the row
+        if (from < (float)xFrom) from = (float)xFrom;
+        if (to > (float)(xTo + 1)) to = (float)(xTo + 1);
+        if (from >= to)
+          continue;
+        int pFrom = (int)floor(from);
+        int pTo = (int)floor(to);
+        if (pTo > xTo) pTo = xTo;
+        if (pFrom < cFrom) cFrom = pFrom;
+        if (pTo > cTo) cTo = pTo;
+        // Add the part of each pixel covered by the span
+        for (int x = pFrom; x <= pTo; ++x) {
+          float l = (from > (float)x ? from : (float)x);
+          float r = (to < (float)(x + 1) ? to : (float)(x + 1));
+          if (r > l)
+            coverage[x - xFrom] += (r - l) / (float)TGA_PENCILNBPHASE;
+        }
+      }
+      // If no pixel is covered in this row
+      if (cFrom > cTo)
+        continue;
+      // Add the covered pixels to the modified area of the layer
+      TGALayerAddDirty(that, cFrom, y, cTo, y);
+      // For each covered pixel
+      for (int x = cFrom; x <= cTo; ++x) {
+        float c = coverage[x - xFrom];
+        long i = (long)y * (long)width + (long)x;
+        // If the pixel is not covered or in read only mode, skip it
+        if (c <= 0.0 || ((that->_readOnly[i >> 3] >> (i & 7)) & 1))
+          continue;
+        if (c > 1.0 - TGA_EPSILON)
+          c = 1.0;
+        TGAPixel *p = that->_pixels + i;
+        // If the pencil is in blend mode
+        if (modeBlend == true) {
+          // Get the color for the center of the pixel
+          VecSet(pos, 0, (float)x + 0.5);
+          VecSet(pos, 1, (float)y + 0.5);
+          TGAPencilSetBlend(pen, 
+            TGAShapoidGetPosBlend(s, inv, pos, blend));
+          TGAPencilGetPixelTo(pen, &pix);
+          TGAPixelMixTo(p, p, &pix, c);
+        // Else, if the pixel is fully covered and transparent
+        } else if (c == 1.0 && p->_rgba[3] == 0) {
+          // Set directly the pixel
+          *p = solid;
+        // Else, mix the pixel according to its coverage
+        } else {
+          TGAPixelMixTo(p, p, &pix, c);
+        }
+      }
+    }
+    // Free memory
+    free(coverage);
+  // Else, mix the pixels of the positions of the grid inside the
+  // Shapoid
+  } else {
+    // Get the origin of the grid and its rows in the bounding box
+    float x0 = (org != NULL ? org[0] : VecGet(bounding->_pos, 0));
+    float y0 = (org != NULL ? org[1] : VecGet(bounding->_pos, 1));
+    int jFrom = (int)ceil(VecGet(bounding->_pos, 1) - y0 - TGA_EPSILON);
+    int jTo = (int)floor(VecGet(bounding->_pos, 1) + 
+      VecGet(bounding->_axis[1], 1) - y0 + PBMATH_EPSILON);
+    // Skip the rows of the grid outside the clip box
+    if (jFrom < (int)floor(clip[1] - y0))
+      jFrom = (int)floor(clip[1] - y0);
+    if (jTo > (int)ceil(clip[3] + 1 - y0))
+      jTo = (int)ceil(clip[3] + 1 - y0);
+    // For each row of the grid
+    for (int j = jFrom; j <= jTo; ++j) {
+      // Get the span of the Shapoid on this row
+      float y = y0 + (float)j;
+      float from, to;
+      if (TGAShapoidGetSpan(s, inv, y, &from, &to) == false)
+        continue;
+      // Get the pixels of the positions of the grid in the span, 
+      // clipped to the clip box of the layer
+      int kFrom = (int)ceil(from - x0 - TGA_EPSILON);
+      int kTo = (int)floor(to - x0 + TGA_EPSILON);
+      int py = (int)floor(y);
+      int px = (int)floor(x0);
+      if (px + kFrom < clip[0]) kFrom = clip[0] - px;
+      if (px + kTo > clip[2]) kTo = clip[2] - px;
+      if (py < clip[1] || py > clip[3] || kFrom > kTo)
+        continue;
+      // Add the span to the modified area of the layer
+      TGALayerAddDirty(that, px + kFrom, py, px + kTo, py);
+      // For each pixel of the span
+      for (int k = kFrom; k <= kTo; ++k) {
+        long i = (long)py * (long)width + (long)(px + k);
+        // If the pixel is in read only mode, skip it
+        if ((that->_readOnly[i >> 3] >> (i & 7)) & 1)
+          continue;
+        TGAPixel *p = that->_pixels + i;
+        // If the pencil is in blend mode
+        if (modeBlend == true) {
+          // Get the color for the position
+          VecSet(pos, 0, x0 + (float)k);
+          VecSet(pos, 1, y);
+          TGAPencilSetBlend(pen, 
+            TGAShapoidGetPosBlend(s, inv, pos, blend));
+          TGAPencilGetPixelTo(pen, &pix);
+          TGAPixelMixTo(p, p, &pix, 1.0);
+        // Else, if the pixel is transparent
+        } else if (p->_rgba[3] == 0) {
+          // Set directly the pixel
+          *p = solid;
+        // Else, mix the pixel with the pencil
         } else {
-          // Move back to cancel the jump over pixel
-          t -= (t - lastT) * 0.9;
+          TGAPixelMixTo(p, p, &pix, 1.0);
         }
       }
     }
-    // If we are good to draw
-    if (flagDraw == true) {
-      // Set the blend value of the pencil to calculate the pencil 
-      // current color
-      TGAPencilSetBlend(pen, t);
-      // Stroke the pixel
-      TGALayerStrokePix(layer, pos, pen);
-      // Update the position of the last stroke pixel
-      VecCopy(prevPos, pos);
-      // Update the parameter value of last drawn pixel
-      lastT = t;
-      // Move along the curve by dt
-      t += dt;
-    }
-  }
-  // If the last pixel hasn't been stroke
-  if (VecPixelDist(prevPos, curve->_ctrl[curve->_order]) > 0.5)
-    // Stroke the last pixel
-    TGALayerStrokePix(layer, curve->_ctrl[curve->_order], pen);  
+  }
   // Free memory
+  ShapoidFree(&bounding);
   VecFree(&pos);
-  VecFree(&prevPos);
+}
+
+// Get the blend of a pencil in tgaPenBlend mode at the position 'pos'
+// in the Shapoid 's' ('inv' is the inverse of the matrix of its axis)
+// If 'blend' is not NULL, it goes from 'blend[0]' to 'blend[1]' along
+// the first axis of the Shapoid, else it's 1.0 minus the depth of 
+// the position
+float TGAShapoidGetPosBlend(Shapoid *s, float *inv, VecFloat *pos, 
+  float *blend) {
+  // Declare the blend
+  float b = 0.0;
+  // If the blend is along the first axis
+  if (blend != NULL) {
+    b = inv[0] * (VecGet(pos, 0) - VecGet(s->_pos, 0)) + 
+      inv[1] * (VecGet(pos, 1) - VecGet(s->_pos, 1));
+    if (b < 0.0) b = 0.0;
+    if (b > 1.0) b = 1.0;
+    b = blend[0] + b * (blend[1] - blend[0]);
+  // Else, the blend is given by the depth
+  } else {
+    b = 1.0 - ShapoidGetPosDepth(s, pos);
+  }
+  // Return the blend, clipped to [0,1]
+  return (b < 0.0 ? 0.0 : (b > 1.0 ? 1.0 : b));
+}
+
+// Mix the pixel ('x','y') of the layer 'that' with the color of the
+// pencil 'pen' for the blend 'blend', with the ratio 'ratio'
+// Pixels outside the clip box of the layer or in read only mode are
+// ignored
+// The dirty box of the layer is not updated
+void TGALayerMixPix(TGALayer *that, int x, int y, TGAPencil *pen, 
+  float blend, float ratio) {
+  // If the pixel is outside the clip box or the ratio is null
+  if (x < VecGet(that->_clip, 0) || y < VecGet(that->_clip, 1) || 
+    x > VecGet(that->_clip, 2) || y > VecGet(that->_clip, 3) || 
+    ratio <= 0.0)
+    return;
+  // Get the index of the pixel
+  long i = (long)y * (long)VecGet(that->_dim, 0) + (long)x;
+  // If the pixel is in read only mode, skip it
+  if ((that->_readOnly[i >> 3] >> (i & 7)) & 1)
+    return;
+  // Get the color of the pencil for the blend
+  TGAPixel pix;
+  TGAPencilSetBlend(pen, blend);
+  TGAPencilGetPixelTo(pen, &pix);
+  // Mix the pixel
+  TGAPixelMixTo(that->_pixels + i, that->_pixels + i, &pix, ratio);
+}
+
+// Add the polyline made of the 'nbPoint' points 'pts' (pairs of x,y)
+// in 'layer' with the pencil 'pen'
+// In tgaPenBlend mode the blend of the pencil is 'blend[i]' at the
+// i-th point and varies linearly along the segments
+// Pixel pencils are drawn with Bresenham's algorithm, or Wu's 
+// algorithm if they use antialias. Shapoid pencils are drawn as the
+// quads swept by the tip along the segments, plus the tip itself
+// at the ends and where the polyline turns
+// do nothing if arguments are invalid
+void TGALayerAddPolyline(TGALayer *layer, float *pts, float *blend,
+  int nbPoint, TGAPencil *pen) {
+  // Check arguments
+  if (layer == NULL || pts == NULL || blend == NULL || nbPoint < 1 || 
+    pen == NULL || (pen->_shape == tgaPenShapoid && pen->_tip == NULL))
+    return;
+  // If there is only one point, or two identical points, draw a 
+  // segment from the first point to itself
+  if (nbPoint == 2 && pts[0] == pts[2] && pts[1] == pts[3])
+    nbPoint = 1;
+  int nbSeg = (nbPoint > 1 ? nbPoint - 1 : 1);
+  int step = (nbPoint > 1 ? 2 : 0);
+  // If the pencil is a pixel
+  if (pen->_shape == tgaPenPixel) {
+    // For each segment
+    for (int iSeg = 0; iSeg < nbSeg; ++iSeg) {
+      float *from = pts + 2 * iSeg;
+      // If the segment is outside the clip box of the layer (with a 
+      // margin for the antialias), skip it
+      if (fmin(from[0], from[step]) > VecGet(layer->_clip, 2) + 2 ||
+        fmin(from[1], from[step + 1]) > VecGet(layer->_clip, 3) + 2 ||
+        fmax(from[0], from[step]) < VecGet(layer->_clip, 0) - 2 ||
+        fmax(from[1], from[step + 1]) < VecGet(layer->_clip, 1) - 2)
+        continue;
+      // Draw the segment, the first pixel of the segments after the 
+      // first one is the last pixel of the previous one
+      if (pen->_antialias == false)
+        TGALayerAddSegmentBresenham(layer, from, from + step, 
+          blend + iSeg, (iSeg == 0), pen);
+      else
+        TGALayerAddSegmentWu(layer, from, from + step, 
+          blend + iSeg, pen);
+    }
+    return;
+  }
+  // Declare the quad swept by the tip along a segment and the tip 
+  // moved to the points of the polyline
+  Shapoid *quad = FacoidCreate(2);
+  Shapoid *tip = ShapoidClone(pen->_tip);
+  // If we couldn't allocate memory
+  if (quad == NULL || tip == NULL) {
+    // Free memory and stop here
+    ShapoidFree(&quad);
+    ShapoidFree(&tip);
+    return;
+  }
+  // Declare the origin of the positions used to fill the quads and 
+  // the tips: the center of pixels, slightly moved toward the top 
+  // right so that a position on the border of two shapes belongs to
+  // only one of them
+  float org[2] = {0.5 + 2.0 * TGA_EPSILON, 0.5 + 2.0 * TGA_EPSILON};
+  // For each segment
+  for (int iSeg = 0; iSeg < nbSeg && nbPoint > 1; ++iSeg) {
+    float *from = pts + 2 * iSeg;
+    float *to = from + 2;
+    // Get the direction normal to the segment
+    float n[2] = {from[1] - to[1], to[0] - from[0]};
+    // Get the extreme points of the tip along the normal
+    float kMin[2], kMax[2];
+    TGAShapoidGetSupport(pen->_tip, n, kMin, kMax);
+    // Set the quad swept by the tip
+    for (int i = 2; i--;) {
+      VecSet(quad->_pos, i, from[i] + kMin[i]);
+      VecSet(quad->_axis[0], i, to[i] - from[i]);
+      VecSet(quad->_axis[1], i, kMax[i] - kMin[i]);
+    }
+    // Fill the quad, blended along the segment
+    TGALayerFillShapoidPix(layer, quad, org, pen, blend + iSeg);
+  }
+  // For each point
+  for (int iPoint = 0; iPoint < nbPoint; ++iPoint) {
+    // If it's not an end of the polyline
+    if (iPoint > 0 && iPoint < nbPoint - 1) {
+      // Get the sinus of the angle between the two segments at this
+      // point
+      float *p = pts + 2 * iPoint;
+      float u[2] = {p[0] - p[-2], p[1] - p[-1]};
+      float v[2] = {p[2] - p[0], p[3] - p[1]};
+      float l = sqrt((u[0] * u[0] + u[1] * u[1]) * 
+        (v[0] * v[0] + v[1] * v[1]));
+      float sinus = (l > 0.0 ? (u[0] * v[1] - u[1] * v[0]) / l : 0.0);
+      // If the polyline goes straight on, the quads leave no gap 
+      // between them and there is no need to fill the tip
+      if (u[0] * v[0] + u[1] * v[1] >= 0.0 && 
+        fabs(sinus) * pen->_thickness < TGA_FLATNESS)
+        continue;
+    }
+    // Fill the tip moved at this point
+    for (int i = 2; i--;)
+      VecSet(tip->_pos, i, 
+        VecGet(pen->_tip->_pos, i) + pts[2 * iPoint + i]);
+    float blendTip[2] = {blend[iPoint], blend[iPoint]};
+    TGALayerFillShapoidPix(layer, tip, org, pen, blendTip);
+  }
+  // Free memory
+  ShapoidFree(&quad);
+  ShapoidFree(&tip);
+}
+
+// Add the segment from 'from' to 'to' (x,y pairs) in 'layer' with 
+// the pixel pencil 'pen' using Bresenham's algorithm
+// In tgaPenBlend mode the blend of the pencil goes from 'blend[0]' 
+// to 'blend[1]' along the segment
+// If 'first' is false the first pixel of the segment is not drawn
+void TGALayerAddSegmentBresenham(TGALayer *layer, float *from, 
+  float *to, float *blend, bool first, TGAPencil *pen) {
+  // Get the pixels at the ends of the segment
+  int x0 = (int)floor(from[0]);
+  int y0 = (int)floor(from[1]);
+  int x1 = (int)floor(to[0]);
+  int y1 = (int)floor(to[1]);
+  // Add the segment to the modified area of the layer
+  TGALayerAddDirty(layer, (x0 < x1 ? x0 : x1), (y0 < y1 ? y0 : y1),
+    (x0 < x1 ? x1 : x0), (y0 < y1 ? y1 : y0));
+  // Bresenham's algorithm, the blend varies with the ratio of steps 
+  // done
+  int dx = abs(x1 - x0);
+  int dy = -abs(y1 - y0);
+  int sx = (x0 < x1 ? 1 : -1);
+  int sy = (y0 < y1 ? 1 : -1);
+  int nbStepMax = (dx > -dy ? dx : -dy);
+  float nbStep = (float)nbStepMax;
+  // Get the range of steps whose pixel may be inside the clip box: 
+  // the pixel at each step is at less than one pixel from the 
+  // segment between the centers of the end pixels, and one step is 
+  // added on each side for the rounding
+  float center[4] = {x0 + 0.5, y0 + 0.5, x1 + 0.5, y1 + 0.5};
+  float clip[4] = {VecGet(layer->_clip, 0) - 0.5, 
+    VecGet(layer->_clip, 1) - 0.5, VecGet(layer->_clip, 2) + 1.5, 
+    VecGet(layer->_clip, 3) + 1.5};
+  float t[2];
+  if (TGAClipSegment(center, center + 2, clip, t) == false)
+    return;
+  int stepFrom = (int)floor(t[0] * nbStep) - 1;
+  int stepTo = (int)ceil(t[1] * nbStep) + 1;
+  if (stepFrom < 0)
+    stepFrom = 0;
+  if (stepTo > nbStepMax)
+    stepTo = nbStepMax;
+  // Move to the first step of the range: the major axis moves at 
+  // every step, and the minor axis has moved as many times as the 
+  // number of its half-integer positions crossed by the ideal line
+  long long major = nbStepMax;
+  long long minor = (dx > -dy ? -dy : dx);
+  int nbMinor = (major > 0 ? 
+    (int)((2 * minor * stepFrom + major) / (2 * major)) : 0);
+  int nbX = (dx > -dy ? stepFrom : nbMinor);
+  int nbY = (dx > -dy ? nbMinor : stepFrom);
+  x0 += sx * nbX;
+  y0 += sy * nbY;
+  int err = dx * (1 + nbY) + dy * (1 + nbX);
+  for (int iStep = stepFrom; iStep <= stepTo; ++iStep) {
+    if (iStep > 0 || first == true)
+      TGALayerMixPix(layer, x0, y0, pen, blend[0] + 
+        (nbStep > 0.0 ? (float)iStep / nbStep : 0.0) * 
+        (blend[1] - blend[0]), 1.0);
+    if (x0 == x1 && y0 == y1)
+      break;
+    int e2 = 2 * err;
+    if (e2 >= dy) {
+      err += dy;
+      x0 += sx;
+    }
+    if (e2 <= dx) {
+      err += dx;
+      y0 += sy;
+    }
+  }
+}
+
+// Add the segment from 'from' to 'to' (x,y pairs) in 'layer' with 
+// the pixel pencil 'pen' using Wu's algorithm
+// In tgaPenBlend mode the blend of the pencil goes from 'blend[0]' 
+// to 'blend[1]' along the segment
+// The pixels at the ends are covered by the part of the segment 
+// inside them, a segment from a point to itself is drawn as a dot
+void TGALayerAddSegmentWu(TGALayer *layer, float *from, float *to, 
+  float *blend, TGAPencil *pen) {
+  // Use coordinates where pixels' center are integers, x being the 
+  // major axis
+  float x0 = from[0] - 0.5;
+  float y0 = from[1] - 0.5;
+  float x1 = to[0] - 0.5;
+  float y1 = to[1] - 0.5;
+  bool steep = (fabs(y1 - y0) > fabs(x1 - x0));
+  if (steep == true) {
+    float t = x0; x0 = y0; y0 = t;
+    t = x1; x1 = y1; y1 = t;
+  }
+  // The blend is reversed if the segment is drawn from 'to' to 'from'
+  float blendFrom = blend[0];
+  float blendTo = blend[1];
+  if (x0 > x1) {
+    float t = x0; x0 = x1; x1 = t;
+    t = y0; y0 = y1; y1 = t;
+    blendFrom = blend[1];
+    blendTo = blend[0];
+  }
+  float gradient = 
+    (x1 - x0 > TGA_EPSILON ? (y1 - y0) / (x1 - x0) : 0.0);
+  // Get the first and last pixels along the major axis and the
+  // part of them covered by the segment
+  int xFrom = (int)round(x0);
+  int xTo = (int)round(x1);
+  float gapFrom = 1.0 - (x0 + 0.5 - floor(x0 + 0.5));
+  float gapTo = x1 + 0.5 - floor(x1 + 0.5);
+  if (xFrom == xTo)
+    gapFrom = gapTo = 
+      (x0 == x1 && y0 == y1 ? 1.0 : x1 - x0);
+  float nbStep = (float)(xTo - xFrom);
+  // Add the segment to the modified area of the layer, the ends being
+  // rounded along the major axis the position on the minor axis can
+  // be beyond the ends by half the gradient
+  float yMin = (y0 < y1 ? y0 : y1) - 0.5 * fabs(gradient);
+  float yMax = (y0 < y1 ? y1 : y0) + 0.5 * fabs(gradient);
+  if (steep == true)
+    TGALayerAddDirty(layer, (int)floor(yMin), xFrom, 
+      (int)floor(yMax) + 1, xTo);
+  else
+    TGALayerAddDirty(layer, xFrom, (int)floor(yMin), 
+      xTo, (int)floor(yMax) + 1);
+  // Get the range of pixels along the major axis which may be inside
+  // the clip box: the two pixels mixed at each step are at less than
+  // one pixel from the segment on the minor axis, plus the half 
+  // gradient by which the rounded ends may go beyond it
+  int clipMajor = (steep == true ? 1 : 0);
+  float seg[4] = {x0, y0, x1, y1};
+  float margin = 1.0 + 0.5 * fabs(gradient);
+  float clip[4] = {VecGet(layer->_clip, clipMajor) - 1.0, 
+    VecGet(layer->_clip, 1 - clipMajor) - 1.0 - margin, 
+    VecGet(layer->_clip, 2 + clipMajor) + 1.0, 
+    VecGet(layer->_clip, 3 - clipMajor) + margin};
+  float t[2];
+  if (TGAClipSegment(seg, seg + 2, clip, t) == false)
+    return;
+  int xClipFrom = (int)floor(x0 + t[0] * (x1 - x0)) - 1;
+  int xClipTo = (int)ceil(x0 + t[1] * (x1 - x0)) + 1;
+  if (xClipFrom < VecGet(layer->_clip, clipMajor))
+    xClipFrom = VecGet(layer->_clip, clipMajor);
+  if (xClipTo > VecGet(layer->_clip, 2 + clipMajor))
+    xClipTo = VecGet(layer->_clip, 2 + clipMajor);
+  // For each pixel along the major axis
+  for (int x = (xFrom > xClipFrom ? xFrom : xClipFrom); 
+    x <= xTo && x <= xClipTo; ++x) {
+    // Get the position of the segment on the minor axis
+    float y = y0 + gradient * ((float)x - x0);
+    int iy = (int)floor(y);
+    float fy = y - (float)iy;
+    // Get the part of the pixel covered along the major axis
+    float gap = (x == xFrom ? gapFrom : (x == xTo ? gapTo : 1.0));
+    // Get the blend at this pixel
+    float b = blendFrom + (nbStep > 0.0 ? 
+      (float)(x - xFrom) / nbStep : 0.0) * (blendTo - blendFrom);
+    // Mix the two pixels on each side of the segment
+    if (steep == true) {
+      TGALayerMixPix(layer, iy, x, pen, b, (1.0 - fy) * gap);
+      TGALayerMixPix(layer, iy + 1, x, pen, b, fy * gap);
+    } else {
+      TGALayerMixPix(layer, x, iy, pen, b, (1.0 - fy) * gap);
+      TGALayerMixPix(layer, x, iy + 1, pen, b, fy * gap);
+    }
+  }
+}
+
+// Get in 't' the range [t[0],t[1]] of the parameters of the points
+// from + t * (to - from) of the segment from 'from' to 'to' (x,y 
+// pairs) inside the box 'box' (x0,y0,x1,y1) with the Liang-Barsky 
+// algorithm
+// Return false if the segment is outside the box
+bool TGAClipSegment(float *from, float *to, float *box, float *t) {
+  // Start with the whole segment
+  t[0] = 0.0;
+  t[1] = 1.0;
+  // For each side of the box
+  float d[2] = {to[0] - from[0], to[1] - from[1]};
+  for (int iSide = 0; iSide < 4; ++iSide) {
+    // Get the signed distances along the segment and from the start
+    // of the segment to the side, positive inside
+    int i = iSide % 2;
+    float p = (iSide < 2 ? -d[i] : d[i]);
+    float q = (iSide < 2 ? from[i] - box[iSide] : box[iSide] - from[i]);
+    // If the segment is parallel to the side
+    if (p == 0.0) {
+      // If it is outside the side the segment is outside the box
+      if (q < 0.0)
+        return false;
+    // Else, the segment enters or leaves the side at q / p
+    } else {
+      float r = q / p;
+      if (p < 0.0) {
+        if (r > t[1])
+          return false;
+        if (r > t[0])
+          t[0] = r;
+      } else {
+        if (r < t[0])
+          return false;
+        if (r < t[1])
+          t[1] = r;
+      }
+    }
+  }
+  // Return the success
+  return true;
+}
+
+// Get in 'kMin' and 'kMax' the points of the Shapoid 's' (of 
+// dimension 2) respectively minimizing and maximizing the dot product
+// with 'n'
+void TGAShapoidGetSupport(Shapoid *s, float *n, float *kMin, 
+  float *kMax) {
+  // Get the projection of the axis on 'n'
+  float p[2];
+  for (int i = 2; i--;)
+    p[i] = VecGet(s->_axis[i], 0) * n[0] + 
+      VecGet(s->_axis[i], 1) * n[1];
+  // If the Shapoid is a Spheroid, the extreme points are on the 
+  // ellipse around its center
+  if (s->_type == ShapoidTypeSpheroid) {
+    float l = sqrt(p[0] * p[0] + p[1] * p[1]);
+    for (int i = 2; i--;) {
+      float d = (l > 0.0 ? 0.5 * (VecGet(s->_axis[0], i) * p[0] + 
+        VecGet(s->_axis[1], i) * p[1]) / l : 0.0);
+      kMin[i] = VecGet(s->_pos, i) - d;
+      kMax[i] = VecGet(s->_pos, i) + d;
+    }
+  // Else, the extreme points are vertices of the Shapoid
+  } else {
+    // Get the vertices as offsets of the position, in the order of
+    // the pairs of axis they are made of
+    int nbVertex = (s->_type == ShapoidTypeFacoid ? 4 : 3);
+    float dot[4] = {0.0, p[0], p[1], p[0] + p[1]};
+    int iMin = 0;
+    int iMax = 0;
+    for (int iVertex = 1; iVertex < nbVertex; ++iVertex) {
+      if (dot[iVertex] < dot[iMin]) iMin = iVertex;
+      if (dot[iVertex] > dot[iMax]) iMax = iVertex;
+    }
+    for (int i = 2; i--;) {
+      kMin[i] = VecGet(s->_pos, i) + 
+        ((iMin & 1) ? VecGet(s->_axis[0], i) : 0.0) + 
+        ((iMin & 2) ? VecGet(s->_axis[1], i) : 0.0);
+      kMax[i] = VecGet(s->_pos, i) + 
+        ((iMax & 1) ? VecGet(s->_axis[0], i) : 0.0) + 
+        ((iMax & 2) ? VecGet(s->_axis[1], i) : 0.0);
+    }
+  }
 }
 
 // Draw one stroke at 'pos' with 'pen'
@@ -2134,16 +7007,83 @@ void TGALayerClean(TGALayer *that) {
   // Check arguments
   if (that == NULL)
     return;
-  // Set a pointer to the pixels
-  TGAPixel *p = that->_pixels;
-  // For each pixel
-  for (int i = 0; 
-    i < VecGet(that->_dim, 0) * VecGet(that->_dim, 1); ++i) {
-    // For each value RGBA
-    for (int irgb = 0; irgb < 4; ++irgb)
-      // Set the value
-      p[i]._rgba[irgb] = 0;
-    // Set read-write
-    p[i]._readOnly = false;
+  // Get the number of pixels
+  long nbPix = (long)VecGet(that->_dim, 0) * (long)VecGet(that->_dim, 1);
+  // Set the values to 0 and the pixels in read-write
+  memset(that->_pixels, 0, nbPix * sizeof(TGAPixel));
+  memset(that->_readOnly, 0, (nbPix + 7) / 8);
+  // The layer is not modified anymore
+  VecSet(that->_dirty, 0, 0);
+  VecSet(that->_dirty, 1, 0);
+  VecSet(that->_dirty, 2, -1);
+  VecSet(that->_dirty, 3, -1);
+}
+
+// Erase the pixels of the layer 'that' inside its dirty box
+// (set them to rgba(0,0,0,0) and readonly to false)
+// Pixels modified directly, without the TGALayer functions, since the
+// last clean are not erased
+// Do nothing in case of invalid argument
+void TGALayerCleanDirty(TGALayer *that) {
+  // Check arguments
+  if (that == NULL)
+    return;
+  // Erase the dirty box
+  TGALayerCleanBox(that, VecGet(that->_dirty, 0), 
+    VecGet(that->_dirty, 1), VecGet(that->_dirty, 2), 
+    VecGet(that->_dirty, 3));
+  // The layer is not modified anymore
+  VecSet(that->_dirty, 0, 0);
+  VecSet(that->_dirty, 1, 0);
+  VecSet(that->_dirty, 2, -1);
+  VecSet(that->_dirty, 3, -1);
+}
+
+// Erase the pixels of the layer 'that' inside the box 
+// ('x0','y0')-('x1','y1') (included, inside the layer)
+// The dirty box of the layer is not updated
+void TGALayerCleanBox(TGALayer *that, int x0, int y0, int x1, int y1) {
+  // Get the width of the layer
+  int width = VecGet(that->_dim, 0);
+  // For each row of the box
+  for (int y = y0; y <= y1 && x0 <= x1; ++y) {
+    // Set the values to 0 and the pixels in read-write
+    long i = (long)y * (long)width;
+    memset(that->_pixels + i + x0, 0, (x1 - x0 + 1) * sizeof(TGAPixel));
+    // The flags are written only if they are set, so that boxes of 
+    // the same rows can be erased in parallel
+    for (int x = x0; x <= x1; ++x)
+      if ((that->_readOnly[(i + x) >> 3] >> ((i + x) & 7)) & 1)
+        that->_readOnly[(i + x) >> 3] &= 
+          (unsigned char)~(1 << ((i + x) & 7));
+  }
+}
+
+// Extend the dirty box of the layer 'that' to contain the box 
+// ('x0','y0')-('x1','y1') (included), clipped to the clip box of the 
+// layer
+void TGALayerAddDirty(TGALayer *that, int x0, int y0, int x1, int y1) {
+  // Clip the box
+  if (x0 < VecGet(that->_clip, 0)) x0 = VecGet(that->_clip, 0);
+  if (y0 < VecGet(that->_clip, 1)) y0 = VecGet(that->_clip, 1);
+  if (x1 > VecGet(that->_clip, 2)) x1 = VecGet(that->_clip, 2);
+  if (y1 > VecGet(that->_clip, 3)) y1 = VecGet(that->_clip, 3);
+  // If the box is empty
+  if (x0 > x1 || y0 > y1)
+    // Nothing to do
+    return;
+  // If the dirty box is empty
+  if (VecGet(that->_dirty, 0) > VecGet(that->_dirty, 2)) {
+    // The dirty box is the box
+    VecSet(that->_dirty, 0, x0);
+    VecSet(that->_dirty, 1, y0);
+    VecSet(that->_dirty, 2, x1);
+    VecSet(that->_dirty, 3, y1);
+  // Else, extend the dirty box
+  } else {
+    if (x0 < VecGet(that->_dirty, 0)) VecSet(that->_dirty, 0, x0);
+    if (y0 < VecGet(that->_dirty, 1)) VecSet(that->_dirty, 1, y0);
+    if (x1 > VecGet(that->_dirty, 2)) VecSet(that->_dirty, 2, x1);
+    if (y1 > VecGet(that->_dirty, 3)) VecSet(that->_dirty, 3, y1);
   }
 }
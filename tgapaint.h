@@ -16,8 +16,36 @@
 
 // Maximum number of colors in a TGAPencil
 #define TGA_NBCOLORPENCIL 10
+// Number of precomputed colors of a TGAPencil in tgaPenBlend mode
+#define TGA_PENCILRAMPSIZE 256
+// Number of sub-pixel phases per axis of the precomputed stamps of
+// a TGAPencil's tip
+#define TGA_PENCILNBPHASE 4
+// Size in pixel of the tiles drawn in parallel by TGAExecDrawListTiled
+#define TGA_TILESIZE 64
+// Strength under which TGAFilterGaussBlurRecursive uses 
+// TGAFilterGaussBlur
+#define TGA_GAUSSRECURSIVEMIN 3.0
+// Distance, relative to the strength, of the pixels around the box
+// blurred by TGALayerFilterGaussBlurRecursive used to blur it
+#define TGA_GAUSSRECURSIVEHALO 4.0
+// Number of box blurs approximating a gaussian in TGAFilterGaussBlurBox
+#define TGA_GAUSSBOXNBPASS 3
+// Strength under which TGAFilterGaussBlurBox uses TGAFilterGaussBlur
+#define TGA_GAUSSBOXMIN 2.0
+// Number of bits of fraction of the coefficients of the convolutions
+// in fixed point, and of the values between the two passes of a 
+// separable kernel
+#define TGA_KERNELFIXEDSHIFT 10
+#define TGA_KERNELFIXEDINTER 2
+// Maximum sum of the absolute values of the coefficients of a kernel
+// (per axis if it is separable) for the convolution in fixed point
+#define TGA_KERNELFIXEDMAX 31
 // Maximum number of curves in the definition of a font's character
 #define TGA_NBMAXCURVECHAR 10
+// Value of bits per pixel for TGASaveFormat to select automatically
+// the depth of the saved image
+#define TGA_BPP_AUTO 0
 
 // ================= Generic functions ==================
 
@@ -26,6 +54,10 @@ void TGATypeUnsupported(void*t, ...);
   BCurve*: TGADrawBCurve, \
   SCurve*: TGADrawSCurve, \
   default: TGATypeUnsupported)(T,C,P)
+#define TGADrawListDrawCurve(L,C,P) _Generic((C), \
+  BCurve*: TGADrawListDrawBCurve, \
+  SCurve*: TGADrawListDrawSCurve, \
+  default: TGATypeUnsupported)(L,C,P)
 
 // ================= Data structure ===================
 
@@ -57,20 +89,127 @@ typedef struct TGAHeader {
   char _imageDescriptor;
 } TGAHeader;
 
-// One pixel of the TGA
+// Footer of a TGA 2.0 file
+typedef struct TGAFooter {
+  // Flag to memorize if the file has a TGA 2.0 footer, if false the
+  // offsets are 0
+  bool _isNewTGA;
+  // Offset in byte from the beginning of the file of the extension 
+  // area, 0 if there is none
+  unsigned int _extensionOffset;
+  // Offset in byte from the beginning of the file of the developer
+  // directory, 0 if there is none
+  unsigned int _developerOffset;
+} TGAFooter;
+
+// One pixel of the TGA, packed on 4 bytes so that rows of pixels 
+// are rows of RGBA values (the read only flags are in the layers)
 typedef struct TGAPixel {
   // RGB and transparency values
   unsigned char _rgba[4];
-  // Flag to memorize if this pixel is in read only mode
-  bool _readOnly;
 } TGAPixel;
 
+// Decoder of the pixels of a TGA file, memorizing the current 
+// packet of run-length encoded data between two blocks of data
+typedef struct TGADecoder {
+  // Number of bytes per pixel in the file
+  int _bytes;
+  // Flag to memorize if the data is run-length encoded
+  bool _rle;
+  // Number of pixels remaining in the current packet
+  long _nbRemain;
+  // Flag to memorize if the current packet is a run-length packet
+  bool _runPacket;
+  // Raw bytes of the pixel repeated by the current run-length packet
+  unsigned char _runValue[4];
+} TGADecoder;
+
+// Buffer used to write a TGA file by large blocks, or to encode a TGA
+// file in memory
+typedef struct TGAWriteBuffer {
+  // Stream where the buffer is flushed, NULL if the buffer is the 
+  // destination of the data
+  FILE *_stream;
+  // Content of the buffer
+  unsigned char *_data;
+  // Number of bytes in the buffer
+  long _size;
+  // Capacity of the buffer in bytes
+  long _capacity;
+  // Flag to memorize if the buffer can be reallocated when it has no 
+  // stream and is full
+  bool _growable;
+  // Total number of bytes added to the buffer, including the ones 
+  // which couldn't be stored
+  long _total;
+  // Flag to memorize if writing to the stream failed, or if the 
+  // buffer without stream is full
+  bool _error;
+} TGAWriteBuffer;
+
+// View on an uncompressed TGA file mapped in memory
+typedef struct TGAMap {
+  // Header
+  TGAHeader _header;
+  // Address of the mapping
+  unsigned char *_map;
+  // Size of the mapping in bytes
+  size_t _size;
+  // Pointer to the first pixel in the mapping
+  unsigned char *_pixels;
+  // Number of bytes per pixel
+  int _bytes;
+} TGAMap;
+
+// Reader decoding a TGA file by bands of rows without loading the
+// whole image
+typedef struct TGAReader {
+  // Stream of the file
+  FILE *_stream;
+  // Header
+  TGAHeader _header;
+  // Decoder of the pixels
+  TGADecoder _decoder;
+  // Buffer of data read from the file
+  unsigned char *_block;
+  // Position of the next byte to decode in the buffer
+  long _pos;
+  // Number of bytes in the buffer
+  long _size;
+  // Number of rows already read
+  short _nbRowRead;
+} TGAReader;
+
+// Writer encoding a TGA file by bands of rows without building the
+// whole image
+typedef struct TGAWriter {
+  // Buffer of data written to the file
+  TGAWriteBuffer _buffer;
+  // Header
+  TGAHeader _header;
+  // Buffer for the encoded pixels of one row
+  unsigned char *_row;
+  // Number of rows already written
+  short _nbRowWritten;
+} TGAWriter;
+
 // One layer of pixels in the TGA
 typedef struct TGALayer {
   // Dimension of the layer
   VecShort *_dim;
   // Pixels (stored by rows)
   TGAPixel *_pixels;
+  // Read only flags of the pixels, one bit per pixel in the same 
+  // order as the pixels
+  unsigned char *_readOnly;
+  // Box (_dirty[0],_dirty[1])-(_dirty[2],_dirty[3]) (included) 
+  // containing the pixels modified by the TGALayer functions since the
+  // last clean of the layer, empty if _dirty[0] > _dirty[2]
+  VecShort *_dirty;
+  // Box (_clip[0],_clip[1])-(_clip[2],_clip[3]) (included) of the 
+  // pixels the TGALayer drawing functions can modify, the whole layer
+  // by default
+  VecShort *_clip;
 } TGALayer;
 
 // Main TGA structure
@@ -103,6 +242,23 @@ typedef enum tgaPencilShape {
   tgaPenPixel
 } tgaPencilShape;
 
+// Pixels covered by the tip of a TGAPencil for one sub-pixel phase
+// of the stroke position
+typedef struct TGAPencilStamp {
+  // Position of the bottom left pixel of the stamp relatively to the
+  // pixel containing the stroke position
+  short _x;
+  short _y;
+  // Dimensions of the stamp in pixel
+  short _width;
+  short _height;
+  // Number of times each pixel is hit by the tip (stored by rows), 
+  // NULL if the stamp has not been calculated
+  unsigned char *_hits;
+  // Coverage of each pixel by the tip, only if antialias is used
+  float *_coverage;
+} TGAPencilStamp;
+
 // Pencil to draw on a TGA
 typedef struct TGAPencil {
   // List of available colors in this pencil
@@ -124,6 +280,14 @@ typedef struct TGAPencil {
   float _thickness;
   // Apply antialiasing if true
   bool _antialias;
+  // Colors of the blend from _blendColor[0] to _blendColor[1] for
+  // TGA_PENCILRAMPSIZE values of _blend regularly spaced in [0.0,1.0]
+  TGAPixel _blendRamp[TGA_PENCILRAMPSIZE];
+  // Flag to memorize if _blendRamp is up to date
+  bool _blendRampValid;
+  // Stamps of the tip for each sub-pixel phase, calculated when 
+  // needed (the tip belongs to the pencil)
+  TGAPencilStamp _stamps[TGA_PENCILNBPHASE * TGA_PENCILNBPHASE];
 } TGAPencil;
 
 // One character in a TGAFont
@@ -168,6 +332,82 @@ typedef struct TGAFont {
   VecFloat *_right;
 } TGAFont;
 
+// Enumeration of the types of command in a TGADrawList
+typedef enum tgaDrawCmdType {
+  // Line
+  tgaDrawCmdLine,
+  // BCurve
+  tgaDrawCmdBCurve,
+  // SCurve (outlines of shapes and characters)
+  tgaDrawCmdSCurve,
+  // Filled Shapoid
+  tgaDrawCmdFill
+} tgaDrawCmdType;
+
+// One command recorded in a TGADrawList
+typedef struct TGADrawCmd {
+  // Type of the command
+  tgaDrawCmdType _type;
+  // Pencil of the command (belongs to the list, shared by consecutive
+  // commands recorded with identical pencils)
+  TGAPencil *_pen;
+  // Index of the pencil of the command in the pencils of the list
+  int _iPen;
+  // Ends of the line, (x,y) pairs
+  float _pts[4];
+  // BCurve of the command (belongs to the command)
+  BCurve *_bcurve;
+  // SCurve of the command (belongs to the command)
+  SCurve *_scurve;
+  // Filled Shapoid of the command (belongs to the command)
+  Shapoid *_shape;
+  // Box (_box[0],_box[1])-(_box[2],_box[3]) (included) containing 
+  // the pixels the command may modify
+  int _box[4];
+} TGADrawCmd;
+
+// List of drawing commands recorded to be executed at once on a TGA
+typedef struct TGADrawList {
+  // Commands, in their order of recording
+  GSet *_cmds;
+  // Pencils used by the commands
+  GSet *_pens;
+} TGADrawList;
+
+// Policies giving the pixels outside the layer used by the 
+// convolutions
+typedef enum tgaConvEdge {
+  // The nearest pixel on the border of the layer
+  tgaConvEdgeClamp,
+  // The pixel on the opposite side of the layer, as if it was tiled
+  tgaConvEdgeWrap,
+  // The pixel symmetric relatively to the border of the layer (the 
+  // border itself not being repeated)
+  tgaConvEdgeMirror,
+  // A transparent pixel rgba(0,0,0,0)
+  tgaConvEdgeTransparent
+} tgaConvEdge;
+
+// Kernel of a convolution
+typedef struct TGAKernel {
+  // Radius of the kernel along the rows and the columns, it covers 
+  // (2 * _radius[0] + 1) * (2 * _radius[1] + 1) pixels
+  int _radius[2];
+  // Flag for a separable kernel, product of a kernel along the rows
+  // and a kernel along the columns
+  bool _separable;
+  // Coefficients, by rows from the one at (-_radius[0],-_radius[1]) 
+  // if the kernel is not separable, else the ones along the rows
+  // followed by the ones along the columns
+  float *_coeff;
+  // Value added to the result of the convolution
+  float _bias;
+  // Flag to convolve the alpha channel, else it is left unchanged
+  bool _alpha;
+  // Flag to convolve in fixed point when the coefficients allow it
+  bool _fixed;
+} TGAKernel;
+
 // ================ Functions declaration ====================
 
 // Create a TGA of width dim[0] and height dim[1] and background
@@ -197,12 +437,163 @@ void TGAFree(TGA **tga);
 // 7 : invalid arguments
 int TGALoad(TGA **tga, char *fileName);
 
+// Read the header of the TGA file pointed to by 'fileName' into 
+// 'header' and, if 'footer' is not NULL, its TGA 2.0 footer into 
+// 'footer'
+// Only the header and the footer are read, no memory is allocated
+// and the header is not checked
+// return 0 upon success, else
+// 1 : couldn't open the file
+// 6 : unexpected end of file
+// 7 : invalid arguments
+int TGAProbe(char *fileName, TGAHeader *header, TGAFooter *footer);
+
+// Load a TGA from the file pointed to by 'fileName' by mapping the 
+// file in memory and decoding the pixels directly from the mapping
+// If the file can't be mapped, it is loaded with TGALoad
+// If 'tga' already contains a TGA, it is overwritten
+// return the same codes as TGALoad
+int TGALoadMapped(TGA **tga, char *fileName);
+
+// Decode a TGA from the 'size' bytes of 'data', which contain a whole
+// TGA file
+// If 'tga' already contains a TGA, it is overwritten
+// return the same codes as TGALoad
+int TGADecodeBuffer(TGA **tga, unsigned char *data, long size);
+
+// Open a view on the uncompressed TGA file pointed to by 'fileName'
+// The file is mapped privately in memory: the pixels are read directly
+// from the file and memory pages are copied only when written to
+// If 'map' already contains a view, it is closed
+// return 0 upon success, else
+// 1 : couldn't open the file
+// 2 : malloc failed
+// 3 : can only handle image type 2
+// 4 : can only handle pixel depths of 16, 24, and 32
+// 5 : can only handle colour map types of 0 and 1
+// 6 : unexpected end of file
+// 7 : invalid arguments
+// 8 : couldn't map the file in memory
+int TGAMapOpen(TGAMap **map, char *fileName);
+
+// Close the view 'map' and free the memory it uses
+void TGAMapClose(TGAMap **map);
+
+// Get a pointer to the row 'y' (in the same order as TGALoad) of 
+// the mapped file 'map', pixels are in the file format (BGRA, BGR 
+// or 1-5-5-5)
+// Return NULL in case of invalid arguments
+unsigned char* TGAMapGetRow(TGAMap *map, short y);
+
+// Decode the pixel at coord (x,y) = (pos[0],pos[1]) of the mapped file
+// 'map' into 'pix'
+// Do nothing in case of invalid arguments
+void TGAMapGetPix(TGAMap *map, VecShort *pos, TGAPixel *pix);
+
+// Open a reader on the TGA file pointed to by 'fileName'
+// Only the header is read, the rows are decoded by TGAReaderRead
+// If 'reader' already contains a reader, it is closed
+// return 0 upon success, else
+// 1 : couldn't open the file
+// 2 : malloc failed
+// 3 : can only handle image type 2 and 10
+// 4 : can only handle pixel depths of 16, 24, and 32
+// 5 : can only handle colour map types of 0 and 1
+// 7 : invalid arguments
+int TGAReaderOpen(TGAReader **reader, char *fileName);
+
+// Close the reader 'reader' and free the memory it uses
+void TGAReaderClose(TGAReader **reader);
+
+// Decode the next band of at most 'nbRow' rows of the reader 'reader'
+// into 'pix', which must be able to contain nbRow * width pixels
+// Bands are read in the order of the file, as given by the origin 
+// bits of the image descriptor, but inside a band rows are stored 
+// from bottom to top and pixels from left to right as in a TGALayer
+// 'y' is set to the coordinate of the bottom row of the band and 
+// 'nbRead' to the number of rows read, 0 once all rows have been read
+// return 0 upon success, else
+// 6 : unexpected end of file
+// 7 : invalid arguments
+int TGAReaderRead(TGAReader *reader, TGAPixel *pix, short nbRow,
+  short *y, short *nbRead);
+
 // Save the TGA 'tga' to the file pointed to by 'fileName'
+// The image is saved uncompressed (type 2) with 32 bits per pixel
 // return 0 upon success, else
 // 1 : couldn't open the file
 // 2 : invalid arguments
+// 3 : couldn't write the file or allocate memory
 int TGASave(TGA *tga, char *fileName);
 
+// Save the TGA 'tga' to the file pointed to by 'fileName'
+// The image is saved run-length encoded (type 10) with 32 bits 
+// per pixel
+// return 0 upon success, else
+// 1 : couldn't open the file
+// 2 : invalid arguments
+// 3 : couldn't write the file or allocate memory
+int TGASaveRLE(TGA *tga, char *fileName);
+
+// Save the TGA 'tga' to the file pointed to by 'fileName'
+// The image is saved uncompressed if 'dataTypeCode' is 2 or 
+// run-length encoded if it is 10, with 'bitsPerPixel' bits per pixel
+// (16, 24 or 32)
+// If 'bitsPerPixel' is TGA_BPP_AUTO the image is saved with 24 bits
+// per pixel if all its pixels are opaque, else with 32 bits per pixel
+// With 16 bits per pixel colors are reduced to 5 bits per channel and
+// the pixels are transparent if their opacity is lower than 128
+// return 0 upon success, else
+// 1 : couldn't open the file
+// 2 : invalid arguments
+// 3 : couldn't write the file or allocate memory
+int TGASaveFormat(TGA *tga, char *fileName, char dataTypeCode,
+  char bitsPerPixel);
+
+// Encode the TGA 'tga' in memory as a TGA file with 'dataTypeCode' 
+// and 'bitsPerPixel' as in TGASaveFormat
+// The encoded file is written in '*data' which can contain 
+// '*capacity' bytes, and 'size' is set to its number of bytes
+// If 'growable' is true, '*data' must be NULL or allocated with 
+// malloc, it is reallocated as needed and '*capacity' is updated
+// The caller is in charge of freeing '*data'
+// return 0 upon success, else
+// 2 : invalid arguments
+// 3 : malloc failed
+// 4 : the buffer is too small, 'size' is set to the needed size
+int TGAEncodeBuffer(TGA *tga, char dataTypeCode, char bitsPerPixel,
+  unsigned char **data, long *capacity, bool growable, long *size);
+
+// Open a writer on the file pointed to by 'fileName' for an image of
+// width dim[0] and height dim[1], saved uncompressed if 'dataTypeCode'
+// is 2 or run-length encoded per row if it is 10, with 'bitsPerPixel'
+// bits per pixel (16, 24 or 32)
+// The header is written immediately, the rows are added with 
+// TGAWriterWrite
+// If 'writer' already contains a writer, it is closed
+// return 0 upon success, else
+// 1 : couldn't open the file
+// 2 : invalid arguments
+// 3 : couldn't write the file or allocate memory
+int TGAWriterOpen(TGAWriter **writer, char *fileName, VecShort *dim,
+  char dataTypeCode, char bitsPerPixel);
+
+// Encode and write the band of 'nbRow' rows in 'pix' with the writer
+// 'writer'
+// Rows are stored from bottom to top in 'pix' as in a TGALayer, and
+// bands must be given from the bottom of the image to its top
+// return 0 upon success, else
+// 2 : invalid arguments, or more rows than the height of the image
+// 3 : couldn't write the file
+int TGAWriterWrite(TGAWriter *writer, TGAPixel *pix, short nbRow);
+
+// Write the remaining data of the writer 'writer', close the file and
+// free the memory it uses
+// return 0 upon success, else
+// 3 : couldn't write the file
+// 4 : not all the rows of the image have been written
+int TGAWriterClose(TGAWriter **writer);
+
 // Print the header of 'tga' on 'stream'
 // If arguments are invalid, do nothing
 void TGAPrintHeader(TGA *tga, FILE *stream);
@@ -227,6 +618,7 @@ void TGASetPix(TGA *tga, VecShort *pos, TGAPixel *pix);
 void TGAStrokePix(TGA *tga, VecFloat *pos, TGAPencil *pen);
 
 // Draw a line between 'from' and 'to' with pencil 'pen'
+// If the pencil is a pixel with antialias the line is antialiased
 // pixels outside the TGA are ignored
 // do nothing if arguments are invalid
 void TGADrawLine(TGA *tga, VecFloat *from, VecFloat *to, TGAPencil *pen);
@@ -268,14 +660,140 @@ void TGADrawShapoid(TGA *tga, Shapoid *s, TGAPencil *pen);
 
 // Fill the shapoid 's' with pencil 'pen' 
 // The shapoid must be of dimension 2
+// If the pencil is a pixel with antialias, the pixels on the border 
+// of the shapoid are mixed according to their coverage
 // Pixels outside the TGA are ignored
 // Do nothing if arguments are invalid
 void TGAFillShapoid(TGA *tga, Shapoid *s, TGAPencil *pen);
 
 // Apply a gaussian blur of 'strength' and 'range' perimeter on the TGA
+// The blur is applied separately along the rows and the columns, the
+// pixels at a distance lower than 'range' along the row/column 
+// contributing with a weight given by the gaussian, normalized over 
+// the pixels inside the TGA
+// The TGA is blurred by bands of rows in parallel
 // Do nothing if arguments are invalid 
 void TGAFilterGaussBlur(TGA *tga, float strength, float range);
 
+// Apply a recursive gaussian blur of 'strength' on the TGA
+// The gaussian is approximated with the recursive filter of Young and
+// van Vliet applied forward and backward along the rows and the 
+// columns, hence the cost per pixel doesn't depend on 'strength', and
+// the pixels outside the TGA are considered equal to the nearest 
+// pixel on its border
+// 'strength' lower than TGA_GAUSSRECURSIVEMIN is blurred with 
+// TGAFilterGaussBlur instead, as it is then cheap and the recursive
+// filter is less accurate
+// The TGA is blurred by bands of rows then by strips of columns 
+// in parallel, the values being rounded between the two passes
+// Do nothing if arguments are invalid 
+void TGAFilterGaussBlurRecursive(TGA *tga, float strength);
+
+// Apply an approximated gaussian blur of 'strength' on the TGA
+// The gaussian is approximated with TGA_GAUSSBOXNBPASS successive box
+// blurs along the rows and the columns, whose widths are chosen to 
+// get the variance of the gaussian, calculated with running sums on
+// integers, hence the cost per pixel doesn't depend on 'strength'
+// Compared to TGAFilterGaussBlur on a noisy image, the values at more
+// than 3 * 'strength' from the borders differ by up to 9 (rms 3) for 
+// 'strength' around 2, and by 1 (rms 0.4) above 10. Closer to the 
+// borders they differ more, as TGAFilterGaussBlur normalizes the 
+// weights over the pixels inside the TGA
+// 'strength' lower than TGA_GAUSSBOXMIN is blurred with 
+// TGAFilterGaussBlur instead, as it is then cheap and the boxes are
+// too narrow to approximate the gaussian
+// The pixels outside the TGA are considered equal to the nearest 
+// pixel on its border
+// The TGA is blurred by bands of rows in parallel
+// Do nothing if arguments are invalid 
+void TGAFilterGaussBlurBox(TGA *tga, float strength);
+
+// Create a kernel of convolution of radius 'rx' along the rows and 
+// 'ry' along the columns, with all its coefficients equal to 0, no
+// bias, convolving the alpha channel, in float
+// Return NULL if arguments are invalid or we couldn't allocate memory
+TGAKernel* TGAKernelCreate(int rx, int ry);
+
+// Create a separable kernel of convolution of radius 'rx' along the 
+// rows and 'ry' along the columns, with all its coefficients equal to
+// 0, no bias, convolving the alpha channel, in float
+// Return NULL if arguments are invalid or we couldn't allocate memory
+TGAKernel* TGAKernelCreateSeparable(int rx, int ry);
+
+// Free the memory used by the TGAKernel 'that'
+void TGAKernelFree(TGAKernel **that);
+
+// Set the coefficient at (x,y) (relative to the center) of the non
+// separable TGAKernel 'that' to 'v'
+// Do nothing if arguments are invalid
+void TGAKernelSet(TGAKernel *that, int x, int y, float v);
+
+// Set the coefficient at 'x' (relative to the center) along the rows
+// of the separable TGAKernel 'that' to 'v'
+// Do nothing if arguments are invalid
+void TGAKernelSetX(TGAKernel *that, int x, float v);
+
+// Set the coefficient at 'y' (relative to the center) along the 
+// columns of the separable TGAKernel 'that' to 'v'
+// Do nothing if arguments are invalid
+void TGAKernelSetY(TGAKernel *that, int y, float v);
+
+// Get the coefficient at (x,y) (relative to the center) of the 
+// TGAKernel 'that' (the product of the coefficients along the rows 
+// and columns if it is separable)
+// Return 0.0 if arguments are invalid
+float TGAKernelGet(TGAKernel *that, int x, int y);
+
+// Set the value added to the result of the convolution by the 
+// TGAKernel 'that' to 'bias'
+// Do nothing if arguments are invalid
+void TGAKernelSetBias(TGAKernel *that, float bias);
+
+// Set the flag to convolve the alpha channel with the TGAKernel 'that'
+// to 'alpha' (if false the alpha channel is left unchanged)
+// Do nothing if arguments are invalid
+void TGAKernelSetAlpha(TGAKernel *that, bool alpha);
+
+// Set the flag to convolve in fixed point with the TGAKernel 'that'
+// to 'fixed'
+// The fixed point convolution is used only if the sum of the absolute
+// values of the coefficients (along each axis if the kernel is 
+// separable) is lower than TGA_KERNELFIXEDMAX, else the float one is
+// used. It is faster but rounds the coefficients to multiples of 
+// 1/2^TGA_KERNELFIXEDSHIFT (their sum being preserved)
+// Do nothing if arguments are invalid
+void TGAKernelSetFixed(TGAKernel *that, bool fixed);
+
+// Create a kernel sharpening the pixels by 'strength' (the four 
+// neighbours along the rows and columns are subtracted 'strength' 
+// times from the pixel), leaving the alpha channel unchanged
+// Return NULL if arguments are invalid or we couldn't allocate memory
+TGAKernel* TGAKernelCreateSharpen(float strength);
+
+// Create a kernel embossing the pixels, lit from the top left, 
+// centered on the grey rgb(128,128,128) and leaving the alpha channel
+// unchanged
+// Return NULL if we couldn't allocate memory
+TGAKernel* TGAKernelCreateEmboss(void);
+
+// Create a kernel detecting the edges (laplacian over the 8 
+// neighbours), leaving the alpha channel unchanged
+// Return NULL if we couldn't allocate memory
+TGAKernel* TGAKernelCreateEdge(void);
+
+// Create a separable kernel of gaussian blur of 'strength' and 
+// 'range' perimeter, as the one of TGAFilterGaussBlur but normalized
+// over the whole window (the pixels outside the layer are given by
+// the policy of the convolution)
+// Return NULL if arguments are invalid or we couldn't allocate memory
+TGAKernel* TGAKernelCreateGauss(float strength, float range);
+
+// Convolve the TGA with the TGAKernel 'kernel', the pixels outside 
+// the TGA being given by the policy 'edge'
+// The TGA is convolved by bands of rows in parallel
+// Do nothing if arguments are invalid 
+void TGAFilterConvolve(TGA *tga, TGAKernel *kernel, tgaConvEdge edge);
+
 // Print the string 's' with its anchor position at 'pos', TGAPencil 
 // 'pen' and font 'font'
 void TGAPrintString(TGA *tga, TGAPencil *pen, TGAFont *font, 
@@ -285,7 +803,146 @@ void TGAPrintString(TGA *tga, TGAPencil *pen, TGAFont *font,
 // and (width, height) dimension 'dim' with font 'font'
 void TGAPrintChar(TGA *tga, TGAPencil *pen, TGAFont *font, 
   unsigned char c, VecFloat *pos);
+
+// Create an empty TGADrawList
+// Return NULL if we couldn't allocate memory
+TGADrawList* TGADrawListCreate(void);
+
+// Free the memory used by the TGADrawList 'that' and its commands
+void TGADrawListFree(TGADrawList **that);
+
+// Remove all the commands of the TGADrawList 'that'
+// Do nothing if arguments are invalid
+void TGADrawListFlush(TGADrawList *that);
+
+// Record in the TGADrawList 'that' the drawing of a line between 
+// 'from' and 'to' with pencil 'pen'
+// The arguments are copied, they can be modified or freed after the
+// call
+// Do nothing if arguments are invalid
+void TGADrawListDrawLine(TGADrawList *that, VecFloat *from, 
+  VecFloat *to, TGAPencil *pen);
+
+// Record in the TGADrawList 'that' the drawing of the BCurve 'curve' 
+// (must be of dimension 2 and order > 0) with pencil 'pen'
+// The arguments are copied, they can be modified or freed after the
+// call
+// Do nothing if arguments are invalid
+void TGADrawListDrawBCurve(TGADrawList *that, BCurve *curve, 
+  TGAPencil *pen);
+
+// Record in the TGADrawList 'that' the drawing of the SCurve 'curve'
+// (must be of dimension 2) with pencil 'pen'
+// The arguments are copied, they can be modified or freed after the
+// call
+// Do nothing if arguments are invalid
+void TGADrawListDrawSCurve(TGADrawList *that, SCurve *curve, 
+  TGAPencil *pen);
+
+// Record in the TGADrawList 'that' the drawing of a rectangle between
+// 'from' and 'to' with pencil 'pen'
+// The arguments are copied, they can be modified or freed after the
+// call
+// Do nothing if arguments are invalid
+void TGADrawListDrawRect(TGADrawList *that, VecFloat *from, 
+  VecFloat *to, TGAPencil *pen);
+
+// Record in the TGADrawList 'that' the filling of a rectangle between
+// 'from' and 'to' with pencil 'pen'
+// The arguments are copied, they can be modified or freed after the
+// call
+// Do nothing if arguments are invalid
+void TGADrawListFillRect(TGADrawList *that, VecFloat *from, 
+  VecFloat *to, TGAPencil *pen);
+
+// Record in the TGADrawList 'that' the drawing of an ellipse at 
+// 'center' of radius 'r' (Rx,Ry) with pencil 'pen'
+// The arguments are copied, they can be modified or freed after the
+// call
+// Do nothing if arguments are invalid
+void TGADrawListDrawEllipse(TGADrawList *that, VecFloat *center, 
+  VecFloat *r, TGAPencil *pen);
+
+// Record in the TGADrawList 'that' the filling of an ellipse at 
+// 'center' of radius 'r' (Rx,Ry) with pencil 'pen'
+// The arguments are copied, they can be modified or freed after the
+// call
+// Do nothing if arguments are invalid
+void TGADrawListFillEllipse(TGADrawList *that, VecFloat *center, 
+  VecFloat *r, TGAPencil *pen);
+
+// Record in the TGADrawList 'that' the drawing of the shapoid 's' 
+// (must be of dimension 2) with pencil 'pen'
+// The arguments are copied, they can be modified or freed after the
+// call
+// Do nothing if arguments are invalid
+void TGADrawListDrawShapoid(TGADrawList *that, Shapoid *s, 
+  TGAPencil *pen);
+
+// Record in the TGADrawList 'that' the filling of the shapoid 's' 
+// (must be of dimension 2) with pencil 'pen'
+// The arguments are copied, they can be modified or freed after the
+// call
+// Do nothing if arguments are invalid
+void TGADrawListFillShapoid(TGADrawList *that, Shapoid *s, 
+  TGAPencil *pen);
+
+// Record in the TGADrawList 'that' the printing of the string 's' 
+// with its anchor position at 'pos', TGAPencil 'pen' and font 'font'
+// The arguments are copied, they can be modified or freed after the
+// call
+// Do nothing if arguments are invalid
+void TGADrawListPrintString(TGADrawList *that, TGAPencil *pen, 
+  TGAFont *font, unsigned char *s, VecFloat *pos);
+
+// Record in the TGADrawList 'that' the printing of the char 'c' with
+// its (bottom, left) position at 'pos', TGAPencil 'pen' and font 
+// 'font'
+// The arguments are copied, they can be modified or freed after the
+// call
+// Do nothing if arguments are invalid
+void TGADrawListPrintChar(TGADrawList *that, TGAPencil *pen, 
+  TGAFont *font, unsigned char c, VecFloat *pos);
+
+// Execute the commands of the TGADrawList 'list' on the current 
+// layer of the TGA 'tga'
+// The result is the same as calling the corresponding TGADraw*, 
+// TGAFill* and TGAPrint* functions in the order of recording, but
+// commands whose pixels don't overlap are drawn together in the 
+// working layer and blended at once, area by area
+// Commands outside the TGA are skipped
+// The list is left unchanged and can be executed again
+// Do nothing if arguments are invalid
+void TGAExecDrawList(TGA *tga, TGADrawList *list);
+
+// Execute the commands of the TGADrawList 'list' on the current 
+// layer of the TGA 'tga' with 'nbThread' threads (as many as 
+// processors if 'nbThread' < 1)
+// The TGA is split into tiles of TGA_TILESIZE pixels, each command is
+// attached to the tiles its box overlaps, and the threads draw the 
+// tiles in parallel, each one with the commands in their order of
+// recording clipped to the tile
+// The result is the same as TGAExecDrawList
+// Do nothing if arguments are invalid
+void TGAExecDrawListTiled(TGA *tga, TGADrawList *list, int nbThread);
   
+// Convert 'nb' pixels from BGRA in 'src' to RGBA in 'dst'
+// The conversion is symmetric, it also converts from RGBA to BGRA
+// 'src' and 'dst' may be the same row
+void TGARowBGRAToRGBA(unsigned char *dst, unsigned char *src, long nb);
+
+// Convert 'nb' pixels from BGR in 'src' to opaque RGBA in 'dst'
+void TGARowBGRToRGBA(unsigned char *dst, unsigned char *src, long nb);
+
+// Convert 'nb' pixels from 1-5-5-5 in 'src' to RGBA in 'dst'
+void TGARow1555ToRGBA(unsigned char *dst, unsigned char *src, long nb);
+
+// Convert 'nb' pixels from RGBA in 'src' to BGR in 'dst'
+void TGARowRGBAToBGR(unsigned char *dst, unsigned char *src, long nb);
+
+// Convert 'nb' pixels from RGBA in 'src' to 1-5-5-5 in 'dst'
+void TGARowRGBATo1555(unsigned char *dst, unsigned char *src, long nb);
+
 // Get a white TGAPixel
 TGAPixel* TGAGetWhitePixel(void);
 
@@ -308,6 +965,20 @@ TGAPixel* TGAPixelBlend(TGAPixel *pixA, TGAPixel *pixB, float blend);
 // Return NULL if arguments are invalid
 TGAPixel* TGAPixelMix(TGAPixel *pixA, TGAPixel *pixB, float ratio);
 
+// Set 'dst' to the blend of 'pixA' and 'pixB' 
+// dst = (1 - blend) * pixA + blend * pixB
+// 'dst' may be 'pixA' or 'pixB'
+// Do nothing if arguments are invalid
+void TGAPixelBlendTo(TGAPixel *dst, TGAPixel *pixA, TGAPixel *pixB,
+  float blend);
+
+// Set 'dst' to the addition of 'ratio' (in [0.0,1.0]) * 'pixB' 
+// to 'pixA'
+// 'dst' may be 'pixA' or 'pixB'
+// Do nothing if arguments are invalid
+void TGAPixelMixTo(TGAPixel *dst, TGAPixel *pixA, TGAPixel *pixB,
+  float ratio);
+
 // Create a default TGAPencil with all color set to transparent
 // solid mode, thickness = 1.0, tip as facoid, no antialias
 // Return NULL if it couldn't allocate memory
@@ -336,6 +1007,12 @@ int TGAPencilGetColor(TGAPencil *pen);
 // Return NULL if arguments are invalid
 TGAPixel* TGAPencilGetPixel(TGAPencil *pen);
 
+// Set 'pix' to the active color of the TGAPencil 'pen'
+// In tgaPenBlend mode the color is the one precomputed for the 
+// nearest value of the blend
+// Do nothing if arguments are invalid
+void TGAPencilGetPixelTo(TGAPencil *pen, TGAPixel *pix);
+
 // Get the 
 
 // Set the active color of TGAPencil 'pen' to TGAPixel 'col'
@@ -439,17 +1116,20 @@ float TGAFontGetAngleWithAbciss(TGAFont *font);
 // are invalid
 TGAPixel *TGAGetAverageColor(TGA *tga);
 
-// Set the read only flag of a TGAPixel
+// Set the read only flag of the pixel at coord (x,y) = (pos[0],pos[1])
+// in the current layer of 'tga'
 // Do nothing if arguments are invalid
-void TGAPixelSetReadOnly(TGAPixel *pix, bool v);
+void TGASetReadOnly(TGA *tga, VecShort *pos, bool v);
 
-// Set the read only flag of all the TGAPixel of a TGA
+// Set the read only flag of all the pixels in the current layer 
+// of 'tga'
 // Do nothing if arguments are invalid
 void TGAPixelSetAllReadOnly(TGA *tga, bool v);
 
-// Get the read only flag of a TGAPixel
+// Get the read only flag of the pixel at coord (x,y) = 
+// (pos[0],pos[1]) in the current layer of 'tga'
 // Return true if arguments are invalid
-bool TGAPixelIsReadOnly(TGAPixel *pix);
+bool TGAIsReadOnly(TGA *tga, VecShort *pos);
 
 // Create a TGALayer of width dim[0] and height dim[1] and background
 // color equal to 'pixel'
@@ -481,6 +1161,68 @@ void TGAAddLayer(TGA *that);
 // Do nothing if arguments are invalid
 void TGALayerBlend(TGALayer *that, TGALayer *tho, VecShort *bound);
 
+// Apply a gaussian blur of 'strength' and 'range' perimeter on the 
+// layer 'that'
+// If VecShort 'bound' is not null only pixels inside the box
+// (bound[0],bound[1])-(bound[2],bound[3]) (included) are blurred, 
+// using the pixels of the layer around the box
+// The blur is applied separately along the rows and the columns, the
+// pixels at a distance lower than 'range' along the row/column 
+// contributing with a weight given by the gaussian, normalized over 
+// the pixels inside the layer
+// The layer is blurred by bands of rows in parallel with 'nbThread'
+// threads (as many as processors if 'nbThread' < 1)
+// Do nothing if arguments are invalid 
+void TGALayerFilterGaussBlur(TGALayer *that, VecShort *bound, 
+  float strength, float range, int nbThread);
+
+// Apply a recursive gaussian blur of 'strength' on the layer 'that'
+// If VecShort 'bound' is not null only pixels inside the box
+// (bound[0],bound[1])-(bound[2],bound[3]) (included) are blurred, 
+// using the pixels of the layer at a distance up to 
+// TGA_GAUSSRECURSIVEHALO * 'strength' around the box
+// The gaussian is approximated with the recursive filter of Young and
+// van Vliet applied forward and backward along the rows and the 
+// columns, hence the cost per pixel doesn't depend on 'strength', and
+// the pixels outside the layer are considered equal to the nearest 
+// pixel on its border
+// 'strength' lower than TGA_GAUSSRECURSIVEMIN is blurred with 
+// TGALayerFilterGaussBlur instead, as it is then cheap and the 
+// recursive filter is less accurate
+// The layer is blurred by bands of rows then by strips of columns 
+// in parallel with 'nbThread' threads (as many as processors if 
+// 'nbThread' < 1), the values being rounded between the two passes
+// Do nothing if arguments are invalid 
+void TGALayerFilterGaussBlurRecursive(TGALayer *that, VecShort *bound,
+  float strength, int nbThread);
+
+// Apply an approximated gaussian blur of 'strength' on the layer 
+// 'that'
+// If VecShort 'bound' is not null only pixels inside the box
+// (bound[0],bound[1])-(bound[2],bound[3]) (included) are blurred, 
+// using the pixels of the layer around the box
+// The gaussian is approximated as in TGAFilterGaussBlurBox
+// 'strength' lower than TGA_GAUSSBOXMIN is blurred with 
+// TGALayerFilterGaussBlur instead
+// The pixels outside the layer are considered equal to the nearest 
+// pixel on its border
+// The layer is blurred by bands of rows in parallel with 'nbThread'
+// threads (as many as processors if 'nbThread' < 1)
+// Do nothing if arguments are invalid 
+void TGALayerFilterGaussBlurBox(TGALayer *that, VecShort *bound, 
+  float strength, int nbThread);
+
+// Convolve the layer 'that' with the TGAKernel 'kernel', the pixels 
+// outside the layer being given by the policy 'edge'
+// If VecShort 'bound' is not null only pixels inside the box
+// (bound[0],bound[1])-(bound[2],bound[3]) (included) are convolved, 
+// using the pixels of the layer around the box
+// The layer is convolved by bands of rows in parallel with 
+// 'nbThread' threads (as many as processors if 'nbThread' < 1)
+// Do nothing if arguments are invalid 
+void TGALayerFilterConvolve(TGALayer *that, VecShort *bound, 
+  TGAKernel *kernel, tgaConvEdge edge, int nbThread);
+
 // Get a pointer to the pixel at coord (x,y) = (pos[0],pos[1]) 
 // in the layer 'that'
 // Return NULL in case of invalid arguments
@@ -491,6 +1233,20 @@ TGAPixel* TGALayerGetPix(TGALayer *that, VecShort *pos);
 // Do nothing in case of invalid arguments
 void TGALayerSetPix(TGALayer *that, VecShort *pos, TGAPixel *pix);
 
+// Set the read only flag of the pixel at coord (x,y) = (pos[0],pos[1])
+// in the layer 'that'
+// Do nothing if arguments are invalid
+void TGALayerSetReadOnly(TGALayer *that, VecShort *pos, bool v);
+
+// Set the read only flag of all the pixels in the layer 'that'
+// Do nothing if arguments are invalid
+void TGALayerSetAllReadOnly(TGALayer *that, bool v);
+
+// Get the read only flag of the pixel at coord (x,y) = 
+// (pos[0],pos[1]) in the layer 'that'
+// Return true if arguments are invalid
+bool TGALayerIsReadOnly(TGALayer *that, VecShort *pos);
+
 // Draw one stroke at 'pos' with 'pen'
 // in layer 'that'
 // Do nothing in case of invalid arguments
@@ -505,4 +1261,11 @@ bool TGALayerIsPosInside(TGALayer *that, VecShort *pos);
 // Do nothing in case of invalid argument
 void TGALayerClean(TGALayer *that); 
 
+// Erase the pixels of the layer 'that' inside its dirty box
+// (set them to rgba(0,0,0,0) and readonly to false)
+// Pixels modified directly, without the TGALayer functions, since the
+// last clean are not erased
+// Do nothing in case of invalid argument
+void TGALayerCleanDirty(TGALayer *that);
+
 #endif
@@ -0,0 +1,331 @@
+// *************** TGASWIZZLE.C ***************
+
+// Conversion of rows of pixels between the formats of TGA files
+// (BGRA, BGR, 1-5-5-5) and packed RGBA, with SSE2/SSSE3/AVX2 versions
+// selected at runtime on x86 and scalar versions elsewhere
+
+// ================= Include =================
+
+#include <pthread.h>
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define TGA_SIMD_X86
+#include <immintrin.h>
+#endif
+
+// ================= Define ==================
+
+// Signature of the row conversion kernels
+typedef void (*TGARowKernel)(unsigned char *dst, unsigned char *src,
+  long nb);
+
+// ================ Global variables ====================
+
+// Kernels used by the TGARow* functions, selected once by 
+// TGARowSelect
+static TGARowKernel TGARowKernelSwapRB = NULL;
+static TGARowKernel TGARowKernelBGRToRGBA = NULL;
+static TGARowKernel TGARowKernel1555ToRGBA = NULL;
+static TGARowKernel TGARowKernelRGBAToBGR = NULL;
+static TGARowKernel TGARowKernelRGBATo1555 = NULL;
+static pthread_once_t TGARowOnce = PTHREAD_ONCE_INIT;
+
+// ================ Functions declaration ====================
+
+// Select the fastest kernels available on the current CPU
+// It is safe to call it from several threads
+static void TGARowSelect(void);
+
+// ================ Functions implementation ==================
+
+// Scalar version of TGARowBGRAToRGBA
+static void TGARowSwapRBScalar(unsigned char *dst, unsigned char *src,
+  long nb) {
+  for (long i = 0; i < nb; ++i, dst += 4, src += 4) {
+    unsigned char r = src[2];
+    unsigned char b = src[0];
+    dst[0] = r;
+    dst[1] = src[1];
+    dst[2] = b;
+    dst[3] = src[3];
+  }
+}
+
+// Scalar version of TGARowBGRToRGBA
+static void TGARowBGRToRGBAScalar(unsigned char *dst, 
+  unsigned char *src, long nb) {
+  for (long i = 0; i < nb; ++i, dst += 4, src += 3) {
+    dst[0] = src[2];
+    dst[1] = src[1];
+    dst[2] = src[0];
+    dst[3] = 255;
+  }
+}
+
+// Scalar version of TGARow1555ToRGBA
+static void TGARow1555ToRGBAScalar(unsigned char *dst, 
+  unsigned char *src, long nb) {
+  for (long i = 0; i < nb; ++i, dst += 4, src += 2) {
+    dst[0] = (src[1] & 0x7c) << 1;
+    dst[1] = ((src[1] & 0x03) << 6) | ((src[0] & 0xe0) >> 2);
+    dst[2] = (src[0] & 0x1f) << 3;
+    dst[3] = (src[1] & 0x80);
+  }
+}
+
+// Scalar version of TGARowRGBAToBGR
+static void TGARowRGBAToBGRScalar(unsigned char *dst, 
+  unsigned char *src, long nb) {
+  for (long i = 0; i < nb; ++i, dst += 3, src += 4) {
+    dst[0] = src[2];
+    dst[1] = src[1];
+    dst[2] = src[0];
+  }
+}
+
+// Scalar version of TGARowRGBATo1555
+static void TGARowRGBATo1555Scalar(unsigned char *dst, 
+  unsigned char *src, long nb) {
+  for (long i = 0; i < nb; ++i, dst += 2, src += 4) {
+    dst[0] = ((src[1] & 0x38) << 2) | (src[2] >> 3);
+    dst[1] = (src[3] & 0x80) | ((src[0] & 0xf8) >> 1) | (src[1] >> 6);
+  }
+}
+
+#ifdef TGA_SIMD_X86
+
+// SSE2 version of TGARowBGRAToRGBA, 4 pixels per iteration
+__attribute__((target("sse2")))
+static void TGARowSwapRBSSE2(unsigned char *dst, unsigned char *src,
+  long nb) {
+  const __m128i maskGA = _mm_set1_epi32(0xFF00FF00);
+  const __m128i maskB = _mm_set1_epi32(0x000000FF);
+  long i = 0;
+  for (; i + 4 <= nb; i += 4) {
+    __m128i v = _mm_loadu_si128((__m128i*)(src + 4 * i));
+    // Keep G and A, move byte 0 to byte 2 and byte 2 to byte 0
+    __m128i r = _mm_or_si128(_mm_and_si128(v, maskGA),
+      _mm_or_si128(_mm_slli_epi32(_mm_and_si128(v, maskB), 16),
+      _mm_and_si128(_mm_srli_epi32(v, 16), maskB)));
+    _mm_storeu_si128((__m128i*)(dst + 4 * i), r);
+  }
+  TGARowSwapRBScalar(dst + 4 * i, src + 4 * i, nb - i);
+}
+
+// AVX2 version of TGARowBGRAToRGBA, 8 pixels per iteration
+__attribute__((target("avx2")))
+static void TGARowSwapRBAVX2(unsigned char *dst, unsigned char *src,
+  long nb) {
+  const __m256i shuffle = _mm256_setr_epi8(
+    2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15,
+    2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+  long i = 0;
+  for (; i + 8 <= nb; i += 8) {
+    __m256i v = _mm256_loadu_si256((__m256i*)(src + 4 * i));
+    _mm256_storeu_si256((__m256i*)(dst + 4 * i),
+      _mm256_shuffle_epi8(v, shuffle));
+  }
+  TGARowSwapRBScalar(dst + 4 * i, src + 4 * i, nb - i);
+}
+
+// SSSE3 version of TGARowBGRToRGBA, 4 pixels per iteration
+__attribute__((target("ssse3")))
+static void TGARowBGRToRGBASSSE3(unsigned char *dst, unsigned char *src,
+  long nb) {
+  const __m128i shuffle = _mm_setr_epi8(
+    2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1);
+  const __m128i alpha = _mm_set1_epi32(0xFF000000);
+  long i = 0;
+  // The 16 bytes loaded for 4 pixels must stay inside the row
+  for (; i + 6 <= nb; i += 4) {
+    __m128i v = _mm_loadu_si128((__m128i*)(src + 3 * i));
+    _mm_storeu_si128((__m128i*)(dst + 4 * i),
+      _mm_or_si128(_mm_shuffle_epi8(v, shuffle), alpha));
+  }
+  TGARowBGRToRGBAScalar(dst + 4 * i, src + 3 * i, nb - i);
+}
+
+// AVX2 version of TGARowBGRToRGBA, 8 pixels per iteration
+__attribute__((target("avx2")))
+static void TGARowBGRToRGBAAVX2(unsigned char *dst, unsigned char *src,
+  long nb) {
+  const __m256i shuffle = _mm256_setr_epi8(
+    2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1,
+    2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1);
+  const __m256i alpha = _mm256_set1_epi32(0xFF000000);
+  long i = 0;
+  // The 16 bytes loaded for the last 4 pixels must stay inside the row
+  for (; i + 10 <= nb; i += 8) {
+    __m256i v = _mm256_inserti128_si256(_mm256_castsi128_si256(
+      _mm_loadu_si128((__m128i*)(src + 3 * i))),
+      _mm_loadu_si128((__m128i*)(src + 3 * i + 12)), 1);
+    _mm256_storeu_si256((__m256i*)(dst + 4 * i),
+      _mm256_or_si256(_mm256_shuffle_epi8(v, shuffle), alpha));
+  }
+  TGARowBGRToRGBAScalar(dst + 4 * i, src + 3 * i, nb - i);
+}
+
+// SSE2 version of TGARow1555ToRGBA, 8 pixels per iteration
+__attribute__((target("sse2")))
+static void TGARow1555ToRGBASSE2(unsigned char *dst, unsigned char *src,
+  long nb) {
+  const __m128i mask = _mm_set1_epi16(0xF8);
+  const __m128i maskA = _mm_set1_epi16(0x80);
+  long i = 0;
+  for (; i + 8 <= nb; i += 8) {
+    __m128i v = _mm_loadu_si128((__m128i*)(src + 2 * i));
+    // Expand each channel to 8 bits in 16 bits lanes
+    __m128i r = _mm_and_si128(_mm_srli_epi16(v, 7), mask);
+    __m128i g = _mm_and_si128(_mm_srli_epi16(v, 2), mask);
+    __m128i b = _mm_and_si128(_mm_slli_epi16(v, 3), mask);
+    __m128i a = _mm_and_si128(_mm_srli_epi16(v, 8), maskA);
+    // Interleave (r,g) and (b,a) into RGBA
+    __m128i rg = _mm_or_si128(r, _mm_slli_epi16(g, 8));
+    __m128i ba = _mm_or_si128(b, _mm_slli_epi16(a, 8));
+    _mm_storeu_si128((__m128i*)(dst + 4 * i), _mm_unpacklo_epi16(rg, ba));
+    _mm_storeu_si128((__m128i*)(dst + 4 * i + 16),
+      _mm_unpackhi_epi16(rg, ba));
+  }
+  TGARow1555ToRGBAScalar(dst + 4 * i, src + 2 * i, nb - i);
+}
+
+// AVX2 version of TGARow1555ToRGBA, 16 pixels per iteration
+__attribute__((target("avx2")))
+static void TGARow1555ToRGBAAVX2(unsigned char *dst, unsigned char *src,
+  long nb) {
+  const __m256i mask = _mm256_set1_epi16(0xF8);
+  const __m256i maskA = _mm256_set1_epi16(0x80);
+  long i = 0;
+  for (; i + 16 <= nb; i += 16) {
+    __m256i v = _mm256_loadu_si256((__m256i*)(src + 2 * i));
+    __m256i r = _mm256_and_si256(_mm256_srli_epi16(v, 7), mask);
+    __m256i g = _mm256_and_si256(_mm256_srli_epi16(v, 2), mask);
+    __m256i b = _mm256_and_si256(_mm256_slli_epi16(v, 3), mask);
+    __m256i a = _mm256_and_si256(_mm256_srli_epi16(v, 8), maskA);
+    __m256i rg = _mm256_or_si256(r, _mm256_slli_epi16(g, 8));
+    __m256i ba = _mm256_or_si256(b, _mm256_slli_epi16(a, 8));
+    // The unpacks work per 128 bits lane, reorder the lanes when
+    // storing
+    __m256i lo = _mm256_unpacklo_epi16(rg, ba);
+    __m256i hi = _mm256_unpackhi_epi16(rg, ba);
+    _mm256_storeu_si256((__m256i*)(dst + 4 * i),
+      _mm256_permute2x128_si256(lo, hi, 0x20));
+    _mm256_storeu_si256((__m256i*)(dst + 4 * i + 32),
+      _mm256_permute2x128_si256(lo, hi, 0x31));
+  }
+  TGARow1555ToRGBAScalar(dst + 4 * i, src + 2 * i, nb - i);
+}
+
+// SSSE3 version of TGARowRGBAToBGR, 4 pixels per iteration
+__attribute__((target("ssse3")))
+static void TGARowRGBAToBGRSSSE3(unsigned char *dst, unsigned char *src,
+  long nb) {
+  const __m128i shuffle = _mm_setr_epi8(
+    2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+  long i = 0;
+  for (; i + 4 <= nb; i += 4) {
+    __m128i v = _mm_shuffle_epi8(
+      _mm_loadu_si128((__m128i*)(src + 4 * i)), shuffle);
+    // Store the 12 bytes of the 4 pixels
+    _mm_storel_epi64((__m128i*)(dst + 3 * i), v);
+    int last = _mm_cvtsi128_si32(_mm_srli_si128(v, 8));
+    memcpy(dst + 3 * i + 8, &last, 4);
+  }
+  TGARowRGBAToBGRScalar(dst + 3 * i, src + 4 * i, nb - i);
+}
+
+// SSE2 version of TGARowRGBATo1555, 8 pixels per iteration
+__attribute__((target("sse2")))
+static void TGARowRGBATo1555SSE2(unsigned char *dst, unsigned char *src,
+  long nb) {
+  const __m128i mask = _mm_set1_epi32(0xF8);
+  const __m128i maskA = _mm_set1_epi32(0x80);
+  long i = 0;
+  for (; i + 8 <= nb; i += 8) {
+    __m128i p[2];
+    for (int k = 0; k < 2; ++k) {
+      __m128i v = _mm_loadu_si128((__m128i*)(src + 4 * i + 16 * k));
+      __m128i r = _mm_and_si128(v, mask);
+      __m128i g = _mm_and_si128(_mm_srli_epi32(v, 8), mask);
+      __m128i b = _mm_srli_epi32(_mm_and_si128(_mm_srli_epi32(v, 16),
+        mask), 3);
+      __m128i a = _mm_and_si128(_mm_srli_epi32(v, 24), maskA);
+      p[k] = _mm_or_si128(_mm_or_si128(_mm_slli_epi32(a, 8),
+        _mm_slli_epi32(r, 7)), _mm_or_si128(_mm_slli_epi32(g, 2), b));
+      // Sign extend the 16 bits values to pack them without saturation
+      p[k] = _mm_srai_epi32(_mm_slli_epi32(p[k], 16), 16);
+    }
+    _mm_storeu_si128((__m128i*)(dst + 2 * i), _mm_packs_epi32(p[0], p[1]));
+  }
+  TGARowRGBATo1555Scalar(dst + 2 * i, src + 4 * i, nb - i);
+}
+
+#endif
+
+// Set the kernels to the fastest ones available on the current CPU,
+// called once by TGARowSelect
+static void TGARowSelectOnce(void) {
+  // Select the scalar kernels by default
+  TGARowKernelSwapRB = TGARowSwapRBScalar;
+  TGARowKernelBGRToRGBA = TGARowBGRToRGBAScalar;
+  TGARowKernel1555ToRGBA = TGARow1555ToRGBAScalar;
+  TGARowKernelRGBAToBGR = TGARowRGBAToBGRScalar;
+  TGARowKernelRGBATo1555 = TGARowRGBATo1555Scalar;
+#ifdef TGA_SIMD_X86
+  // Select the vector kernels supported by the CPU
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("sse2")) {
+    TGARowKernelSwapRB = TGARowSwapRBSSE2;
+    TGARowKernel1555ToRGBA = TGARow1555ToRGBASSE2;
+    TGARowKernelRGBATo1555 = TGARowRGBATo1555SSE2;
+  }
+  if (__builtin_cpu_supports("ssse3")) {
+    TGARowKernelBGRToRGBA = TGARowBGRToRGBASSSE3;
+    TGARowKernelRGBAToBGR = TGARowRGBAToBGRSSSE3;
+  }
+  if (__builtin_cpu_supports("avx2")) {
+    TGARowKernelSwapRB = TGARowSwapRBAVX2;
+    TGARowKernelBGRToRGBA = TGARowBGRToRGBAAVX2;
+    TGARowKernel1555ToRGBA = TGARow1555ToRGBAAVX2;
+  }
+#endif
+}
+
+// Select the fastest kernels available on the current CPU
+// It is safe to call it from several threads
+static void TGARowSelect(void) {
+  // Select the kernels the first time, the other callers wait for the
+  // selection and see its result
+  pthread_once(&TGARowOnce, TGARowSelectOnce);
+}
+
+// Convert 'nb' pixels from BGRA in 'src' to RGBA in 'dst'
+// The conversion is symmetric, it also converts from RGBA to BGRA
+// 'src' and 'dst' may be the same row
+void TGARowBGRAToRGBA(unsigned char *dst, unsigned char *src, long nb) {
+  TGARowSelect();
+  TGARowKernelSwapRB(dst, src, nb);
+}
+
+// Convert 'nb' pixels from BGR in 'src' to opaque RGBA in 'dst'
+void TGARowBGRToRGBA(unsigned char *dst, unsigned char *src, long nb) {
+  TGARowSelect();
+  TGARowKernelBGRToRGBA(dst, src, nb);
+}
+
+// Convert 'nb' pixels from 1-5-5-5 in 'src' to RGBA in 'dst'
+void TGARow1555ToRGBA(unsigned char *dst, unsigned char *src, long nb) {
+  TGARowSelect();
+  TGARowKernel1555ToRGBA(dst, src, nb);
+}
+
+// Convert 'nb' pixels from RGBA in 'src' to BGR in 'dst'
+void TGARowRGBAToBGR(unsigned char *dst, unsigned char *src, long nb) {
+  TGARowSelect();
+  TGARowKernelRGBAToBGR(dst, src, nb);
+}
+
+// Convert 'nb' pixels from RGBA in 'src' to 1-5-5-5 in 'dst'
+void TGARowRGBATo1555(unsigned char *dst, unsigned char *src, long nb) {
+  TGARowSelect();
+  TGARowKernelRGBATo1555(dst, src, nb);
+}